@@ -10,6 +10,7 @@
 #include "ssmt.hpp"
 //#include "lif_content.hpp"
 #include "clipManager.hpp"
+#include "playback_ring.hpp"
 #include "visible_layout.hpp"
 #include <atomic>
 #include "OnImagePlotUtils.h"
@@ -334,6 +335,12 @@ private:
 		return xScaled;
 	}
 	
+    // Display frames are decoded ahead of the playhead on the ring's thread, the only user of mImageCache
+    // once content is loaded. Declared last, so it is stopped before what decode_frame uses is destroyed.
+    bool decode_frame (int64_t index, SurfaceRef& frame);
+    std::unique_ptr<playback_ring<SurfaceRef>> m_playback;
+    int64_t m_displayed_frame;
+    int64_t m_play_direction;
 
 };
 
@@ -3,12 +3,18 @@
 
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 #include "timed_types.h"
 #include "core/core.hpp"
 #include "vision/histo.h"
 #include "vision/pixel_traits.h"
 #include "vision/opencv_utils.hpp"
 #include "core/stl_utils.hpp"
+#include "core/thread_pool.hpp"
 #include "core/stats.hpp"
 #include "vision/localvariance.h"
 #include <boost/range/irange.hpp>
@@ -106,10 +112,178 @@ struct UnitSyntheticProducer
 #endif
 
 
+/*
+struct VolumeAccumulatorT
+ Fused, parallel pass over a sequence. Every pixel is read once for the per pixel sum and sum of
+ squares ( cv::accumulate, accumulateSquare ) and the per frame (sum, sumsq, count) and (min, max).
+ With spatial_x and spatial_y the per pixel sums are of the normalized local variance of the frames.
+ Frames are split in contiguous chunks over the shared pool, each chunk accumulates its own partial
+ sums which are added at the end. Per pixel sums are CV_32F for 8 bit frames and CV_64F for 16 bit
+ frames, whose squares would lose too much in float.
+ 
+ stream is the same pass over frames as they arrive, e.g. from a frame_source. Each frame's rows are
+ split in bands over the shared pool, the bands write disjoint rows of the sums.
+*/
+template<typename P>
+struct VolumeAccumulatorT
+{
+    typedef typename P::value_type pixel_t;
+    typedef typename std::conditional<sizeof(pixel_t) == 1, float, double>::type sum_t;
+    typedef std::vector<roiWindow<P>> channel_images_t;
+    typedef std::tuple<int64_t, int64_t, uint32_t> moments_t;
+    typedef std::tuple<pixel_t, pixel_t> range_t;
+    
+    void operator()(const channel_images_t& channel_images, cv::Mat& m_sum, cv::Mat& m_sqsum,
+                    std::vector<moments_t>& moments, std::vector<range_t>& ranges,
+                    uint8_t spatial_x = 0, uint8_t spatial_y = 0)
+    {
+        const pixel_t pmax = std::numeric_limits<pixel_t>::max();
+        const size_t count = channel_images.size();
+        moments.assign(count, moments_t(0, 0, 0));
+        ranges.assign(count, range_t(pmax, 0));
+        m_sum = cv::Mat();
+        m_sqsum = cv::Mat();
+        if (count == 0) return;
+        
+        const int width = channel_images[0].width();
+        const int height = channel_images[0].height();
+        const size_t chunks = std::min(count, size_t(svl::thread_pool::global().size()));
+        std::vector<cv::Mat> sums (chunks), sqsums (chunks);
+        
+        svl::thread_pool::global().parallel_for(chunks, [&] (size_t cc) {
+            cv::Mat& sum = sums[cc];
+            cv::Mat& sqsum = sqsums[cc];
+            sum = cv::Mat::zeros(height, width, cv::DataType<sum_t>::type);
+            sqsum = cv::Mat::zeros(height, width, cv::DataType<sum_t>::type);
+            for (size_t ff = cc * count / chunks; ff < (cc + 1) * count / chunks; ff++){
+                const roiWindow<P>& ir = channel_images[ff];
+                assert(ir.width() == width && ir.height() == height);
+                const cv::Mat local = local_variance(ir, spatial_x, spatial_y);
+                frame_sums fs;
+                accumulate_rows(ir, local, sum, sqsum, 0, height, fs);
+                moments[ff] = moments_t(fs.sum, fs.sumsq, uint32_t(width * height));
+                ranges[ff] = range_t(fs.min, fs.max);
+            }
+        });
+        
+        m_sum = sums[0];
+        m_sqsum = sqsums[0];
+        for (size_t cc = 1; cc < chunks; cc++){
+            m_sum += sums[cc];
+            m_sqsum += sqsums[cc];
+        }
+    }
+    
+    class stream
+    {
+    public:
+        stream (uint8_t spatial_x = 0, uint8_t spatial_y = 0) : m_spatial_x(spatial_x), m_spatial_y(spatial_y) {}
+        
+        size_t count () const { return m_moments.size(); }
+        
+        // Frames must be of the size of the first one
+        void add (const roiWindow<P>& ir)
+        {
+            const int width = ir.width();
+            const int height = ir.height();
+            if (m_sum.empty()){
+                m_sum = cv::Mat::zeros(height, width, cv::DataType<sum_t>::type);
+                m_sqsum = cv::Mat::zeros(height, width, cv::DataType<sum_t>::type);
+            }
+            assert(m_sum.cols == width && m_sum.rows == height);
+            const cv::Mat local = local_variance(ir, m_spatial_x, m_spatial_y);
+            const size_t bands = std::min(size_t(height), size_t(svl::thread_pool::global().size()));
+            std::vector<frame_sums> fss (bands);
+            svl::thread_pool::global().parallel_for(bands, [&] (size_t bb) {
+                accumulate_rows(ir, local, m_sum, m_sqsum, int(bb * height / bands), int((bb + 1) * height / bands), fss[bb]);
+            });
+            frame_sums fs;
+            for (const frame_sums& bs : fss){
+                fs.sum += bs.sum;
+                fs.sumsq += bs.sumsq;
+                fs.min = std::min(fs.min, bs.min);
+                fs.max = std::max(fs.max, bs.max);
+            }
+            m_moments.emplace_back(fs.sum, fs.sumsq, uint32_t(width * height));
+            m_ranges.emplace_back(fs.min, fs.max);
+        }
+        
+        // Results as of the one pass call over the frames added so far
+        void finish (cv::Mat& m_sum_out, cv::Mat& m_sqsum_out, std::vector<moments_t>& moments, std::vector<range_t>& ranges) const
+        {
+            m_sum_out = m_sum;
+            m_sqsum_out = m_sqsum;
+            moments = m_moments;
+            ranges = m_ranges;
+        }
+        
+    private:
+        uint8_t m_spatial_x, m_spatial_y;
+        cv::Mat m_sum, m_sqsum;
+        std::vector<moments_t> m_moments;
+        std::vector<range_t> m_ranges;
+    };
+    
+private:
+    struct frame_sums
+    {
+        frame_sums () : sum(0), sumsq(0), min(std::numeric_limits<pixel_t>::max()), max(0) {}
+        int64_t sum, sumsq;
+        pixel_t min, max;
+    };
+    
+    // Normalized 8 bit local variance of the frame, empty without a neighbourhood
+    static cv::Mat local_variance (const roiWindow<P>& ir, uint8_t spatial_x, uint8_t spatial_y)
+    {
+        cv::Mat local;
+        if (spatial_x == 0 || spatial_y == 0) return local;
+        const pixel_t pmax = std::numeric_limits<pixel_t>::max();
+        cv::Mat im (ir.height(), ir.width(), cv::DataType<pixel_t>::type, ir.pelPointer(0,0), size_t(ir.rowUpdate()));
+        // localVAR integrates in 8 bit, the result is normalized per frame anyway
+        if (sizeof(pixel_t) > 1) im.convertTo(im, CV_8U, 255.0 / pmax);
+        cv::Mat result;
+        localVAR lv(cv::Size(spatial_x, spatial_y));
+        lv.process (im, result);
+        cv::normalize(result, local, 0, 255, NORM_MINMAX, CV_8UC1);
+        return local;
+    }
+    
+    // Rows [row0, row1) of the frame in to the per pixel sums and the frame sums
+    static void accumulate_rows (const roiWindow<P>& ir, const cv::Mat& local, cv::Mat& sum, cv::Mat& sqsum,
+                                 int row0, int row1, frame_sums& fs)
+    {
+        const int width = ir.width();
+        const bool local_var = ! local.empty();
+        for (int row = row0; row < row1; row++){
+            const pixel_t* src = ir.rowPointer(row);
+            const uint8_t* acc = local_var ? local.ptr<uint8_t>(row) : nullptr;
+            sum_t* ps = sum.ptr<sum_t>(row);
+            sum_t* pq = sqsum.ptr<sum_t>(row);
+            uint32_t rsum = 0;
+            uint64_t rsumsq = 0;
+            for (int col = 0; col < width; col++){
+                const uint32_t val = src[col];
+                rsum += val;
+                rsumsq += val * val;
+                fs.min = std::min(fs.min, src[col]);
+                fs.max = std::max(fs.max, src[col]);
+                const sum_t aval = local_var ? acc[col] : src[col];
+                ps[col] += aval;
+                pq[col] += aval * aval;
+            }
+            fs.sum += rsum;
+            fs.sumsq += rsumsq;
+        }
+    }
+};
+
+typedef VolumeAccumulatorT<P8U> VolumeAccumulator;
+typedef VolumeAccumulatorT<P16U> VolumeAccumulator16;
+
 /*
 struct SequenceAccumulator
  Callable to produce sum of per pixel variances over the pixel or a local neigbourhood around
- atomic bool is set to true to indicate completion. 
+ atomic bool is set to true to indicate completion. Runs VolumeAccumulator.
 */
 struct SequenceAccumulator
 {
@@ -120,27 +294,13 @@ struct SequenceAccumulator
                     uint8_t spatial_x = 0, uint8_t spatial_y = 0 )
     {
         done = false;
-        image_count = 0;
-        for (const roiWindow<P8U>& ir : channel_images){
-            cv::Mat im (ir.height(), ir.width(), CV_8UC(1), ir.pelPointer(0,0), size_t(ir.rowUpdate()));
-            if( image_count == 0 ) {
-                m_sum = cv::Mat::zeros( im.size(), CV_32FC(im.channels()) );
-                m_sqsum = cv::Mat::zeros( im.size(), CV_32FC(im.channels()) );
-            }
-            if (spatial_x > 0 && spatial_y > 0){
-                cv::Mat result;
-                localVAR lv(cv::Size(spatial_x, spatial_y));
-                lv.process (im, result);
-                cv::normalize(result, im, 0, 255, NORM_MINMAX, CV_8UC1);
-            }
-            cv::accumulate( im, m_sum );
-            cv::accumulateSquare( im, m_sqsum );
-            image_count++;
-        }
+        std::vector<VolumeAccumulator::moments_t> moments;
+        std::vector<VolumeAccumulator::range_t> ranges;
+        VolumeAccumulator()(channel_images, m_sum, m_sqsum, moments, ranges, spatial_x, spatial_y);
+        image_count = static_cast<int>(channel_images.size());
         done = true;
     }
     
-
     static void computeVariance(cv::Mat& m_sum, cv::Mat& m_sqsum, int image_count, cv::Mat& variance) {
         double one_by_N = 1.0 / image_count;
         variance = (one_by_N * m_sqsum) - ((one_by_N * one_by_N) * m_sum.mul(m_sum));
@@ -162,7 +322,7 @@ struct SequenceAccumulator
 
 /*
 struct IntensityStatisticsPartialRunner
- Callable to produce (count, sum sumsq) and (min, max) over the volume
+ Callable to produce (count, sum sumsq) and (min, max) over the volume. Runs VolumeAccumulator.
 */
 struct IntensityStatisticsPartialRunner
 {
@@ -170,20 +330,8 @@ struct IntensityStatisticsPartialRunner
     void operator()( channel_images_t& channel, std::vector< std::tuple<int64_t, int64_t, uint32_t> >& results,
                     std::vector< std::tuple<uint8_t, uint8_t> >& ranges )
     {
-        results.clear();
-        for (auto ii = 0; ii < channel.size(); ii++)
-        {
-            roiWindow<P8U>& image = channel[ii];
-            histoStats hh;
-            hh.from_image(image);
-            int64_t s = hh.sum();
-            int64_t ss = hh.sumSquared();
-            uint8_t mi = hh.min();
-            uint8_t ma = hh.max();
-            uint32_t nn = hh.n();
-            results.emplace_back(s,ss,nn);
-            ranges.emplace_back(mi,ma);
-        }
+        cv::Mat sum, sqsum;
+        VolumeAccumulator()(channel, sum, sqsum, results, ranges);
     }
 };
 
@@ -195,6 +343,17 @@ public:
     bool generate_voxel_space (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies = std::vector<int> ());
     bool generate_voxel_surface (const std::vector<float>&);
     
+    /*
+     * Spectral map of the sampled voxels, an O(N log N) per voxel alternative to the voxel self-similarity.
+     * For every voxel the strongest non DC bin of its Hann windowed spectrum gives the dominant frequency in cycles per
+     * frame ( parabolic sub bin estimate ), the amplitude of that sinusoid in gray levels and its phase in
+     * radians. Maps are CV_32F at the expected segmented size.
+     */
+    bool generate_spectral_space (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies = std::vector<int> ());
+    const cv::Mat& frequency_map () const { return m_frequency_map; }
+    const cv::Mat& amplitude_map () const { return m_amplitude_map; }
+    const cv::Mat& phase_map () const { return m_phase_map; }
+    
     const uiPair &sample() { return m_voxel_sample; }
     const uiPair &half_offet() { return m_half_offset; }
     void sample(uint32_t x, uint32_t y = 0) {
@@ -213,11 +372,14 @@ public:
     const cv::Mat& temporal_ss () { return m_temporal_ss; }
     const std::vector<float>& entropies () { return m_voxel_entropies; }
     const std::vector<Eigen::Vector3d>& cloud () { return m_cloud; }
+    // Loaded voxels, voxel y * width + x of the sampled grid, one row of samples over time each
+    const std::vector<roiWindow<P8U>>& voxels () const { return m_voxels; }
     
 private:
     const smProducerRef similarity_producer () const;
     
     bool m_internal_generate();
+    bool m_spectral_generate();
     
   
     bool m_load(const std::vector<roiWindow<P8U>> &images, uint32_t sample_x,
@@ -234,6 +396,7 @@ private:
     mutable smProducerRef m_sm_producer;
     Rectf m_measured_area;
     cv::Mat m_temporal_ss;
+    cv::Mat m_frequency_map, m_amplitude_map, m_phase_map;
     std::vector<uint32_t> m_hist;
 };
 
@@ -296,7 +459,6 @@ private:
 	mutable std::vector<cv::Point2f> m_segmented_ends;
 	mutable std::vector<cv::Point2f> m_focals;
 	mutable std::vector<cv::Point2f> m_directrix;
-	std::vector<cv::Mat> m_filtered;
 	std::vector<cv::Mat> m_inputs;
     mutable std::vector<cv::Mat> m_dogs;
     mutable std::vector<cv::Mat> m_models;
@@ -15,6 +15,7 @@
 #include "cardiomyocyte_model.hpp"
 #include "core/stats.hpp"
 #include "core/stl_utils.hpp"
+#include "core/symmetric_matrix.hpp"
 #include "core/signaler.h"
 #include "core/lineseg.hpp"
 #include "eigen_utils.hpp"
@@ -195,14 +196,17 @@ public:
     // Load raw entropies and the self-similarity matrix
     // If no self-similarity matrix is given, entropies are assumed to be filtered and used directly
     // // input selector -1 entire index mobj index
-    void load (const vector<float>& entropies, const vector<vector<double>>& mmatrix = vector<vector<double>>());
+    void load (const vector<float>& entropies, const svl::symmetric_matrix<double>& mmatrix = svl::symmetric_matrix<double>());
 	
 	const contractionLocator::params& parameters () const { return m_params; }
 
  
     
     bool locate_contractions () ;
-    bool profile_contractions (const std::vector<float>& lengths = std::vector<float>());
+    // Signals contraction_ready when done, unless notify is false. Then notify_contractions signals it later,
+    // for handlers that must run on a given thread.
+    bool profile_contractions (const std::vector<float>& lengths = std::vector<float>(), bool notify = true);
+    void notify_contractions ();
 
     
     size_t size () const { return m_entsize; }
@@ -231,7 +235,7 @@ private:
 
 
     mutable double m_median_value;
-    mutable vector<vector<double>>        m_SMatrix;   // Used in eExhaustive and
+    svl::symmetric_matrix<double>        m_SMatrix;   // Shared with the producer, used in eExhaustive and
     vector<float>               m_entropies;
 
     mutable vector<float>              m_signal;
@@ -0,0 +1,195 @@
+#ifndef __PLAYBACK_RING__
+#define __PLAYBACK_RING__
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * playback_ring - Frames decoded ahead of the playhead on a background thread.
+ *
+ * A fixed ring of depth slots holds the frames playhead, playhead + stride, ... playhead + (depth - 1) stride,
+ * a negative stride reads ahead backwards. The decoder thread fills missing frames nearest to the playhead
+ * first, recycling the slots of frames that fell out of that window after a seek. The display thread
+ * calls seek() with its playhead and takes a ready frame with fetch() without blocking, so decode never
+ * runs on it. fetch() also reports a frame whose decode failed, so the display can move past it.
+ * decode is only ever called from the decoder thread.
+ *
+ * F is the frame type, e.g. a SurfaceRef. decode (index, frame) fills frame and returns false on failure.
+ */
+template<typename F>
+class playback_ring
+{
+public:
+    typedef std::function<bool(int64_t, F&)> decode_fn_t;
+    enum fetch_t { pending, fetched, failed };
+
+    // Frames [0, count)
+    playback_ring (decode_fn_t decode, int64_t count, size_t depth = 8)
+    : m_decode(std::move(decode)), m_count(count), m_slots(std::max(size_t(1), depth)),
+    m_playhead(0), m_stride(1), m_taken(-1), m_stop(false)
+    {
+        m_thread = std::thread(&playback_ring::decode_loop, this);
+    }
+
+    ~playback_ring ()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    playback_ring (const playback_ring&) = delete;
+    playback_ring& operator= (const playback_ring&) = delete;
+
+    size_t depth () const { return m_slots.size(); }
+    int64_t count () const { return m_count; }
+
+    // Move the read ahead window. stride is the step and direction of play, 0 is taken as 1.
+    void seek (int64_t playhead, int64_t stride = 1)
+    {
+        if (stride == 0) stride = 1;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            if (playhead == m_playhead && stride == m_stride) return;
+            m_playhead = playhead;
+            m_stride = stride;
+        }
+        m_wake.notify_one();
+    }
+
+    /*
+     * Take frame index once it is decoded, its slot is freed for read ahead.
+     * fetched: frame holds it. failed: its decode failed, frame is left as is. pending: not decoded yet.
+     * A fetched or failed frame counts as on display, it is not decoded again while it is in the window.
+     */
+    fetch_t fetch (int64_t index, F& frame)
+    {
+        fetch_t result = pending;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            for (auto& ss : m_slots)
+            {
+                if (ss.index != index || ss.state != slot::ready) continue;
+                if (ss.ok) frame = std::move(ss.frame);
+                result = ss.ok ? fetched : failed;
+                m_taken = index;
+                ss.index = -1;
+                ss.state = slot::empty;
+                break;
+            }
+        }
+        if (result != pending) m_wake.notify_one();
+        return result;
+    }
+
+    // True if frame index is decoded and waiting in the ring
+    bool ready (int64_t index) const
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        for (const auto& ss : m_slots)
+            if (ss.index == index && ss.state == slot::ready) return true;
+        return false;
+    }
+
+private:
+    struct slot
+    {
+        enum state_t { empty, decoding, ready };
+        slot () : index(-1), state(empty), ok(false) {}
+        int64_t index;
+        state_t state;
+        bool ok;
+        F frame;
+    };
+
+    bool in_window (int64_t index) const
+    {
+        if (index < 0) return false;
+        const int64_t offset = index - m_playhead;
+        if (offset % m_stride != 0) return false;
+        const int64_t kk = offset / m_stride;
+        return kk >= 0 && kk < int64_t(m_slots.size());
+    }
+
+    bool held (int64_t index) const
+    {
+        for (const auto& ss : m_slots)
+            if (ss.index == index) return true;
+        return false;
+    }
+
+    // Nearest frame of the window not held or just taken, and a slot for it. Called locked.
+    bool next_job (int64_t& index, size_t& si) const
+    {
+        index = -1;
+        for (size_t kk = 0; kk < m_slots.size(); kk++)
+        {
+            const int64_t ii = m_playhead + int64_t(kk) * m_stride;
+            if (ii < 0 || ii >= m_count) break;
+            if (ii != m_taken && ! held(ii))
+            {
+                index = ii;
+                break;
+            }
+        }
+        if (index < 0) return false;
+        for (si = 0; si < m_slots.size(); si++)
+            if (m_slots[si].state == slot::empty) return true;
+        for (si = 0; si < m_slots.size(); si++)
+            if (m_slots[si].state == slot::ready && ! in_window(m_slots[si].index)) return true;
+        return false;
+    }
+
+    void decode_loop ()
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        while (true)
+        {
+            int64_t index;
+            size_t si;
+            m_wake.wait(lk, [&] () { return m_stop || next_job(index, si); });
+            if (m_stop) return;
+
+            slot& ss = m_slots[si];
+            ss.index = index;
+            ss.state = slot::decoding;
+            // Decode unlocked, into the slot's previous frame so it can be reused
+            F frame = std::move(ss.frame);
+            lk.unlock();
+            bool ok = false;
+            try
+            {
+                ok = m_decode(index, frame);
+            }
+            catch (...)
+            {
+                ok = false;
+            }
+            lk.lock();
+            ss.frame = std::move(frame);
+            ss.ok = ok;
+            ss.state = slot::ready;
+        }
+    }
+
+    decode_fn_t m_decode;
+    const int64_t m_count;
+    std::vector<slot> m_slots;
+    int64_t m_playhead;
+    int64_t m_stride;
+    int64_t m_taken;     // last fetched, the one on display
+    bool m_stop;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include <fstream>
 #include <iostream>
 #include "core/core.hpp"
+#include "core/symmetric_matrix.hpp"
 
 
 
@@ -63,19 +64,19 @@ namespace cereal{
 
 class ssResultContainer {
 public:
+    typedef svl::symmetric_matrix<double> sMatrix_t;
+    
     explicit ssResultContainer() = default;
     void load (const deque<double>& entropies, const deque<deque<double>>& mmatrix){
         m_entropies = entropies;
-        m_mmatrix = mmatrix;
+        m_mmatrix = sMatrix_t::from_rows(mmatrix);
     }
     
-    void load (const vector<double>& entropies, const vector<vector<double>>& mmatrix){
+    // Shares the matrix, no element copies
+    template<typename Entropies>
+    void load (const Entropies& entropies, const sMatrix_t& mmatrix){
         m_entropies.assign(entropies.begin(), entropies.end());
-        deque<double> drow;
-        for (const vector<double>& row : mmatrix){
-            drow.assign(row.begin(),row.end());
-            m_mmatrix.push_back(drow);
-        }
+        m_mmatrix = mmatrix;
     }
     
     
@@ -94,54 +95,31 @@ public:
     }
     
     static bool store (const bfs::path& filepath, const deque<double>& entropies, const deque<deque<double>>& mmatrix){
-        bool ok = false;
         ssResultContainer ss;
         ss.load(entropies, mmatrix);
-        try{
-            std::ofstream file(filepath.c_str(), std::ios::binary);
-            cereal::PortableBinaryOutputArchive ar(file);
-            ar(ss);
-            ok = true;
-        } catch (cereal::Exception) {
-            ok = false;
-        }
-        return ok;
+        return ss.store(filepath);
     }
     
     
-    static bool store (const bfs::path& filepath, const vector<double>& entropies, const vector<vector<double>>& mmatrix){
-        bool ok = false;
+    template<typename Entropies>
+    static bool store (const bfs::path& filepath, const Entropies& entropies, const sMatrix_t& mmatrix){
         ssResultContainer ss;
         ss.load(entropies, mmatrix);
-        try{
-            std::ofstream file(filepath.c_str(), std::ios::binary);
-            cereal::PortableBinaryOutputArchive ar(file);
-            ar(ss);
-            ok = true;
-        } catch (cereal::Exception) {
-            ok = false;
-        }
-        return ok;
+        return ss.store(filepath);
     }
     
     const  deque<double>& entropies () const { return m_entropies; }
-    const  deque<deque<double>>& smatrix () const { return m_mmatrix; }
+    const  sMatrix_t& smatrix () const { return m_mmatrix; }
     
     bool size_check(size_t dim){
         bool ok = m_entropies.size() == dim;
         if (!ok ) return false;
-        ok = m_mmatrix.size() == dim;
-        if (!ok) return false;
-        for (auto row : m_mmatrix){
-            ok = row.size();
-            if (!ok) return false;
-        }
-        return true;
+        return m_mmatrix.size() == dim;
     }
     
     bool is_same(const ssResultContainer& other) const{
         
-        auto compare_double_deques = [] (const std::deque<double> a, const std::deque<double> b, double eps) {
+        auto compare_double_deques = [] (const std::deque<double>& a, const std::deque<double>& b, double eps) {
             if (a.size() != b.size()) return false;
             for (size_t i = 0; i < a.size(); i++) {
                 if (! svl::equal(a[i], b[i], eps)) {
@@ -152,33 +130,74 @@ public:
             return true;
         };
         
-        auto compare_2d_double_deques = [&compare_double_deques] (const std::deque<std::deque<double>> a,
-                                                                  const std::deque<std::deque<double>> b, double eps) {
+        auto compare_matrices = [] (const sMatrix_t& a, const sMatrix_t& b, double eps) {
             if (a.size() != b.size()) return false;
-            for (size_t i = 0; i < a.size(); i++) {
-                bool ok = compare_double_deques (a[i], b[i], eps );
-                if (!ok) return false;
-            }
+            for (size_t i = 0; i < a.size(); i++)
+                for (size_t j = i; j < a.size(); j++)
+                    if (! svl::equal(a(i, j), b(i, j), eps)) {
+                        std::cout << a(i, j) << " Should == " << b(i, j) << std::endl;
+                        return false;
+                    }
             return true;
         };
         
         bool ok = compare_double_deques (m_entropies, other.entropies(), double(1e-10));
         if (! ok ) return false;
-        ok = compare_2d_double_deques (m_mmatrix, other.smatrix(), double(1e-10));
+        ok = compare_matrices (m_mmatrix, other.smatrix(), double(1e-10));
         if (! ok ) return false;
         return true;
     }
     
 private:
+    bool store (const bfs::path& filepath) const {
+        bool ok = false;
+        try{
+            std::ofstream file(filepath.c_str(), std::ios::binary);
+            cereal::PortableBinaryOutputArchive ar(file);
+            ar(*this);
+            ok = true;
+        } catch (cereal::Exception) {
+            ok = false;
+        }
+        return ok;
+    }
+    
     deque<double> m_entropies;
-    deque<deque<double>> m_mmatrix;
+    sMatrix_t m_mmatrix;
     
     friend class cereal::access;
     
+    // The matrix is archived as deque<deque<double>> was, so existing caches stay readable
     template <class Archive>
-    void serialize( Archive & ar , std::uint32_t const version)
+    void save( Archive & ar , std::uint32_t const version) const
     {
-        ar& m_entropies& m_mmatrix;
+        ar& m_entropies;
+        const size_t dim = m_mmatrix.size();
+        ar(cereal::make_size_tag(static_cast<cereal::size_type>(dim)));
+        for (size_t row = 0; row < dim; row++){
+            ar(cereal::make_size_tag(static_cast<cereal::size_type>(dim)));
+            const double* vals = m_mmatrix.row(row);
+            for (size_t col = 0; col < dim; col++)
+                ar(vals[col]);
+        }
+    }
+    
+    template <class Archive>
+    void load( Archive & ar , std::uint32_t const version)
+    {
+        ar& m_entropies;
+        cereal::size_type dim;
+        ar(cereal::make_size_tag(dim));
+        sMatrix_t mmatrix (static_cast<size_t>(dim));
+        double* vals = mmatrix.mutable_data();
+        for (size_t row = 0; row < dim; row++){
+            cereal::size_type cols;
+            ar(cereal::make_size_tag(cols));
+            if (cols != dim) throw cereal::Exception("similarity matrix is not square");
+            for (size_t col = 0; col < dim; col++)
+                ar(*vals++);
+        }
+        m_mmatrix = mmatrix;
     }
 };
 
@@ -17,6 +17,7 @@
 #include <chrono>
 //#include "core/singleton.hpp"
 #include "core/stats.hpp"
+#include "core/symmetric_matrix.hpp"
 #include "core/stl_utils.hpp"
 
 
@@ -34,8 +35,10 @@ public:
     
     typedef roiWindow<P8U> image_t;
     typedef std::vector<image_t> images_vector_t;
+    typedef roiWindow<P16U> image16_t;
+    typedef std::vector<image16_t> images16_vector_t;
     typedef std::deque<double> sMatrixProjection_t;
-    typedef std::deque< std::deque<double> > sMatrix_t;
+    typedef svl::symmetric_matrix<double> sMatrix_t;  // shared, copies do not copy elements
     typedef std::tuple<size_t, double, bfs::path, image_t> outuple_t;
     typedef std::vector<outuple_t> ordered_outuple_t;
     using progress_fn_t = svl::progress_fn_t;
@@ -50,8 +53,11 @@ public:
   //  bool load_content_file (const string& fq_path);
     bool load_image_directory (const string& fq_path, sizeMappingOption szmap = dontCare);
     void load_images (const images_vector_t&);
+    // 16 bit frames are correlated at full depth. images() stays empty.
+    void load_images (const images16_vector_t&);
 
-    // launch async Will assert if not has_content
+    // launch async on the shared pool, as a stage job. Will assert if not has_content
+    // Do not wait on it from a pool job, use the blocking call
     std::future<bool> launch_async (int frames, const progress_fn_t& reporter=nullptr) const;
     
     // blocking call. Will not assert
@@ -81,6 +87,13 @@ public:
     const sMatrixProjection_t& shannonProjection (outputOrderOption ooo = input) const;
     
     const sMatrixProjection_t& medianLeveledProjection () const;
+    
+    /**
+     *  Batch fill of the similarity matrix as one normalized Gram matrix product.
+     *  See self_similarity_producer::batch. Off by default.
+     */
+    void batch (bool on);
+    bool batch () const;
 
     /**
      *  Image Directory Output & Options
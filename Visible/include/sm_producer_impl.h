@@ -55,6 +55,7 @@ public:
         signal_sm2d_available = createSignal<sm_producer::sig_cb_sm2d_available> ();
         m_loaded_ref.resize(0);
         m_source_type = Unknown;
+        m_batch = false;
     }
     
  //   bool load_content_file (const std::string& movie_fqfn);
@@ -62,6 +63,7 @@ public:
                             const std::vector<std::string>& supported_extensions = { ".jpg", ".png", ".JPG", ".jpeg"});
     
     void loadImages ( const images_vector_t& );
+    void loadImages ( const images16_vector_t& );
     const source_type type () const { return m_source_type; }
     
     bool done_grabbing () const;
@@ -100,6 +102,7 @@ private:
     
     time_spec_t       m_currentTime, m_startTime;
     mutable images_vector_t                 m_loaded_ref;
+    images16_vector_t                       m_loaded16_ref;
     int64_t                         m_frameRate;
     int64_t                          m_frameCount;
     int64_t                          m_elapasedFrames;
@@ -118,6 +121,7 @@ private:
     sm_producer::sMatrixProjection_t               m_entropies; // Final entropy signal
     sm_producer::sMatrixProjection_t               m_means; // Final entropy signal
     int                                      m_depth;
+    bool                                     m_batch;
     std::string                               m_name;
     
 };
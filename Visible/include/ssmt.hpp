@@ -22,6 +22,7 @@
 #include "cinder_xchg.hpp"
 #include "vision/histo.h"
 #include "vision/labelBlob.hpp"
+#include "vision/intensity_map16.hpp"
 #include "vision/opencv_utils.hpp"
 #include "opencv2/video/tracking.hpp"
 #include "algo_runners.hpp"
@@ -31,6 +32,8 @@
 #include "input_selector.hpp"
 #include "mediaInfo.h"
 #include "thread.h"
+#include "core/task_graph.hpp"
+#include "core/frame_pool.hpp"
 #include "contraction.hpp"
 #include "median_levelset.hpp"
 #include "mediaInfo.h"
@@ -62,7 +65,7 @@ public:
     public:
 
         params (const TypeDesc ct = TypeUInt8, const voxel_params_t voxel_params = voxel_params_t()):
-		m_type(ct), m_vparams(voxel_params), m_channel_to_use(0), m_channel_root(-1,m_channel_to_use){}
+		m_type(ct), m_vparams(voxel_params), m_channel_to_use(0), m_channel_root(-1,m_channel_to_use), m_voxel_spectral(false){}
         
         const TypeDesc& content_type () { return m_type; }
         
@@ -92,6 +95,10 @@ public:
 			return m_channel_root;
 		}
 		
+		// Voxel motion from the spectral map, the amplitude of each voxel's dominant frequency, instead of the voxel self-similarity
+		void voxel_spectral (bool on) const { m_voxel_spectral = on; }
+		bool voxel_spectral () const { return m_voxel_spectral; }
+		
 		
 		
     private:
@@ -100,6 +107,7 @@ public:
         mutable TypeDesc m_type;
 		mutable int m_channel_to_use;
 		mutable result_index_channel_t m_channel_root;
+		mutable bool m_voxel_spectral;
 		
     };
     
@@ -122,6 +130,8 @@ public:
 
     typedef std::vector<roiWindow<P8U>> channel_images_t;
     typedef std::vector<channel_images_t> channel_vec_t;
+    typedef std::vector<roiWindow<P16U>> channel_images16_t;
+    typedef std::vector<channel_images16_t> channel_vec16_t;
     
     /*
        ssmt_processor constructor (takes an optional path to cache to be used or constructed )
@@ -136,13 +146,18 @@ public:
     
     const svl::stats<int64_t> stats3D () const;
     cv::Mat & segmented () const { return m_temporal_ss;  }
+    // Per voxel dominant frequency ( cycles per frame ), amplitude and phase. Made in place of the voxel self-similarity
+    // when params voxel_spectral is set, before signal_ss_voxel_ready. Empty otherwise
+    const cv::Mat& voxel_frequency_map () const { return m_voxel_frequency; }
+    const cv::Mat& voxel_amplitude_map () const { return m_voxel_amplitude; }
+    const cv::Mat& voxel_phase_map () const { return m_voxel_phase; }
     const std::vector<Rectf>& channel_rois () const;
     const  std::deque<double>& medianSet () const;
  
     // Update. Called also when cutoff offset has changed
     //void update (const input_section_selector_t&);
 	void update();
-    const vector<vector<double>>& ssMatrix () const { return m_smat; }
+    const sm_producer::sMatrix_t& ssMatrix () const { return m_smat; }
 	const vector<double>& entropies () const { return m_entropies; }
 	const vector<float>& entropies_F () const { return m_entropies_F; }
     
@@ -169,6 +184,13 @@ public:
     // signal_geometry_ready indicates results are ready.
     void find_moving_regions (const int channel_index);
     const std::vector<std::shared_ptr<ssmt_result>>& moving_bodies ()const { return m_results; }
+    
+    // Post a pipeline stage to the shared pool. Stages not started yet are dropped by cancel_pending.
+    void post_stage (std::function<void()> job);
+    void cancel_pending ();
+    
+    // Run the stages of all moving bodies concurrently, see ssmt_result::schedule. Returns true if all succeeded.
+    bool process_moving_bodies ();
     const std::vector<moving_region>& moving_regions ()const;
     const Rectf& measuredArea () const;
     
@@ -192,6 +214,14 @@ public:
     
     void finalize_segmentation (cv::Mat& mono, cv::Mat& label);
     const channel_vec_t& content () const;
+    
+    // 16 bit content: the frames at full depth, content() holds them mapped through intensity_map().
+    // Entire view similarity and volume stats run on these. Empty for 8 bit content.
+    const channel_vec16_t& content16 () const;
+    const svl::intensity_map16& intensity_map () const { return m_intensity_map; }
+    
+    // Frame buffers allocated by this processor's stages, freed together with it
+    svl::frame_pool::counters frame_stats () const { return m_arena.stats(); }
   
 	medianLevelSet& medianLeveler () { return m_leveler; }
 	
@@ -216,7 +246,8 @@ private:
     // 2nd interface is lower level interface
        // args:
        // images: vector of roiWindow<P8U>s. roiWindow<P8U> is a single plane image container.
-   void internal_run_selfsimilarity_on_selected_input  (const std::vector<roiWindow<P8U>>& images,  const result_index_channel_t&,const progress_fn_t& reporter);
+   template<typename P>
+   void internal_run_selfsimilarity_on_selected_input  (const std::vector<roiWindow<P>>& images,  const result_index_channel_t&,const progress_fn_t& reporter);
 
     // Assumes LIF data -- use multiple window.
     void internal_load_channels_from_lif_buffer2d (const std::shared_ptr<ImageBuf>& frames,  const ustring& contentName, const mediaSpec& sd);
@@ -226,7 +257,15 @@ private:
     
     // Internal use
     // Vector of 8bit roiWindows API for IDLab custom organization
-    svl::stats<int64_t> run_volume_stats (std::vector<roiWindow<P8U>>&);
+    template<typename P>
+    svl::stats<int64_t> run_volume_stats (std::vector<roiWindow<P>>&);
+    template<typename P>
+    void internal_volume_pass (std::vector<roiWindow<P>>&);
+    template<typename P>
+    void internal_volume_finish (const typename VolumeAccumulatorT<P>::stream&);
+    template<typename P>
+    void internal_volume_finish (cv::Mat& sum, cv::Mat& sqsum, const std::vector<typename VolumeAccumulatorT<P>::moments_t>&,
+                                 const std::vector<typename VolumeAccumulatorT<P>::range_t>&);
     void internal_find_moving_regions (std::vector<roiWindow<P8U>>& );
     
     
@@ -278,6 +317,8 @@ private:
     std::vector<std::shared_ptr<ssmt_result>> m_results;
     std::vector<moving_region> m_regions;
     
+    svl::cancel_token m_stages;
+    svl::frame_arena m_arena;
     mutable std::mutex m_mutex;
     mutable std::mutex m_shortterms_mutex;
     mutable std::mutex m_segmentation_mutex;
@@ -293,10 +334,12 @@ private:
 
 	mutable vector<double> m_entropies;
 	mutable vector<float> m_entropies_F;
-    mutable vector<vector<double>> m_smat;
+    mutable sm_producer::sMatrix_t m_smat;
     
     channel_images_t m_images;
     channel_vec_t m_all_by_channel;
+    channel_vec16_t m_all_by_channel16;
+    svl::intensity_map16 m_intensity_map;
     
     int64_t m_frameCount;
     Rectf m_measured_area;
@@ -307,8 +350,10 @@ private:
     
     
     mutable svl::stats<int64_t> m_volume_stats;
+    int m_streamed_volume_channel; // Channel whose volume stats the load computed, -1 if none
     std::atomic<bool> m_variance_peak_detection_done;
     mutable cv::Mat m_temporal_ss;
+    cv::Mat m_voxel_frequency, m_voxel_amplitude, m_voxel_phase;
     mutable cv::Mat m_var_image;
     uiPair m_voxel_sample;
     iPair m_expected_segmented_size;
@@ -349,9 +394,25 @@ public:
 	
 	bool generateRegionImages () const;
 	
+	// Crops the region images of all results in one pass over the frames. Results share their parent and channel.
+	static bool generateRegionImages (const std::vector<ref_t>& results);
+	
+	// Affine transform from a frame to its crop of box, the box sized getRectSubPix of the frame rotated about the box center
+	static cv::Mat crop_transform (const cv::RotatedRect& box);
+	// Crop of one frame as region images are made, crop has the box size. Outside the frame is 0
+	static void crop_frame (const roiWindow<P8U>& frame, const cv::Mat& transform, roiWindow<P8U>& crop);
+	
 	bool run_selfsimilarity ();
 
+	// Runs all stages in order on the calling thread
 	bool process ();
+	
+	// Adds the stages to graph: region images, then self-similarity and scale space, contractions
+	// independently, and the contraction profile once all are done. Returns the profile's node.
+	// The profile does not signal its contractions, call notify_contractions once the graph has run.
+	svl::task_graph::node_t schedule (svl::task_graph& graph);
+	void notify_contractions ();
+	
     bool segment_at_contraction (const std::vector<roiWindow<P8U>>& images, const std::vector<int> &peak_indices);
     
 //    const trackMap_t& trackBook () const;
@@ -363,7 +424,7 @@ public:
     const std::shared_ptr<contractionLocator> & locator () const;
 	const vector<float>& entropies () const;
 	const vector<double>& leveled () const;
-	const std::vector<std::vector<double>> ssMatrix () const;
+	const sm_producer::sMatrix_t& ssMatrix () const { return m_smat; }
 	const medianLevelSet& leveler () const { return m_leveler; }
 	const lengthFromMotion& lfm () const { return m_scale_space; }
 	
@@ -371,15 +432,19 @@ public:
 private:
     bool run_selfsimilarity_on_region (const std::vector<roiWindow<P8U>>& images);
 	bool run_scale_space (const std::vector<roiWindow<P8U>>& images);
+	bool locate_contractions ();
+	bool run_scale_space_stage ();
+	bool profile_contractions (bool notify = true);
 	
     ssmt_result (const moving_region&,const result_index_channel_t& in);
     void signal_sm1d_ready (vector<float>&, const result_index_channel_t&);
     void contraction_ready (contractionLocator::contractionContainer_t& contractions, const result_index_channel_t&);
     bool get_channels (int channel) const ;
+    static bool crop_regions (const std::vector<const ssmt_result*>& results, int channel);
     result_index_channel_t m_input;
     
 	vector<float> m_entropies, m_leveled;
-    std::vector<std::vector<double>> m_smat;
+    sm_producer::sMatrix_t m_smat;
     
     std::shared_ptr<contractionLocator> m_caRef;
 	medianLevelSet m_leveler;
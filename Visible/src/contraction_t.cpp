@@ -80,7 +80,7 @@ contractionLocator::contractionLocator(const result_index_channel_t& in,  const
     cell_length_ready = createSignal<contractionLocator::sig_cb_cell_length_ready>();
 }
 
-void contractionLocator::load(const vector<float>& entropies, const vector<vector<double>>& mmatrix)
+void contractionLocator::load(const vector<float>& entropies, const svl::symmetric_matrix<double>& mmatrix)
 {
     m_entropies = entropies;
     m_SMatrix = mmatrix;
@@ -274,7 +274,7 @@ int contractionLocator::lookup_peak_location(const int peak_index) const {
         // Note: Lengths are in units of microns.
 		// lengthFromMotion is created with Magnification X
 		// And converts accordingly
-bool contractionLocator::profile_contractions (const std::vector<float>& lengths){
+bool contractionLocator::profile_contractions (const std::vector<float>& lengths, bool notify){
     perf::timer timeit;
     timeit.start();
     
@@ -300,8 +300,7 @@ bool contractionLocator::profile_contractions (const std::vector<float>& lengths
         vlogger::instance().console()->info(ss.str());
     }
     
-    if (contraction_ready && contraction_ready->num_slots() > 0)
-        contraction_ready->operator()(m_contractions, m_in);
+    if (notify) notify_contractions();
 
     timeit.stop();
     auto timestr = toString(std::chrono::duration_cast<milliseconds>(timeit.duration()).count());
@@ -315,6 +314,10 @@ bool contractionLocator::profile_contractions (const std::vector<float>& lengths
 
 
 
+void contractionLocator::notify_contractions (){
+    if (contraction_ready && contraction_ready->num_slots() > 0)
+        contraction_ready->operator()(m_contractions, m_in);
+}
 
 template boost::signals2::connection contractionLocator::registerCallback(const std::function<contractionLocator::sig_cb_contraction_ready>&);
 
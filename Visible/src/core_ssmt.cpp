@@ -20,6 +20,7 @@
 #include <sstream>
 #include <map>
 #include "oiio_utils.hpp"
+#include "core/frame_source.hpp"
 #include "timed_types.h"
 #include "core/signaler.h"
 #include "sm_producer.h"
@@ -37,7 +38,7 @@
  
  */
 ssmt_processor::ssmt_processor (const mediaSpec& ms, const bfs::path& serie_cache_folder,  const ssmt_processor::params& params):
-mCurrentCachePath(serie_cache_folder), m_params(params), m_media_spec(ms)
+mCurrentCachePath(serie_cache_folder), m_params(params), m_streamed_volume_channel(-1), m_media_spec(ms)
 {
     // Signals we provide
     signal_content_loaded = createSignal<ssmt_processor::sig_cb_content_loaded>();
@@ -174,91 +175,179 @@ void ssmt_processor::load_channels_from_ImageBuf(const std::shared_ptr<ImageBuf>
      
      */
     internal_load_channels_from_lif_buffer2d(frames, contentName, mspec);
+    const bool volume_ready = m_streamed_volume_channel >= 0;
     lock.unlock();
     
     // Call the content loaded cb if any
     if (signal_content_loaded && signal_content_loaded->num_slots() > 0)
         signal_content_loaded->operator()(m_frameCount);
+    
+    // Volume stats were accumulated during the load
+    if (volume_ready && signal_volume_ready && signal_volume_ready->num_slots() > 0)
+        signal_volume_ready->operator()();
 	
 	// Dispatch a thread to perform ss on entire -- root -- image
 	result_index_channel_t entire(-1,0);
 	assert(entire.isEntire());
-	auto ss_thread = std::thread(&ssmt_processor::run_selfsimilarity_on_selected_input,this, entire,nullptr);
-	ss_thread.detach();
+	auto self = shared_from_this();
+	post_stage([self, entire] () { self->run_selfsimilarity_on_selected_input(entire, nullptr); });
 	
 }
 
-// @todo condider creating cv::Mats and convert to roiWindow when needed.
 // @todo consider passing ImageBuf to similarity so that it can fetch image directly and does not need all images in memory
-// 16bit is converted to 8 bit for now using normalize
+// 16bit is kept at full depth and mapped to 8 bit with one volume wide intensity map
+// Frames are fetched once, roots adopt the fetched cv::Mat buffers and channel sections alias them
+// Frames are read ahead on a frame_source thread while the loaded ones are sectioned and the volume
+// stats of the last channel, the one processed, are accumulated. The stats are ready with the last frame.
 
 void ssmt_processor::internal_load_channels_from_lif_buffer2d (const std::shared_ptr<ImageBuf>& frames, const ustring& contentName,
                                                       const mediaSpec& mspec)
 {
     m_frameCount = 0;
     m_all_by_channel.clear();
+    m_all_by_channel16.clear();
+    m_intensity_map = svl::intensity_map16 ();
+    m_streamed_volume_channel = -1;
     m_channel_count = mspec.getSectionCount();
     m_all_by_channel.resize (m_channel_count);
     
     auto nsubs = frames->nsubimages();
     int width = mspec.getSectionSize().first;
     int height = mspec.getSectionSize().second;
+    const int visible = m_channel_count - 1;
+    
+    // ImageBuf is read from the source's thread only
+    const size_t read_ahead = 32;
+    svl::frame_source<cv::Mat> source ([&frames, &contentName] (size_t t0, size_t t1, std::vector<cv::Mat>& mats) {
+        for (size_t tt = t0; tt < t1; tt++)
+            mats.push_back(getRootFrame(frames, contentName, int(tt)));
+    }, size_t(std::max(nsubs, 0)), read_ahead);
+    size_t index;
+    cv::Mat cvb;
     
     auto format = m_params.content_type();
     if (format == TypeUInt8){
-            for (auto ii = 0; ii < nsubs; ii++){
-                auto cvb = getRootFrame(frames, contentName, ii);
+            VolumeAccumulator::stream volume;
+            while (source.next(index, cvb)){
                 assert(cvb.type() == CV_8U);
                 roiWindow<P8U> r8;
-                cpCvMatToRoiWindow8U (cvb, r8);
+                refCvMatToRoiWindow8U (cvb, r8);
                 
                 for (auto cc = 0; cc < mspec.getSectionCount(); cc++){
                     auto tl_f_x = mspec.getROIxRanges()[cc][0];
                     auto tl_f_y = mspec.getROIyRanges()[cc][0];
                     m_all_by_channel[cc].emplace_back(r8.frameBuf(),tl_f_x,tl_f_y,width,height);
                 }
+                volume.add(m_all_by_channel[visible].back());
                 m_frameCount++;
             }
+            internal_volume_finish<P8U>(volume);
     }
     else if (format == TypeUInt16){
-            for (auto ii = 0; ii < nsubs; ii++){
-                auto cvb = getRootFrame(frames, contentName, ii);
+            std::vector<roiWindow<P16U>> r16s;
+            r16s.reserve(nsubs);
+            VolumeAccumulator16::stream volume;
+            uint16_t lo = std::numeric_limits<uint16_t>::max(), hi = 0;
+            while (source.next(index, cvb)){
                 assert(cvb.type() == CV_16U);
-                cv::Mat cvb8 (cvb.rows, cvb.cols, CV_8U);
-                cv::normalize(cvb, cvb8, 0, 255, NORM_MINMAX, CV_8UC1);
-                roiWindow<P8U> r8;
-                cpCvMatToRoiWindow8U (cvb8, r8);
-                
+                r16s.emplace_back();
+                refCvMatToRoiWindow16U (cvb, r16s.back());
+                // Range of the whole volume as frames arrive, then every frame through the same map
+                const auto mm = svl::intensity_map16::range(r16s.end() - 1, r16s.end());
+                lo = std::min(lo, mm.first);
+                hi = std::max(hi, mm.second);
+                volume.add(roiWindow<P16U>(r16s.back().frameBuf(), mspec.getROIxRanges()[visible][0],
+                                           mspec.getROIyRanges()[visible][0], width, height));
+            }
+            if (lo > hi) return;
+            internal_volume_finish<P16U>(volume);
+            m_intensity_map = svl::intensity_map16 (lo, hi);
+            std::vector<roiWindow<P8U>> r8s (r16s.size());
+            svl::thread_pool::global().parallel_for(r16s.size(), [&] (size_t ii) {
+                svl::frame_pool::scope in_arena (m_arena.pool());
+                r8s[ii] = m_intensity_map.map(r16s[ii]);
+            });
+        
+            m_all_by_channel16.resize (m_channel_count);
+            for (size_t ii = 0; ii < r16s.size(); ii++){
                 for (auto cc = 0; cc < mspec.getSectionCount(); cc++){
                     auto tl_f_x = mspec.getROIxRanges()[cc][0];
                     auto tl_f_y = mspec.getROIyRanges()[cc][0];
-                    m_all_by_channel[cc].emplace_back(r8.frameBuf(),tl_f_x,tl_f_y,width,height);
+                    m_all_by_channel[cc].emplace_back(r8s[ii].frameBuf(),tl_f_x,tl_f_y,width,height);
+                    m_all_by_channel16[cc].emplace_back(r16s[ii].frameBuf(),tl_f_x,tl_f_y,width,height);
                 }
                 m_frameCount++;
             }
     }
     else{
         assert(false);
+        return;
     }
+    if (m_frameCount > 0) m_streamed_volume_channel = visible;
 }
 
 
 /*
- * 1 monchrome channel. Compute volume stats of each on a thread
+ * 1 monchrome channel. One fused pass over the frames for both the volume stats and the
+ * per pixel deviation peaks, see volume_variance_peak_promotion
  */
 
-svl::stats<int64_t> ssmt_processor::run_volume_stats (std::vector<roiWindow<P8U>>& images){
-    std::lock_guard<std::mutex> lock(m_mutex);
+template<typename P>
+void ssmt_processor::internal_volume_pass (std::vector<roiWindow<P>>& images){
+    typedef VolumeAccumulatorT<P> accumulator_t;
+    m_variance_peak_detection_done = false;
+    cv::Mat m_sum, m_sqsum;
+    std::vector<typename accumulator_t::moments_t> cts;
+    std::vector<typename accumulator_t::range_t> rts;
+    accumulator_t()(images, m_sum, m_sqsum, cts, rts);
+    internal_volume_finish<P>(m_sum, m_sqsum, cts, rts);
+}
+
+// Volume pass over frames accumulated as they were loaded
+template<typename P>
+void ssmt_processor::internal_volume_finish (const typename VolumeAccumulatorT<P>::stream& volume){
+    typedef VolumeAccumulatorT<P> accumulator_t;
+    m_variance_peak_detection_done = false;
+    cv::Mat m_sum, m_sqsum;
+    std::vector<typename accumulator_t::moments_t> cts;
+    std::vector<typename accumulator_t::range_t> rts;
+    volume.finish(m_sum, m_sqsum, cts, rts);
+    internal_volume_finish<P>(m_sum, m_sqsum, cts, rts);
+}
+
+template<typename P>
+void ssmt_processor::internal_volume_finish (cv::Mat& m_sum, cv::Mat& m_sqsum,
+                                             const std::vector<typename VolumeAccumulatorT<P>::moments_t>& cts,
+                                             const std::vector<typename VolumeAccumulatorT<P>::range_t>& rts){
+    typedef typename VolumeAccumulatorT<P>::pixel_t pixel_t;
+    if (cts.empty()) return;
     
-    std::vector<std::tuple<int64_t,int64_t,uint32_t>> cts;
-    std::vector<std::tuple<uint8_t,uint8_t>> rts;
-    std::vector<std::thread> threads(1);
-    threads[0] = std::thread(IntensityStatisticsPartialRunner(),std::ref(images), std::ref(cts), std::ref(rts));
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
     auto res = std::accumulate(cts.begin(), cts.end(), std::make_tuple(int64_t(0),int64_t(0), uint32_t(0)), stl_utils::tuple_sum<int64_t,uint32_t>());
-    auto mes = std::accumulate(rts.begin(), rts.end(), std::make_tuple(uint8_t(255),uint8_t(0)), stl_utils::tuple_minmax<uint8_t, uint8_t>());
+    auto mes = std::accumulate(rts.begin(), rts.end(), std::make_tuple(std::numeric_limits<pixel_t>::max(),pixel_t(0)), stl_utils::tuple_minmax<pixel_t, pixel_t>());
     m_volume_stats = svl::stats<int64_t> (std::get<0>(res), std::get<1>(res), std::get<2>(res), int64_t(std::get<0>(mes)), int64_t(std::get<1>(mes)));
     
+    SequenceAccumulator::computeStdev(m_sum, m_sqsum, int(cts.size()), m_var_image);
+    // 16 bit sums are double
+    if (m_var_image.type() != CV_32F) m_var_image.convertTo(m_var_image, CV_32F);
+    /*
+     * Save Only local maximas in the var field
+     */
+    m_var_peaks.resize(0);
+    svl::PeakDetect(m_var_image, m_var_peaks);
+    cv::Mat tmp = m_var_image.clone();
+    tmp = 0.0;
+    for(cv::Point& peak : m_var_peaks){
+        tmp.at<float>(peak.y,peak.x) = m_var_image.at<float>(peak.y,peak.x);
+    }
+    cv::normalize(tmp, m_var_image, 0, 255, NORM_MINMAX, CV_8UC1);
+    m_variance_peak_detection_done = true;
+}
+
+template<typename P>
+svl::stats<int64_t> ssmt_processor::run_volume_stats (std::vector<roiWindow<P>>& images){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    internal_volume_pass(images);
+    
     // Signal to listeners
     if (signal_volume_ready && signal_volume_ready->num_slots() > 0)
         signal_volume_ready->operator()();
@@ -267,7 +356,16 @@ svl::stats<int64_t> ssmt_processor::run_volume_stats (std::vector<roiWindow<P8U>
 }
 
 
+// 16 bit content is measured at full depth. The processed channel's stats are already computed by the load.
 svl::stats<int64_t> ssmt_processor::run_volume_stats (const int channel_index){
+    if (channel_index == m_streamed_volume_channel){
+        if (signal_volume_ready && signal_volume_ready->num_slots() > 0)
+            signal_volume_ready->operator()();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_volume_stats;
+    }
+    if (! m_all_by_channel16.empty())
+        return run_volume_stats(m_all_by_channel16[channel_index]);
     return run_volume_stats(m_all_by_channel[channel_index]);
 }
 
@@ -310,7 +408,8 @@ void ssmt_processor::volume_stats_computed(){
 // @todo add params
 // Run to get Entropies and Median Level Set
 // PCI track is being used for initial emtropy and median leveled
-void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::vector<roiWindow<P8U>>& images,
+template<typename P>
+void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::vector<roiWindow<P>>& images,
                                                                     const result_index_channel_t& in,
                                                                     const progress_fn_t& reporter)
 {
@@ -329,29 +428,20 @@ void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::v
     // @todo: add params
 	m_entropies.clear();
 	m_entropies_F.clear();
-	m_smat.clear();
+	m_smat = sm_producer::sMatrix_t ();
     
     if(cache_ok){
         vlogger::instance().console()->info(" SS result container cache : Hit ");
 		m_entropies.insert(m_entropies.end(), ssref->entropies().begin(), ssref->entropies().end());
-		for (auto row : ssref->smatrix()){
-			vector<double> rowv;
-			rowv.insert(rowv.end(), row.begin(), row.end());
-			m_smat.push_back(rowv);
-		}
+		m_smat = ssref->smatrix();
     }else{
         auto sp =  similarity_producer();
         sp->load_images (images);
-        std::future<bool>  future_ss = sp->launch_async(0, reporter);
-        vlogger::instance().console()->info(" async ss submitted ");
-        if (future_ss.get()){
-            vlogger::instance().console()->info(" async ss finished ");
+        vlogger::instance().console()->info(" ss started ");
+        if (sp->operator()(0, reporter)){
+            vlogger::instance().console()->info(" ss finished ");
 			m_entropies.insert(m_entropies.end(), sp->shannonProjection ().begin(),sp->shannonProjection ().end());
-			for (auto row : sp->similarityMatrix()){
-				vector<double> rowv;
-				rowv.insert(rowv.end(), row.begin(), row.end());
-				m_smat.push_back(rowv);
-			}
+			m_smat = sp->similarityMatrix();
         }
     }
     m_entropies_F.insert(m_entropies_F.end(), m_entropies.begin(), m_entropies.end());
@@ -364,7 +454,6 @@ void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::v
 		vlogger::instance().console()->info(" SS result container cache : failed ");
 	
     assert(images.size() == m_entropies.size() && m_smat.size() == images.size());
-    for (auto row : m_smat) assert(row.size() == images.size());
     assert(images.size() == m_entropies_F.size());
     
     // Signal we are done with ACI
@@ -380,6 +469,11 @@ void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::v
 void ssmt_processor::run_selfsimilarity_on_selected_input (const result_index_channel_t& in, const progress_fn_t& reporter){
     // protect fetching image data
     std::lock_guard<std::mutex> lock(m_mutex);
+    // 16 bit content is correlated at full depth
+    if (in.isEntire() && ! m_all_by_channel16.empty()){
+        internal_run_selfsimilarity_on_selected_input(m_all_by_channel16[in.section()], in, reporter);
+        return;
+    }
     const auto& _content = in.isEntire() ? content()[in.section()] : m_results[in.region()]->content()[in.section()];
     internal_run_selfsimilarity_on_selected_input(std::move(_content), in, reporter);
 }
@@ -393,32 +487,12 @@ void ssmt_processor::signal_geometry_done (int count, const result_index_channel
 /* UnUsed
  * 1 monchrome channel. Compute 3D Standard Dev. per pixel
  * the atomic bool m_3d_stats_done is set to true
+ * Same pass as run_volume_stats, which already fills m_var_image and m_var_peaks
  */
 
 void ssmt_processor::volume_variance_peak_promotion (std::vector<roiWindow<P8U>>& images){
     std::lock_guard<std::mutex> lock(m_mutex);
-    
-    cv::Mat m_sum, m_sqsum;
-    int image_count = 0;
-    std::vector<std::thread> threads(1);
-    threads[0] = std::thread(SequenceAccumulator(),std::ref(images),
-                             std::ref(m_sum), std::ref(m_sqsum), std::ref(image_count), std::ref(m_variance_peak_detection_done));
-    
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
-    SequenceAccumulator::computeStdev(m_sum, m_sqsum, image_count, m_var_image);
-    /*
-     * Save Only local maximas in the var field
-     */
-    m_var_peaks.resize(0);
-    svl::PeakDetect(m_var_image, m_var_peaks);
-    cv::Mat tmp = m_var_image.clone();
-    tmp = 0.0;
-    for(cv::Point& peak : m_var_peaks){
-        tmp.at<float>(peak.y,peak.x) = m_var_image.at<float>(peak.y,peak.x);
-    }
-    cv::normalize(tmp, m_var_image, 0, 255, NORM_MINMAX, CV_8UC1);
-    m_variance_peak_detection_done = true;
-    
+    internal_volume_pass(images);
 }
 
 /**
@@ -485,10 +559,44 @@ const std::vector<moving_region>& ssmt_processor::moving_regions ()const {
     return m_regions;
 }
 
+// Stages allocate their frames from the processor's arena
+void ssmt_processor::post_stage (std::function<void()> job){
+    auto arena = m_arena.pool();
+    svl::thread_pool::global().post([job, arena] () {
+        svl::frame_pool::scope in_arena (arena);
+        job();
+    }, svl::thread_pool::priority::normal, m_stages);
+}
+
+void ssmt_processor::cancel_pending (){
+    m_stages.cancel();
+}
+
+bool ssmt_processor::process_moving_bodies (){
+    // Region images of all moving bodies in one pass over the frames, then one graph
+    // for their stages on the global pool
+    ssmt_result::generateRegionImages(m_results);
+    svl::task_graph graph;
+    std::vector<svl::task_graph::node_t> profiles;
+    for (const ssmt_result::ref_t& sr : m_results)
+        profiles.push_back(sr->schedule(graph));
+    const bool done = graph.run();
+    
+    // Contraction handlers are not thread safe: they are signaled here, on the calling thread,
+    // one region after another
+    for (size_t rr = 0; rr < m_results.size(); rr++)
+        if (graph.succeeded(profiles[rr])) m_results[rr]->notify_contractions();
+    return done;
+}
+
 const ssmt_processor::channel_vec_t& ssmt_processor::content () const{
     return m_all_by_channel;
 }
 
+const ssmt_processor::channel_vec16_t& ssmt_processor::content16 () const{
+    return m_all_by_channel16;
+}
+
 
 #ifdef notYet
 
@@ -53,14 +53,18 @@ mFqfnPath(fqfn_path), m_data_ready(false) {
 const lif_serie_data  lif_browser::get_serie_by_index (unsigned index){
     lif_serie_data si;
     get_series_info();
+    std::lock_guard<std::mutex> lock(m_mutex);
     if (index < m_series_book.size())
-        si = m_series_book[index];
+        si = serie_data(index);
     return si;
     
 }
 
 const std::vector<lif_serie_data>& lif_browser::get_all_series  () const{
     get_series_info();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (unsigned ss = 0; ss < m_series_book.size(); ss++)
+        serie_data(ss);
     return m_series_book;
 }
 
@@ -70,27 +74,40 @@ const std::vector<std::string>& lif_browser::names () const{
     
 }
 
+/**
+ Serie data is built on first use, building it reads the serie's header and its poster frame.
+ Caller holds m_mutex
+ */
+const lif_serie_data& lif_browser::serie_data (unsigned index) const
+{
+    if (m_series_book[index].index() < 0)
+        m_series_book[index] = lif_serie_data(m_lifRef, index);
+    return m_series_book[index];
+}
 
+/**
+ Opens the reader from the header index when it is current, and collects serie names only.
+ */
 void  lif_browser::internal_get_series_info () const
 {
     if ( exists(boost::filesystem::path(mFqfnPath)))
     {
-        m_lifRef =  lifIO::LifReader::create(mFqfnPath);
+        m_lifRef =  lifIO::LifReader::create(mFqfnPath, false, true);
         m_series_book.clear ();
         m_series_names.clear();
         
         for (unsigned ss = 0; ss < m_lifRef->getNbSeries(); ss++)
         {
-            lif_serie_data si(m_lifRef, ss);
-            m_series_book.emplace_back (si);
-            m_series_names.push_back(si.name());
+            const std::string name = m_lifRef->getSerie(ss).getName();
+            m_series_names.push_back(name);
             // Fill up names / index map -- convenience
             auto index = static_cast<int>(ss);
-            m_name_to_index[si.name()] = index;
-            m_index_to_name[index] = si.name();
+            m_name_to_index[name] = index;
+            m_index_to_name[index] = name;
         }
-        m_data_ready.store(true, std::memory_order_release);
+        m_series_book.resize(m_series_names.size());
     }
+    m_data_ready.store(true, std::memory_order_release);
 }
 
 // Yield while finishing up
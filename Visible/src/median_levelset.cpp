@@ -16,6 +16,9 @@ using namespace boost;
 namespace anonymous
 {
 	recursive_mutex mls_mutex;
+	
+	// m_rank_sums is rebuilt once refresh_rows x size rows were moved into or out of it
+	const size_t refresh_rows = 16;
 }
 
 
@@ -38,7 +41,7 @@ void medianLevelSet::initialize(const result_index_channel_t& in,  const uint32_
 	med_levelset_pci_ready = createSignal<medianLevelSet::sig_cb_mls_pci_ready> ();
 }
 
-void medianLevelSet::load(const vector<double>& entropies, const vector<vector<double>>& mmatrix)
+void medianLevelSet::load(const vector<double>& entropies, const svl::symmetric_matrix<double>& mmatrix)
 {
 	m_entropies = entropies;
 	m_SMatrix = mmatrix;
@@ -47,6 +50,10 @@ void medianLevelSet::load(const vector<double>& entropies, const vector<vector<d
 	m_entsize = m_entropies.size();
 	m_ranks.resize (m_entsize);
 	m_signal.resize (m_entsize);
+	m_cached = false;
+	m_rank_sums.assign (m_entsize, 0.0);
+	m_summed = 0;
+	m_moved_rows = 0;
 
 
 	mValidInput = verify_input ();
@@ -56,6 +63,9 @@ void medianLevelSet::compute_median_levelsets () const
 {
 	if (m_cached) return;
 	m_median_value = medianLevelSet::Median_levelsets (m_entropies, m_ranks);
+	m_rank_sums.assign (m_entropies.size(), 0.0);
+	m_summed = 0;
+	m_moved_rows = 0;
 	m_cached = true;
 }
 
@@ -85,23 +95,44 @@ double medianLevelSet::Median_levelsets (const vector<double>& entropies,  std::
 	return median_value;
 }
 
+/*
+ * Signal is the mean of the similarity rows of the count entropies closest to the median.
+ * m_rank_sums holds the sum of the rows of ranks [0, m_summed), so moving the fraction adds or
+ * removes only the rows in between, each a contiguous row of the symmetric matrix. It is rebuilt
+ * from zero when that is fewer rows, and after enough moved rows to bound the rounding drift of
+ * the running sum.
+ */
 size_t medianLevelSet::recompute_signal () const
 {
-	
 	size_t count = std::floor (m_entropies.size () * m_median_levelset_frac);
 	assert(count < m_ranks.size());
 	m_signal.resize(m_entropies.size (), 0.0);
-	for (auto ii = 0; ii < m_signal.size(); ii++)
-	{
-	double val = 0;
-	for (int index = 0; index < count; index++)
-		{
-		auto jj = m_ranks[index]; // get the actual index from rank
-		val += m_SMatrix[jj][ii]; // fetch the cross match value for
+	if (m_SMatrix.empty() || count == 0) return 0;
+	
+	const size_t dim = m_signal.size();
+	auto accumulate = [this, dim] (size_t first, size_t last, double sign){
+		for (size_t index = first; index < last; index++){
+			const double* row = m_SMatrix.row(m_ranks[index]);
+			for (size_t ii = 0; ii < dim; ii++)
+				m_rank_sums[ii] += sign * row[ii];
 		}
-	val = val / count;
-	m_signal[ii] = val;
+	};
+	
+	const size_t moved = count > m_summed ? count - m_summed : m_summed - count;
+	if (m_rank_sums.size() != dim || (m_summed > count && count < moved) ||
+		m_moved_rows + moved > anonymous::refresh_rows * dim){
+		m_rank_sums.assign(dim, 0.0);
+		m_summed = 0;
+		m_moved_rows = 0;
 	}
+	else
+		m_moved_rows += moved;
+	if (count > m_summed) accumulate(m_summed, count, 1.0);
+	else if (count < m_summed) accumulate(count, m_summed, -1.0);
+	m_summed = count;
+	
+	for (size_t ii = 0; ii < dim; ii++)
+		m_signal[ii] = m_rank_sums[ii] / count;
 	
 	return count;
 }
@@ -131,12 +162,8 @@ bool medianLevelSet::verify_input () const
 		if (!ok) return ok;
 		ok &= m_SMatrix.size() == m_entsize;
 		if (!ok) return ok;
-		for (int row = 0; row < m_entsize; row++)
-		{
-			//      std::cout << "[" << row << "]" << m_SMatrix[row].size () << std::endl;
-		ok &= m_SMatrix[row].size () == m_entsize;
+		ok &= m_SMatrix.storage() == svl::symmetric_matrix<double>::dense;
 		if (!ok) return ok;
-		}
 	}
 	return ok;
 }
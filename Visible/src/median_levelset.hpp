@@ -21,6 +21,7 @@
 #include "core/pair.hpp"
 #include "core/stats.hpp"
 #include "core/stl_utils.hpp"
+#include "core/symmetric_matrix.hpp"
 #include "core/signaler.h"
 #include "input_selector.hpp"
 #include "timed_types.h"
@@ -64,7 +65,7 @@ public:
 		// signal pci is median level processed
 	typedef void (sig_cb_mls_pci_ready) (std::vector<float>&, const result_index_channel_t&,  uint32_t& body_id );
 
-	medianLevelSet() {}
+	medianLevelSet() : m_summed(0), m_moved_rows(0) {}
 	
 	void initialize (const result_index_channel_t&,    const uint32_t& body_id = std::numeric_limits<uint32_t>::max() , const medianLevelSet::params& params = medianLevelSet::params ());
 
@@ -73,7 +74,7 @@ public:
 		// Load raw entropies and the self-similarity matrix
 		// If no self-similarity matrix is given, entropies are assumed to be filtered and used directly
 		// // input selector -1 entire index mobj index
-	void load (const vector<double>& entropies, const vector<vector<double>>& mmatrix = vector<vector<double>>());
+	void load (const vector<double>& entropies, const svl::symmetric_matrix<double>& mmatrix = svl::symmetric_matrix<double>());
 	
 	void update () const;
 	
@@ -122,7 +123,7 @@ private:
 	mutable double m_median_value;
 	mutable std::pair<double,double> m_leveled_min_max;
 	mutable float m_median_levelset_frac;
-	mutable vector<vector<double>>        m_SMatrix;   // Used in eExhaustive and
+	svl::symmetric_matrix<double>        m_SMatrix;   // Shared with the producer, used in eExhaustive and
 	vector<double>               m_entropies;
 	mutable vector<double>               m_signal;
 	mutable vector<float>               m_signal_F;
@@ -130,6 +131,9 @@ private:
 	mutable std::atomic<bool> m_cached;
 	mutable result_index_channel_t m_in;
 	mutable std::vector<int>            m_ranks;
+	mutable std::vector<double>         m_rank_sums;  // Sum of the rows of ranks [0, m_summed)
+	mutable size_t                      m_summed;
+	mutable size_t                      m_moved_rows; // Rows added or removed since m_rank_sums was rebuilt
 	size_t m_entsize;
 	mutable bool mValidInput;
 	mutable bool mValidOutput;
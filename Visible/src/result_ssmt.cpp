@@ -30,6 +30,7 @@
 #include "result_serialization.h"
 #include "core/boost_stats.hpp"
 #include "algo_runners.hpp"
+#include "core/thread_pool.hpp"
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 
@@ -110,86 +111,135 @@ bool ssmt_result::run_selfsimilarity (){
 }
 
 bool ssmt_result::process (){
+	if (! generateRegionImages() || ! run_selfsimilarity()) return false;
+	const bool located = locate_contractions();
+	const bool ss_done = run_scale_space_stage();
+	return located && ss_done && profile_contractions();
+}
 
-	while(!m_images_loaded || ! m_pci_done)
-		{std::this_thread::yield(); }
-	
-	if (m_images_loaded == false || m_pci_done == false) return false;
+svl::task_graph::node_t ssmt_result::schedule (svl::task_graph& graph){
+	auto images = graph.add([this] () { return generateRegionImages(); });
+	auto pci = graph.add([this] () { return run_selfsimilarity(); }, {images});
+	auto ss = graph.add([this] () { return run_scale_space_stage(); }, {images});
+	auto located = graph.add([this] () { return locate_contractions(); });
+	return graph.add([this] () { return profile_contractions(false); }, {pci, ss, located});
+}
+
+void ssmt_result::notify_contractions (){
+	m_caRef->notify_contractions();
+}
+
+bool ssmt_result::locate_contractions (){
 //	m_leveled = m_leveler.leveledF();
 	auto parent = m_weak_parent.lock();
 	if (parent.get() == 0) return false;
 	
 	m_caRef->load(parent->entropies_F(), parent->ssMatrix());
+	// Finding no contractions is not a failure, profiling still runs
     m_caRef->locate_contractions();
+	return true;
+}
 
+bool ssmt_result::run_scale_space_stage (){
+	if (m_images_loaded == false) return false;
 	auto ss_done = run_scale_space(m_all_by_channel[m_input.section()]);
 	if(ss_done){
 		// @todo: this should get a contraction to use
 		m_scale_space.process_motion_peaks(0, motion_surface().boundingRect());
 	}
-	if(m_pci_done && ss_done){
-		m_caRef->profile_contractions(m_scale_space.lengths());
-		return true;
-	}
-	return false;
+	return ss_done;
+}
+
+bool ssmt_result::profile_contractions (bool notify){
+	if (m_pci_done == false || ! m_scale_space.spaceDone()) return false;
+	m_caRef->profile_contractions(m_scale_space.lengths(), notify);
+	return true;
 }
 
 // Crops the moving body accross the sequence
 bool ssmt_result::get_channels (int channel) const {
-    
-    auto parent = m_weak_parent.lock();
+    return crop_regions({this}, channel);
+}
+
+bool ssmt_result::generateRegionImages (const std::vector<ref_t>& results){
+    std::vector<const ssmt_result*> pending;
+    for (const ref_t& sr : results)
+        if (sr && sr->m_images_loaded == false) pending.push_back(sr.get());
+    if (pending.empty()) return true;
+    const int channel = pending[0]->m_input.section();
+    for (const ssmt_result* sr : pending)
+        if (sr->m_input.section() != channel) return false;
+    return crop_regions(pending, channel);
+}
+
+/*
+ * getRectSubPix of the frame rotated about the box center: out (x, y) = rotated (x + cx - (w - 1) / 2, y + cy - (h - 1) / 2).
+ * The rotation and the crop offset are one affine transform.
+ */
+cv::Mat ssmt_result::crop_transform (const cv::RotatedRect& box){
+    const cv::Size size (box.size);
+    cv::Mat transform = getRotationMatrix2D(box.center, box.angle, 1.0);
+    transform.at<double>(0, 2) -= box.center.x - (size.width - 1) * 0.5;
+    transform.at<double>(1, 2) -= box.center.y - (size.height - 1) * 0.5;
+    return transform;
+}
+
+void ssmt_result::crop_frame (const roiWindow<P8U>& frame, const cv::Mat& transform, roiWindow<P8U>& crop){
+    cvMatRefroiP8U(frame, src, CV_8UC1);
+    cvMatRefroiP8U(crop, dst, CV_8UC1);
+    warpAffine(src, dst, transform, dst.size(), INTER_CUBIC, BORDER_CONSTANT, Scalar(0));
+}
+
+/*
+ * Every frame is read once and each region's rotated rectangle is warped straight into an output
+ * sized window, see crop_transform. A region's crops are stacked in one root, frame after frame,
+ * its images are views of it.
+ */
+bool ssmt_result::crop_regions (const std::vector<const ssmt_result*>& results, int channel){
+    if (results.empty()) return false;
+    auto parent = results[0]->m_weak_parent.lock();
     if (parent.get() == 0) return false;
-    m_channel_count = parent->channel_count();
     assert(parent->channel_count() > 0);
-    m_all_by_channel.resize (m_channel_count);
-    
-    assert(channel>=0 && channel < m_channel_count);
+    assert(channel>=0 && channel < parent->channel_count());
     const vector<roiWindow<P8U> >& rws = parent->content()[channel];
+    const int32_t total = static_cast<int32_t>(rws.size());
+    if (total == 0) return false;
     
-    
-    auto affineCrop = [] (const vector<roiWindow<P8U> >::const_iterator& rw_src, const cv::RotatedRect& rect){
-        
-        
-        auto matAffineCrop = [] (Mat input, const RotatedRect& box){
-            double angle = box.angle;
-            auto size = box.size;
-            
-            auto transform = getRotationMatrix2D(box.center, angle, 1.0);
-            Mat rotated;
-            warpAffine(input, rotated, transform, input.size(), INTER_CUBIC);
-            
-            //Crop the result
-            Mat cropped;
-            getRectSubPix(rotated, size, box.center, cropped);
-            copyMakeBorder(cropped,cropped,0,0,0,0,BORDER_CONSTANT,Scalar(0));
-            roiWindow<P8U> r8(cropped.cols, cropped.rows);
-            cpCvMatToRoiWindow8U (cropped, r8);
-            return r8;
-        };
-        
-        cvMatRefroiP8U(*rw_src, src, CV_8UC1);
-        return matAffineCrop(src, rect);
-        
+    struct region_crop {
+        cv::Mat transform;
+        cv::Size size;
+        roiWindow<P8U> stack;
     };
+    std::vector<region_crop> crops (results.size());
+    for (size_t rr = 0; rr < results.size(); rr++){
+        const cv::RotatedRect box = results[rr]->rotated_roi();
+        region_crop& crop = crops[rr];
+        crop.size = cv::Size(box.size);
+        if (crop.size.width <= 0 || crop.size.height <= 0) return false;
+        crop.transform = crop_transform(box);
+        crop.stack = roiWindow<P8U> (crop.size.width, crop.size.height * total, align_first_row);
+    }
     
+    svl::thread_pool::global().parallel_for(size_t(total), [&] (size_t ff) {
+        for (region_crop& crop : crops){
+            roiWindow<P8U> frame (crop.stack.frameBuf(), 0, int32_t(ff) * crop.size.height, crop.size.width, crop.size.height);
+            crop_frame(rws[ff], crop.transform, frame);
+        }
+    });
     
-    vector<roiWindow<P8U> >::const_iterator vitr = rws.begin();
-    uint32_t count = 0;
-    uint32_t total = static_cast<uint32_t>(rws.size());
-    do
-    {
-        auto rr = rotated_roi();
-     //   rr.size.width += 40;
-    //    rr.size.height += 20;
-        auto affine = affineCrop(vitr, rr);
-        m_all_by_channel[channel].emplace_back(affine);
-        count++;
+    for (size_t rr = 0; rr < results.size(); rr++){
+        const ssmt_result* sr = results[rr];
+        const region_crop& crop = crops[rr];
+        sr->m_channel_count = parent->channel_count();
+        sr->m_all_by_channel.resize (sr->m_channel_count);
+        auto& images = sr->m_all_by_channel[channel];
+        images.clear();
+        images.reserve(total);
+        for (int32_t ff = 0; ff < total; ff++)
+            images.emplace_back(crop.stack.frameBuf(), 0, ff * crop.size.height, crop.size.width, crop.size.height);
+        sr->m_images_loaded.store(true, std::memory_order_release);
     }
-    while (++vitr != rws.end());
-    bool check = m_all_by_channel[channel].size() == total;
-	
-    check = check && count == total;
-	return check;
+	return true;
 }
 
 bool ssmt_result::run_scale_space (const std::vector<roiWindow<P8U>>& images){
@@ -203,21 +253,15 @@ bool ssmt_result::run_selfsimilarity_on_region (const std::vector<roiWindow<P8U>
 {
   
     auto sp =  std::shared_ptr<sm_producer> ( new sm_producer () );
-	m_smat.resize(0);
+	m_smat = sm_producer::sMatrix_t ();
 	m_entropies.resize(0);
 	
     vlogger::instance().console()->info(tostr(images.size()));
     sp->load_images (images);
-    std::packaged_task<bool()> task([sp](){ return sp->operator()(0);}); // wrap the function
-    std::future<bool>  future_ss = task.get_future();  // get a future
-    std::thread(std::move(task)).join(); // Finish on a thread
-    
-    if (future_ss.get())
+    if (sp->operator()(0))
     {
         const deque<double> entropies = sp->shannonProjection ();
-        const std::deque<deque<double>> sm = sp->similarityMatrix();
-        assert(images.size() == entropies.size() && sm.size() == images.size());
-        for (auto row : sm) assert(row.size() == images.size());
+        assert(images.size() == entropies.size() && sp->similarityMatrix().size() == images.size());
 	
 		// todo: remove all this nonsense copying.
 		m_entropies.resize(entropies.size());
@@ -226,11 +270,7 @@ bool ssmt_result::run_selfsimilarity_on_region (const std::vector<roiWindow<P8U>
 		std::transform(entropies.begin(), entropies.end(), entropies_D.begin(), [] (const double d){ return d; });
 	
 	
-        for (auto row : sm){
-            vector<double> rowv;
-            rowv.insert(rowv.end(), row.begin(), row.end());
-            m_smat.push_back(rowv);
-        }
+        m_smat = sp->similarityMatrix();
 	
 		bool check = m_smat.size() == m_entropies.size();
 		if (! check ) return check;
@@ -18,6 +18,7 @@
 #include <functional>
 
 #include "core/simple_timing.hpp"
+#include "core/thread_pool.hpp"
 #include "vision/opencv_utils.hpp"
 #include "vision/histo.h"
 
@@ -56,14 +57,7 @@ namespace anonymous
     
     bool smatrix_ok(const sm_producer::sMatrix_t& sm, size_t d1)
     {
-        bool ok = sm.size() == d1;
-        if (!ok) return ok;
-        for (int row = 0; row < d1; row++)
-        {
-            ok &= sm[row].size () == d1;
-            if (!ok) return ok;
-        }
-        return ok;
+        return sm.size() == d1 && sm.storage() == sm_producer::sMatrix_t::dense;
     }
 }
 
@@ -98,16 +92,17 @@ std::future<bool> sm_producer::launch_async (int frames, const progress_fn_t& re
     assert(has_content());
     
     auto fcnt = (frames == 0) ? _impl-> m_frameCount : frames;
-    return std::async(std::launch::async, &sm_producer::spImpl::generate_ssm, _impl, fcnt, reporter);
+    auto impl = _impl;
+    return svl::thread_pool::global().submit([impl, fcnt, reporter] () { return impl->generate_ssm(fcnt, reporter); },
+                                             svl::thread_pool::priority::normal);
 }
 
 bool sm_producer::operator() (int frames,  const progress_fn_t& reporter ) const
 {
     if(has_content()){
-        std::cout << " in () " << std::endl;
-        std::future<bool> bright = launch_async(frames, reporter);
-        bright.wait();
-        return bright.get();
+        // On the calling thread, its parallel loops run on the pool
+        auto fcnt = (frames == 0) ? _impl-> m_frameCount : frames;
+        return _impl->generate_ssm(fcnt, reporter);
     }
     return false;
 }
@@ -117,6 +112,11 @@ void sm_producer::load_images(const images_vector_t &images)
     if (_impl) _impl->loadImages (images);
 }
 
+void sm_producer::load_images(const images16_vector_t &images)
+{
+    if (_impl) _impl->loadImages (images);
+}
+
 template<typename T> boost::signals2::connection
 sm_producer::registerCallback (const std::function<T> & callback)
 {
@@ -136,6 +136,10 @@ int sm_producer::frames_in_content() const { return (_impl) ? (int) _impl->frame
 
 const sm_producer::sMatrix_t& sm_producer::similarityMatrix () const { return _impl->m_SMatrix; }
 
+void sm_producer::batch (bool on) { _impl->m_batch = on; }
+
+bool sm_producer::batch () const { return _impl->m_batch; }
+
 const sm_producer::sMatrixProjection_t& sm_producer::meanProjection (outputOrderOption ooo) const { assert(false); }
 
 const sm_producer::sMatrixProjection_t& sm_producer::shannonProjection (outputOrderOption ooo) const { return _impl->m_entropies; }
@@ -232,6 +236,7 @@ int sm_producer::spImpl::loadImageDirectory( const std::string& imageDir,  sm_pr
     
     m_framePaths.clear();
     m_loaded_ref.resize(0);
+    m_loaded16_ref.resize(0);
     
     std::cout << m_framePaths.size () << " Files "  << std::endl;
     
@@ -375,6 +380,7 @@ void sm_producer::spImpl::loadImages (const images_vector_t& images)
     
     m_source_type = imageInMemory;
     m_loaded_ref.resize(0);
+    m_loaded16_ref.resize(0);
     vector<roiWindow<P8U> >::const_iterator vitr = images.begin();
     do
     {
@@ -394,6 +400,20 @@ void sm_producer::spImpl::loadImages (const images_vector_t& images)
     
 }
 
+void sm_producer::spImpl::loadImages (const images16_vector_t& images)
+{
+    std::unique_lock <std::mutex> lock(m_mutex);
+    
+    m_source_type = imageInMemory;
+    m_loaded_ref.resize(0);
+    m_loaded16_ref = images;
+    m_frameCount = m_loaded16_ref.size ();
+    
+    // Call the content loaded cb if any
+    if (signal_content_loaded && signal_content_loaded->num_slots() > 0)
+        signal_content_loaded->operator()();
+}
+
 #if OIIO_INTEGRATED
 bool sm_producer::spImpl::done_grabbing () const
 {
@@ -438,22 +458,31 @@ bool sm_producer::spImpl::generate_ssm ( int frames, const sm_producer::progress
     
     // Get a new similarity engine
     // Note: get execution times with   svl::stats<float>::PrintTo(simi->timeStats(), & std::cout);
-    self_similarity_producerRef simi = std::make_shared<self_similarity_producer<P8U> > (frames, 0, reporter);
-    
     // Invalidate last results map
     m_output_repo.clear();
-
-    // This is a blocking call
-    simi->fill(m_loaded_ref);
-    
     m_entropies.resize (0);
-    m_SMatrix.resize (0);
-
-    bool ok = simi->entropies (m_entropies);
+    m_SMatrix = sMatrix_t ();
+
+    bool ok = false;
+    if (! m_loaded16_ref.empty()){
+        self_similarity_producer16Ref simi = std::make_shared<self_similarity_producer<P16U> > (frames, 0, reporter);
+        simi->batch(m_batch);
+        // This is a blocking call
+        simi->fill(m_loaded16_ref);
+        ok = simi->entropies (m_entropies);
+        simi->selfSimilarityMatrix(m_SMatrix);
+    }
+    else{
+        self_similarity_producerRef simi = std::make_shared<self_similarity_producer<P8U> > (frames, 0, reporter);
+        simi->batch(m_batch);
+        // This is a blocking call
+        simi->fill(m_loaded_ref);
+        ok = simi->entropies (m_entropies);
+        simi->selfSimilarityMatrix(m_SMatrix);
+    }
     
     //for(auto en : m_entropies) std::cout << fixed << showpoint << std::setprecision(16) << en << std::endl;
-    // Fetch the SS matrix and verify
-    simi->selfSimilarityMatrix(m_SMatrix);
+    // Verify the SS matrix
     ok = ok && anonymous::smatrix_ok(m_SMatrix, m_entropies.size());
     
     
@@ -155,6 +155,8 @@ visibleContext::visibleContext(ci::app::WindowRef& ww,
     vlogger::instance().console()->info(msg);
     m_title = mContentFileName;
     m_playback_speed = 1;
+    m_displayed_frame = -1;
+    m_play_direction = 1;
     m_input_selector = result_index_channel_t(-1,0);
     m_selector_last = -1;
     m_selected_cell = -1;
@@ -190,6 +192,9 @@ void visibleContext::setup_signals(){
     ssmt_processor::params params (m_oiio_spec.format);
 	params.magnification(magnification());
 	
+    // The playback ring decodes with the processor's intensity map. Stages of a previous serie that have not started are dropped
+    m_playback.reset();
+    if (m_ssmtRef) m_ssmtRef->cancel_pending();
     m_ssmtRef = std::make_shared<ssmt_processor> ( m_mspec, mCurrentCachePath, params);
 
     
@@ -388,11 +393,9 @@ void visibleContext::signal_regions_ready(int count, const result_index_channel_
     for (auto mb : m_ssmtRef->moving_bodies()){
         auto roi = mb->roi();
         vlogger::instance().console()->info(" @ " + svl::toString(roi.tl())+"::"+ svl::toString(roi.size()));
-		if (mb->generateRegionImages()){
-			mb->run_selfsimilarity();
-		}
-        mb->process();
     }
+    if (! m_ssmtRef->process_moving_bodies())
+        vlogger::instance().console()->info(" Not all moving regions were processed ");
 }
 
 void visibleContext::glscreen_normalize (const sides_length_t& src, const Rectf& gdr, sides_length_t& dst){
@@ -761,6 +764,8 @@ void visibleContext::loadCurrentMedia ()
         m_clips.clear();
         m_instant_channel_display_rects.clear();
         pause();
+        m_playback.reset();
+        m_displayed_frame = -1;
    
     //    mMediaInfo = mFrameSet->media_info();
         mChannelCount = (uint32_t) m_oiio_spec.nchannels;
@@ -778,8 +783,11 @@ void visibleContext::loadCurrentMedia ()
          */
         
         m_content_loaded.store(false, std::memory_order_release);
-        auto load_thread = std::thread(&ssmt_processor::load_channels_from_ImageBuf,m_ssmtRef.get(),mImageCache, mContentNameU, m_mspec);
-        load_thread.detach();
+        auto ssmt = m_ssmtRef;
+        auto cache = mImageCache;
+        auto name = mContentNameU;
+        auto mspec = m_mspec;
+        ssmt->post_stage([ssmt, cache, name, mspec] () { ssmt->load_channels_from_ImageBuf(cache, name, mspec); });
 
         
         /*
@@ -818,8 +826,9 @@ void visibleContext::process_async (){
     }
     
     if (isCardiacPipeline() || isSpatioTemporalPipeline()){
-        auto load_thread = std::thread(&ssmt_processor::find_moving_regions, m_ssmtRef.get(),channel_count()-1);
-        load_thread.detach();
+        auto ssmt = m_ssmtRef;
+        const int channel = channel_count() - 1;
+        ssmt->post_stage([ssmt, channel] () { ssmt->find_moving_regions(channel); });
 		std::string msg = " Processing " + mContentFileName + " Started ";
 		vlogger::instance().console()->info(msg);
     }
@@ -1342,6 +1351,33 @@ bool visibleContext::haveTracks()
 }
 
 
+/*
+ * Called from the playback ring's thread. 16 bit frames go through the volume wide map of the loaded content,
+ * so intensities compare across frames.
+ */
+bool visibleContext::decode_frame (int64_t index, SurfaceRef& frame)
+{
+    mImageCache->reset(mContentNameU, int(index), 0);
+    ROI roi = mImageCache->roi();
+    cv::Mat cvb8 (m_oiio_spec.height, m_oiio_spec.width, CV_8U);
+    if(mImageCache->pixeltype() == TypeUInt16){
+        cv::Mat cvb (m_oiio_spec.height, m_oiio_spec.width, CV_16U);
+        if (! mImageCache->get_pixels(roi, TypeUInt16, cvb.data)) return false;
+        if (m_ssmtRef && m_ssmtRef->intensity_map().valid()){
+            const svl::intensity_map16& imap = m_ssmtRef->intensity_map();
+            for (int row = 0; row < cvb.rows; row++)
+                imap.map_row(cvb.ptr<uint16_t>(row), cvb8.ptr<uint8_t>(row), size_t(cvb.cols));
+        }
+        else
+            cv::normalize(cvb, cvb8, 0, 255, NORM_MINMAX, CV_8UC1);
+    }
+    else if (! mImageCache->get_pixels(roi, TypeUInt8, cvb8.data))
+        return false;
+    
+    frame = Surface8u::create( fromOcv( cvb8 ) );
+    return bool(frame);
+}
+
 void visibleContext::update ()
 {
 //    std::string msg = svl::toString(m_seek_position);
@@ -1382,34 +1418,43 @@ void visibleContext::update ()
     // Fetch Next Frame
     // Make sure we have load content for processing.
     if (mImageCache && m_content_loaded){
-        mImageCache->reset(mContentNameU, getCurrentFrame(), 0);
-        mSurface = Surface::create(m_oiio_spec.width, m_oiio_spec.height, false);
-        ROI roi = mImageCache->roi();
-        cv::Mat cvb8 (m_oiio_spec.height, m_oiio_spec.width, CV_8U);
-        if(mImageCache->pixeltype() == TypeUInt16){
-                cv::Mat cvb (m_oiio_spec.height, m_oiio_spec.width, CV_16U);
-                mImageCache->get_pixels(roi, TypeUInt16, cvb.data);
-                cv::normalize(cvb, cvb8, 0, 255, NORM_MINMAX, CV_8UC1);
+        if (! m_playback){
+            auto decode = [this] (int64_t index, SurfaceRef& frame) { return decode_frame(index, frame); };
+            m_playback.reset(new playback_ring<SurfaceRef> (decode, mImageCache->nsubimages()));
         }
-        else
-            mImageCache->get_pixels(roi, TypeUInt8, cvb8.data);
-
-        mSurface = Surface8u::create( fromOcv( cvb8 ) );
-        mCurrentIndexTime = m_tic.current_frame_index();
-        if (mCurrentIndexTime.first != m_seek_position){
-            vlogger::instance().console()->info(tostr(mCurrentIndexTime.first - m_seek_position));
+        const int64_t current = getCurrentFrame();
+        if (current != m_displayed_frame && m_displayed_frame >= 0)
+            m_play_direction = current < m_displayed_frame ? -1 : 1;
+        m_playback->seek(current, m_play_direction * m_playback_speed);
+        
+        // Upload only, decode happened on the ring's thread. Until it is ready the last frame stays up.
+        SurfaceRef frame;
+        const auto fetched = current != m_displayed_frame ? m_playback->fetch(current, frame) : playback_ring<SurfaceRef>::pending;
+        if (fetched == playback_ring<SurfaceRef>::failed){
+            // It stays up in place of a frame that could not be decoded too, and playback moves on
+            vlogger::instance().console()->error("Failed to decode frame " + tostr(current));
+            m_displayed_frame = current;
         }
-        // Update Fbo with texture.
-        {
-            std::lock_guard<mutex> scopedLock(m_update_mutex);
-            if(mSurface){
-                mFbo->getColorTexture()->update(*mSurface);
-                renderToFbo(mSurface, mFbo);
+        else if (fetched == playback_ring<SurfaceRef>::fetched){
+            mSurface = frame;
+            m_displayed_frame = current;
+            mCurrentIndexTime = m_tic.current_frame_index();
+            if (mCurrentIndexTime.first != m_seek_position){
+                vlogger::instance().console()->info(tostr(mCurrentIndexTime.first - m_seek_position));
+            }
+            // Update Fbo with texture.
+            {
+                std::lock_guard<mutex> scopedLock(m_update_mutex);
+                if(mSurface){
+                    mFbo->getColorTexture()->update(*mSurface);
+                    renderToFbo(mSurface, mFbo);
+                }
             }
         }
     }
     
-    if (m_is_playing )
+    // Advance once the current frame is shown, playback waits for decode rather than skipping frames
+    if (m_is_playing && (! m_playback || m_displayed_frame == getCurrentFrame()))
     {
         update_instant_image_mouse ();
         seekToFrame (getCurrentFrame() + m_playback_speed);
@@ -15,6 +15,8 @@
 #include "algo_runners.hpp"
 #include "nms.hpp"
 #include "core/stl_utils.hpp"
+#include "core/thread_pool.hpp"
+#include "core/fft_engine.hpp"
 #include "core/fit.hpp"
 #include "time_series/persistence1d.hpp"
 
@@ -27,8 +29,9 @@ using namespace stl_utils;
 bool lengthFromMotion::generate(const std::vector<roiWindow<P8U>> &images, float start_sigma, float end_sigma, float step, float magX){
     std::vector<cv::Mat> mats;
     for (auto& rw : images){
+        // Views, generate keeps its own copies
         cvMatRefroiP8U(rw,cvmat,CV_8U);
-        mats.push_back(cvmat.clone());
+        mats.push_back(cvmat);
     }
     return generate(mats, start_sigma, end_sigma, step, magX);
 }
@@ -205,7 +208,7 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
                           float start_sigma, float end_sigma, float step, float magX){
     
     // check start, end and step are positive and end-start is multiple of step
-    m_filtered.resize(0);
+    m_sigmas.resize(0);
     m_scale_space.resize(0);
 	m_inputs.resize(0);
 	m_microns_per_pixel = 10.0f / magX ; // 10x is 1 micron.
@@ -214,6 +217,7 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
     if (step <= 0 || step_range <= 0) return false;
     int steps = (end_sigma - start_sigma)/step;
     if (steps < 4) return false;
+    if (images.empty()) return false;
 
     // make a cv::mat clone of input images
     cv::Size isize(images[0].cols, images[0].rows);
@@ -225,11 +229,7 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
 	
     for (const auto& rw : images){
         if(rw.cols != isize.width || rw.rows != isize.height) return false;
-        auto clone = rw.clone();
-        clone.convertTo(clone, CV_64F);
-        m_filtered.push_back(clone);
-		clone = rw.clone();
-		m_inputs.push_back(clone);
+		m_inputs.push_back(rw.clone());
 		cv::min(m_inputs.back(), imin, imin);
 		cv::max(m_inputs.back(), imax, imax);
     }
@@ -237,23 +237,55 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
 	cv::GaussianBlur(min_max_d, m_voxel_range, cv::Size(0,0), 4.0);
 	cv::threshold(m_voxel_range, m_voxel_range, 0, 255, THRESH_BINARY | THRESH_OTSU);
 	
-    m_loaded = m_filtered.size() == images.size();
+    m_loaded = m_inputs.size() == images.size();
+    for (auto scale = start_sigma; scale < end_sigma; scale+=step)
+        m_sigmas.push_back(scale);
+    const size_t scales = m_sigmas.size();
+    
+    // Frames are taken in one pass, in contiguous chunks across the pool. Every frame's scales are
+    // blurred in cascade, scale k from scale k - 1 by the difference sigma, sqrt(s_k^2 - s_k-1^2), in
+    // float. Sum and sum of squares per scale are kept in double, as n SS - S * S below cancels badly
+    // in float. They are shared by all chunks and split in row bands, each with its own lock. A chunk
+    // adds a blurred frame band by band starting at its own band, so chunks seldom wait on each other
+    // and memory does not grow with the pool size.
+    const size_t n_frames = m_inputs.size();
+    const size_t chunks = std::min(n_frames, size_t(svl::thread_pool::global().size()));
+    const int bands = static_cast<int>(std::min(std::max(chunks, size_t(1)), size_t(isize.height)));
+    std::vector<cv::Mat> sums, sumsqs;
+    for (size_t ss = 0; ss < scales; ss++){
+        sums.push_back(cv::Mat::zeros(isize, CV_64F));
+        sumsqs.push_back(cv::Mat::zeros(isize, CV_64F));
+    }
+    std::vector<std::mutex> band_mutexes (bands);
+    svl::thread_pool::global().parallel_for(chunks, [&] (size_t cc) {
+        const size_t f0 = cc * n_frames / chunks;
+        const size_t f1 = (cc + 1) * n_frames / chunks;
+        cv::Mat blurred;
+        for (size_t ff = f0; ff < f1; ff++){
+            m_inputs[ff].convertTo(blurred, CV_32F);
+            float previous = 0;
+            for (size_t ss = 0; ss < scales; ss++){
+                const float sigma = std::sqrt(std::max(0.0f, m_sigmas[ss] * m_sigmas[ss] - previous * previous));
+                if (sigma > 0) cv::GaussianBlur(blurred, blurred, cv::Size(0,0), sigma);
+                previous = m_sigmas[ss];
+                for (int bb = 0; bb < bands; bb++){
+                    const int band = static_cast<int>((bb + cc) % bands);
+                    const cv::Range rows (band * isize.height / bands, (band + 1) * isize.height / bands);
+                    cv::Mat sum = sums[ss].rowRange(rows);
+                    cv::Mat sumsq = sumsqs[ss].rowRange(rows);
+                    std::lock_guard<std::mutex> lock (band_mutexes[band]);
+                    cv::accumulate(blurred.rowRange(rows), sum);
+                    cv::accumulateSquare(blurred.rowRange(rows), sumsq);
+                }
+            }
+        }
+    });
+    
     int n = static_cast<int>(images.size());
     int n2 = n * (n - 1);
-    for (auto scale = start_sigma; scale < end_sigma; scale+=step){
-		cv::Mat sum = cv::Mat(isize.height, isize.width, CV_64F);
-        cv::Mat sumsq = cv::Mat(isize.height, isize.width, CV_64F);
-        sum = 0;
-        sumsq = 0;
-        for (auto ii = 0; ii < m_filtered.size(); ii++){
-            auto mm = m_filtered[ii].clone();
-            cv::GaussianBlur(mm, mm, cv::Size(0,0), scale );
-            // Sum
-            sum += mm;
-            // square at Sum Squared
-            mm = mm.mul(mm);
-            sumsq += mm;
-        }
+    for (size_t ss = 0; ss < scales; ss++){
+        cv::Mat& sum = sums[ss];
+        cv::Mat& sumsq = sumsqs[ss];
         // n SS - S * S
         cv::multiply(sum, sum, sum);
         sumsq *= n;
@@ -277,6 +309,13 @@ bool voxel_processor::generate_voxel_space (const std::vector<roiWindow<P8U>>& i
     return false;
 }
 
+bool voxel_processor::generate_spectral_space (const std::vector<roiWindow<P8U>>& images,
+                                               const std::vector<int>& indicies){
+    if (m_load(images, m_voxel_sample.first, m_voxel_sample.second, indicies))
+        return m_spectral_generate();
+    return false;
+}
+
 voxel_processor::voxel_processor(){
         // semilarity producer
     m_sm_producer = std::shared_ptr<sm_producer> ( new sm_producer () );
@@ -290,11 +329,8 @@ const smProducerRef  voxel_processor::similarity_producer () const {
 bool  voxel_processor::m_internal_generate() {
     auto sp = similarity_producer();
     sp->load_images(m_voxels);
-    std::packaged_task<bool()> task([sp]() { return sp->operator()(0); });       // wrap the function
-    std::future<bool> future_ss = task.get_future(); // get a future
-    std::thread(std::move(task)).join();             // Finish on a thread
     vlogger::instance().console()->info("dispatched voxel self-similarity");
-    if (future_ss.get()){
+    if (sp->operator()(0)){
         vlogger::instance().console()->info("copying results of voxel self-similarity");
         const deque<double>& entropies = sp->shannonProjection ();
         m_voxel_entropies.insert(m_voxel_entropies.end(), entropies.begin(), entropies.end());
@@ -306,6 +342,79 @@ bool  voxel_processor::m_internal_generate() {
     return false;
 }
 
+bool  voxel_processor::m_spectral_generate() {
+    const size_t length = m_voxel_length;
+    const int width = m_expected_segmented_size.first;
+    const int height = m_expected_segmented_size.second;
+    if (length < 4 || m_voxels.size() != size_t(width * height)) return false;
+    
+    m_frequency_map = cv::Mat(height, width, CV_32F, cv::Scalar(0));
+    m_amplitude_map = cv::Mat(height, width, CV_32F, cv::Scalar(0));
+    m_phase_map = cv::Mat(height, width, CV_32F, cv::Scalar(0));
+    
+    // Hann window against leakage into the neighbouring bins, its sum is the coherent gain
+    std::vector<float> window (length);
+    double window_sum = 0;
+    for (size_t tt = 0; tt < length; tt++){
+        window[tt] = float(0.5 - 0.5 * std::cos(2 * svl::constants::pi * tt / length));
+        window_sum += window[tt];
+    }
+    
+    // Voxels are transformed in groups, each with its own engine and buffers. Plans are shared.
+    static const size_t group = 256;
+    const size_t count = m_voxels.size();
+    const size_t groups = (count + group - 1) / group;
+    svl::thread_pool::global().parallel_for(groups, [&] (size_t gg) {
+        const size_t v0 = gg * group;
+        const size_t nv = std::min(group, count - v0);
+        svl::fft_real engine (length);
+        const size_t bins = engine.bins();
+        std::vector<float> signal (nv * length), re (nv * bins), im (nv * bins);
+        
+        // Less the mean, the DC term carries no beat, then windowed
+        for (size_t vv = 0; vv < nv; vv++){
+            const uint8_t* src = m_voxels[v0 + vv].rowPointer(0);
+            float* dst = &signal[vv * length];
+            float mean = 0;
+            for (size_t tt = 0; tt < length; tt++) mean += src[tt];
+            mean /= length;
+            for (size_t tt = 0; tt < length; tt++) dst[tt] = (src[tt] - mean) * window[tt];
+        }
+        engine.forward(signal.data(), nv, length, re.data(), im.data(), bins);
+        
+        for (size_t vv = 0; vv < nv; vv++){
+            const float* vr = &re[vv * bins];
+            const float* vi = &im[vv * bins];
+            size_t peak = 1;
+            float peak_power = 0;
+            for (size_t kk = 1; kk < bins; kk++){
+                const float power = vr[kk] * vr[kk] + vi[kk] * vi[kk];
+                if (power > peak_power) { peak_power = power; peak = kk; }
+            }
+            // Sub bin position from a parabola through the log power ( the window's peak is near Gaussian )
+            float offset = 0;
+            if (peak > 1 && peak + 1 < bins && peak_power > 0){
+                auto log_power = [vr, vi] (size_t kk) { return std::log(vr[kk] * vr[kk] + vi[kk] * vi[kk] + std::numeric_limits<float>::min()); };
+                offset = parabolicFit(log_power(peak - 1), std::log(peak_power), log_power(peak + 1), (float*) nullptr);
+                if (! std::isfinite(offset) || std::fabs(offset) > 0.5f) offset = 0;
+            }
+            const size_t vi_index = v0 + vv;
+            const int row = static_cast<int>(vi_index / width);
+            const int col = static_cast<int>(vi_index % width);
+            // A sinusoid of amplitude a shows as a * window_sum / 2 in its bin, a * window_sum at Nyquist
+            const float scale = float(((2 * peak == length) ? 1.0 : 2.0) / window_sum);
+            m_frequency_map.at<float>(row, col) = (peak + offset) / length;
+            m_amplitude_map.at<float>(row, col) = std::sqrt(peak_power) * scale;
+            m_phase_map.at<float>(row, col) = std::atan2(vi[peak], vr[peak]);
+        }
+    });
+    
+    double fmin, fmax;
+    cv::minMaxLoc(m_frequency_map, &fmin, &fmax);
+    vlogger::instance().console()->info("voxel spectral map, frequency range : " + to_string(fmin) + "," + to_string(fmax));
+    return true;
+}
+
 bool  voxel_processor::generate_voxel_surface (const std::vector<float>& ven){
     
     uiPair size_diff = m_half_offset + m_half_offset;
@@ -374,30 +483,52 @@ bool  voxel_processor::m_load(const std::vector<roiWindow<P8U>> &images,
     to_string(expected_height);
     vlogger::instance().console()->info("starting " + msg);
 
-    // Walk through the sampled space and fetch the voxels
-    int count = 0;
-    for (int row = 0; row < expected_height; row++){
-        for (int col = 0; col < expected_width; col++){
-            int org_col = m_half_offset.first + col * m_voxel_sample.first;
-            int org_row = m_half_offset.second + row * m_voxel_sample.second;
-            std::vector<uint8_t> voxel(m_voxel_length);
-            for (auto tt = 0; tt < m_voxel_length; tt++) {
-                int idx = indicies.empty() ? tt : indicies[tt];
-                if (! images[idx].contains(org_col, org_row)){
-                    std::cout << " Voxel " << org_col << "," << org_row << std::endl;
+    // Fetch the voxels with a blocked transpose into one voxel major buffer: voxel v is row v,
+    // its samples over time along the row. Rows of the sampled grid are processed in parallel.
+    // Within a row, tiles of block voxels by block frames are copied one at a time, so the tile's
+    // destination cache lines stay resident while all of its frames are written.
+    const int nvoxels = expected_width * expected_height;
+    if (nvoxels <= 0 || m_voxel_length == 0){
+        vlogger::instance().console()->error("finished with error: empty voxel space");
+        return false;
+    }
+    roiWindow<P8U> voxels (static_cast<int32_t>(m_voxel_length), nvoxels, align_first_row);
+    uint8_t* base = voxels.rowPointer(0);
+    const int32_t voxel_update = voxels.rowUpdate();
+    int last_col = m_half_offset.first + (expected_width - 1) * m_voxel_sample.first;
+    int last_row = m_half_offset.second + (expected_height - 1) * m_voxel_sample.second;
+    for (auto tt = 0; tt < m_voxel_length; tt++) {
+        int idx = indicies.empty() ? tt : indicies[tt];
+        if (! images[idx].contains(last_col, last_row)){
+            vlogger::instance().console()->error(" Voxel " + to_string(last_col) + "," + to_string(last_row) + " outside frame " + to_string(idx));
+            return false;
+        }
+    }
+
+    static const int block = 64;
+    svl::thread_pool::global().parallel_for(expected_height, [&] (size_t row) {
+        const int org_row = m_half_offset.second + static_cast<int>(row) * m_voxel_sample.second;
+        uint8_t* row_base = base + row * expected_width * voxel_update;
+        for (int c0 = 0; c0 < expected_width; c0 += block){
+            const int c1 = std::min(static_cast<int>(expected_width), c0 + block);
+            for (int t0 = 0; t0 < m_voxel_length; t0 += block){
+                const int t1 = std::min(static_cast<int>(m_voxel_length), t0 + block);
+                for (auto tt = t0; tt < t1; tt++) {
+                    int idx = indicies.empty() ? tt : indicies[tt];
+                    const uint8_t* src = images[idx].rowPointer(org_row) + m_half_offset.first + c0 * m_voxel_sample.first;
+                    uint8_t* dst = row_base + c0 * voxel_update + tt;
+                    for (int col = c0; col < c1; col++, src += m_voxel_sample.first, dst += voxel_update)
+                        *dst = *src;
                 }
-                voxel[tt] = images[idx].getPixel(org_col, org_row);
             }
-            count++;
-            m_voxels.emplace_back(voxel);
         }
-    }
-    
-    bool ok = count == (expected_width * expected_height);
+    });
 
-	if (! ok)
-    	vlogger::instance().console()->error("finished with error ");
-    return ok;
+    // Voxels are single row views of the shared buffer
+    m_voxels.reserve(nvoxels);
+    for (int vv = 0; vv < nvoxels; vv++)
+        m_voxels.emplace_back(voxels.frameBuf(), 0, vv, static_cast<int32_t>(m_voxel_length), 1);
+    return true;
 }
 
 #pragma GCC diagnostic pop
@@ -72,6 +72,25 @@ void ssmt_processor::generateVoxelsAndSelfSimilarities (const std::vector<roiWin
     vp.sample(m_voxel_sample.first, m_voxel_sample.second);
     vp.image_size(m_loaded_spec.getSectionSize().first, m_loaded_spec.getSectionSize().second);
     
+    if (m_params.voxel_spectral()){
+            // Spectral alternative, the amplitude of the voxel's dominant frequency stands for its self-similarity.
+            // Not cached, one fft per voxel is cheap next to the self-similarity
+        vlogger::instance().console()->info("starting generating voxel spectral map");
+        if (vp.generate_spectral_space(images)){
+            m_voxel_frequency = vp.frequency_map();
+            m_voxel_amplitude = vp.amplitude_map();
+            m_voxel_phase = vp.phase_map();
+            assert(m_voxel_amplitude.isContinuous());
+            m_voxel_entropies.assign(m_voxel_amplitude.begin<float>(), m_voxel_amplitude.end<float>());
+            
+                // Call the voxel ready cb if any
+            if (signal_ss_voxel_ready && signal_ss_voxel_ready->num_slots() > 0)
+                signal_ss_voxel_ready->operator()(m_voxel_entropies);
+        }
+        assert(m_voxel_entropies.empty() == false);
+        return;
+    }
+    
     if(bfs::exists(mCurrentCachePath)){
         auto cache_path = mCurrentCachePath / m_params.internal_container_cache_name ();
         if(bfs::exists(cache_path)){
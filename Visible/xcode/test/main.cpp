@@ -27,6 +27,7 @@
 #include <memory>
 #include <thread>
 #include <list>
+#include <random>
 
 
 #include <boost/foreach.hpp>
@@ -51,6 +52,7 @@
 #include "core/stl_utils.hpp"
 #include "core/core.hpp"
 #include "contraction.hpp"
+#include "core/task_graph.hpp"
 #include "sm_producer.h"
 #include "sg_filter.h"
 #include "vision/drawUtils.hpp"
@@ -89,6 +91,7 @@
 #include "core/fit.hpp"
 #include <OpenImageIO/imagebufalgo.h>
 #include "temporal_medianOf3.hpp"
+#include "playback_ring.hpp"
 #include "vision/ellipse.hpp"
 #include <cmath>
 #include "nr_support.hpp"
@@ -970,6 +973,50 @@ TEST(scale_space, basic){
     }
 }
 
+TEST(scale_space, cascade){
+    // A blob moving over noise. Scales blurred in cascade match blurring every frame by the scale's sigma
+    // directly, up to kernel truncation and sampling
+    const int width = 48;
+    const int height = 40;
+    const int count = 12;
+    std::mt19937 gen (7);
+    std::uniform_real_distribution<double> noise (0.0, 40.0);
+    std::vector<cv::Mat> frames;
+    for (int tt = 0; tt < count; tt++){
+        cv::Mat frame (height, width, CV_8U);
+        for (int yy = 0; yy < height; yy++)
+            for (int xx = 0; xx < width; xx++){
+                const double dx = xx - 10 - 2.5 * tt;
+                const double dy = yy - 20;
+                const double val = 100.0 + 60.0 * std::exp(-(dx * dx + dy * dy) / 32.0) + noise(gen);
+                frame.at<uint8_t>(yy, xx) = cv::saturate_cast<uint8_t>(val);
+            }
+        frames.push_back(frame);
+    }
+    
+    lengthFromMotion lfm;
+    EXPECT_TRUE(lfm.generate(frames, 2, 10, 2));
+    const std::vector<float> sigmas = {2, 4, 6, 8};
+    ASSERT_EQ(sigmas.size(), lfm.space().size());
+    for (size_t ss = 0; ss < sigmas.size(); ss++){
+        cv::Mat sum = cv::Mat::zeros(height, width, CV_64F);
+        cv::Mat sumsq = cv::Mat::zeros(height, width, CV_64F);
+        for (const auto& frame : frames){
+            cv::Mat blurred;
+            frame.convertTo(blurred, CV_32F);
+            cv::GaussianBlur(blurred, blurred, cv::Size(0,0), sigmas[ss]);
+            cv::accumulate(blurred, sum);
+            cv::accumulateSquare(blurred, sumsq);
+        }
+        cv::Mat direct = (sumsq * count - sum.mul(sum)) / (count * (count - 1));
+        double peak, error;
+        cv::minMaxLoc(direct, nullptr, &peak);
+        cv::minMaxLoc(cv::abs(direct - lfm.space()[ss]), nullptr, &error);
+        EXPECT_GT(peak, 1.0);
+        EXPECT_LT(error, 1.0e-3 * peak);
+    }
+}
+
 
 TEST(oiio, basic){
     
@@ -1403,6 +1450,99 @@ TEST(samples_1d, basic){
 
 
 
+TEST(cardiac_ut, contraction_signals)
+{
+    // Regions are profiled concurrently, as ssmt_processor::process_moving_bodies does, and their
+    // contractions signaled afterwards on the thread that ran the graph
+    const int regions = 6;
+    std::vector<contractionLocator::Ref> locators;
+    std::vector<boost::signals2::connection> connections;
+    // Written by the handlers without a lock, like visibleContext's contraction map
+    std::map<int, std::thread::id> signaled;
+    std::function<contractionLocator::sig_cb_contraction_ready> contraction_ready_cb =
+        [&signaled] (contractionLocator::contractionContainer_t&, const result_index_channel_t& in){
+        signaled[in.region()] = std::this_thread::get_id();
+    };
+    for (int rr = 0; rr < regions; rr++){
+        std::vector<float> entropies (128);
+        for (size_t tt = 0; tt < entropies.size(); tt++)
+            entropies[tt] = 0.5f + 0.4f * std::sin(2 * svl::constants::pi * tt * (rr + 3) / entropies.size());
+        locators.push_back(contractionLocator::create(result_index_channel_t(rr, 0), rr));
+        locators.back()->load(entropies);
+        connections.push_back(locators.back()->registerCallback(contraction_ready_cb));
+    }
+    
+    svl::task_graph graph;
+    std::vector<svl::task_graph::node_t> profiles;
+    for (const auto& locator : locators)
+        profiles.push_back(graph.add([locator] () { return locator->profile_contractions(std::vector<float>(), false); }));
+    EXPECT_TRUE(graph.run());
+    EXPECT_TRUE(signaled.empty());
+    
+    for (int rr = 0; rr < regions; rr++)
+        if (graph.succeeded(profiles[rr])) locators[rr]->notify_contractions();
+    EXPECT_EQ(size_t(regions), signaled.size());
+    for (const auto& region_thread : signaled)
+        EXPECT_EQ(std::this_thread::get_id(), region_thread.second);
+    for (auto& connection : connections) connection.disconnect();
+}
+
+TEST(cardiac_ut, crop_regions)
+{
+    // Region crops against the full frame rotation and getRectSubPix they replace
+    const int width = 120;
+    const int height = 90;
+    roiWindow<P8U> frame (width, height);
+    for (int yy = 0; yy < height; yy++)
+        for (int xx = 0; xx < width; xx++)
+            frame.setPixel(xx, yy, cv::saturate_cast<uint8_t>(128 + 50 * std::sin(xx / 7.0) + 40 * std::cos(yy / 5.0) + 0.3 * xx));
+    cvMatRefroiP8U(frame, src, CV_8UC1);
+    
+    // Inside the frame, with a whole and a fractional crop offset, and across the frame's corner
+    const std::vector<cv::RotatedRect> boxes = {
+        cv::RotatedRect(cv::Point2f(60.0f, 45.0f), cv::Size2f(41, 21), 30.0f),
+        cv::RotatedRect(cv::Point2f(60.5f, 44.25f), cv::Size2f(40, 20), -17.0f),
+        cv::RotatedRect(cv::Point2f(10.0f, 80.0f), cv::Size2f(50, 30), 25.0f)
+    };
+    const std::vector<int> tolerance = {1, 1, 2};
+    for (size_t bb = 0; bb < boxes.size(); bb++){
+        const cv::RotatedRect& box = boxes[bb];
+        const cv::Mat rotation = getRotationMatrix2D(box.center, box.angle, 1.0);
+        cv::Mat rotated, old_crop;
+        warpAffine(src, rotated, rotation, src.size(), INTER_CUBIC);
+        getRectSubPix(rotated, box.size, box.center, old_crop);
+        
+        roiWindow<P8U> crop (old_crop.cols, old_crop.rows);
+        ssmt_result::crop_frame(frame, ssmt_result::crop_transform(box), crop);
+        cv::Mat inverse;
+        cv::invertAffineTransform(rotation, inverse);
+        
+        int outside = 0, replicated = 0;
+        for (int yy = 0; yy < crop.height(); yy++)
+            for (int xx = 0; xx < crop.width(); xx++){
+                // Position in the rotated frame and in the frame
+                const double rx = xx + box.center.x - (crop.width() - 1) * 0.5;
+                const double ry = yy + box.center.y - (crop.height() - 1) * 0.5;
+                const double sx = inverse.at<double>(0, 0) * rx + inverse.at<double>(0, 1) * ry + inverse.at<double>(0, 2);
+                const double sy = inverse.at<double>(1, 0) * rx + inverse.at<double>(1, 1) * ry + inverse.at<double>(1, 2);
+                const int pel = crop.getPixel(xx, yy);
+                const int old_pel = old_crop.at<uint8_t>(yy, xx);
+                const bool in_rotated = rx >= 0 && rx <= width - 1 && ry >= 0 && ry <= height - 1;
+                // Clear of the cubic kernel's reach past the frame edge
+                if (in_rotated && sx >= 2 && sx <= width - 3 && sy >= 2 && sy <= height - 3)
+                    EXPECT_LE(std::abs(pel - old_pel), tolerance[bb]);
+                if (sx < -2 || sx > width + 1 || sy < -2 || sy > height + 1){
+                    // Past the frame the crop is 0, the old path replicated the rotated frame's edge
+                    EXPECT_EQ(0, pel);
+                    outside++;
+                    if (! in_rotated && old_pel != 0) replicated++;
+                }
+            }
+        EXPECT_EQ(bb == 2, outside > 0);
+        EXPECT_EQ(bb == 2, replicated > 0);
+    }
+}
+
 TEST(cardiac_ut, load_sm)
 {
     auto res = dgenv_ptr->asset_path("sm.csv");
@@ -1799,6 +1939,125 @@ TEST(serialization, eigen){
 TEST(ut_voxel_freq, basic){
     EXPECT_TRUE(fft1D::test());
 }
+
+TEST(ut_voxel_freq, spectral_space){
+    // Every voxel a cosine on its own bin, with its own amplitude and phase. On a bin the Hann windowed
+    // estimates are exact up to 8 bit quantization, whose error is coherent when the period is a few frames.
+    const int width = 8;
+    const int height = 4;
+    auto voxel_frames = [=] (int length, const std::function<void(int, double&, double&, double&)>& wave){
+        std::vector<roiWindow<P8U>> frames;
+        for (int tt = 0; tt < length; tt++){
+            roiWindow<P8U> frame (width, height);
+            for (int vv = 0; vv < width * height; vv++){
+                double freq, amp, phase;
+                wave(vv, freq, amp, phase);
+                const double val = 128.0 + amp * std::cos(2 * svl::constants::pi * freq * tt + phase);
+                frame.setPixel(vv % width, vv / width, uint8_t(std::lround(val)));
+            }
+            frames.push_back(frame);
+        }
+        return frames;
+    };
+    
+    for (int length : {64, 63}){
+        // Bins 1 .. length / 2 - 2, clear of Nyquist and of the negative frequency's window leakage
+        auto wave = [length] (int vv, double& freq, double& amp, double& phase){
+            freq = double(1 + vv % (length / 2 - 2)) / length;
+            amp = 20.0 + vv;
+            phase = -3.0 + 0.18 * vv;
+        };
+        voxel_processor vp;
+        vp.sample(1);
+        EXPECT_TRUE(vp.generate_spectral_space(voxel_frames(length, wave)));
+        ASSERT_EQ(height, vp.frequency_map().rows);
+        ASSERT_EQ(width, vp.frequency_map().cols);
+        for (int vv = 0; vv < width * height; vv++){
+            double freq, amp, phase;
+            wave(vv, freq, amp, phase);
+            const int row = vv / width;
+            const int col = vv % width;
+            EXPECT_NEAR(freq, vp.frequency_map().at<float>(row, col), 1.0e-3);
+            EXPECT_NEAR(amp, vp.amplitude_map().at<float>(row, col), 1.0);
+            EXPECT_NEAR(phase, vp.phase_map().at<float>(row, col), 0.05);
+        }
+    }
+    
+    {
+        // Nyquist, the whole amplitude in the last bin
+        auto nyquist = [] (int vv, double& freq, double& amp, double& phase){
+            freq = 0.5;
+            amp = 20.0 + vv;
+            phase = 0.0;
+        };
+        voxel_processor vp;
+        vp.sample(1);
+        EXPECT_TRUE(vp.generate_spectral_space(voxel_frames(64, nyquist)));
+        for (int vv = 0; vv < width * height; vv++){
+            double freq, amp, phase;
+            nyquist(vv, freq, amp, phase);
+            const int row = vv / width;
+            const int col = vv % width;
+            EXPECT_NEAR(freq, vp.frequency_map().at<float>(row, col), 1.0e-6);
+            EXPECT_NEAR(amp, vp.amplitude_map().at<float>(row, col), 1.0);
+            EXPECT_NEAR(phase, vp.phase_map().at<float>(row, col), 0.05);
+        }
+    }
+    
+    {
+        // Between bins the frequency is interpolated
+        auto off_bin = [] (int vv, double& freq, double& amp, double& phase){
+            freq = (4.0 + 0.37 * vv) / 200;
+            amp = 60.0;
+            phase = 0.5;
+        };
+        voxel_processor vp;
+        vp.sample(1);
+        EXPECT_TRUE(vp.generate_spectral_space(voxel_frames(200, off_bin)));
+        for (int vv = 0; vv < width * height; vv++){
+            double freq, amp, phase;
+            off_bin(vv, freq, amp, phase);
+            EXPECT_NEAR(freq, vp.frequency_map().at<float>(vv / width, vv % width), 5.0e-4);
+        }
+    }
+}
+
+TEST(ut_voxel_process, load){
+    // Sampled grid wider than a transpose tile, more frames than a tile, and out of order frames
+    const int width = 220;
+    const int height = 20;
+    std::vector<roiWindow<P8U>> frames;
+    for (int tt = 0; tt < 140; tt++){
+        roiWindow<P8U> frame (width, height);
+        for (int yy = 0; yy < height; yy++)
+            for (int xx = 0; xx < width; xx++)
+                frame.setPixel(xx, yy, uint8_t((xx * 7 + yy * 31 + tt * 13) % 251));
+        frames.push_back(frame);
+    }
+    std::vector<int> indicies;
+    for (int tt = 139; tt >= 0; tt -= 2) indicies.push_back(tt);
+    
+    for (const std::vector<int>& order : {std::vector<int>(), indicies}){
+        voxel_processor vp;
+        vp.sample(3);
+        EXPECT_TRUE(vp.generate_spectral_space(frames, order));
+        const int gw = (width - 1) / 3;
+        const int gh = (height - 1) / 3;
+        const size_t length = order.empty() ? frames.size() : order.size();
+        ASSERT_EQ(size_t(gw * gh), vp.voxels().size());
+        int mismatches = 0;
+        for (int vv = 0; vv < gw * gh; vv++){
+            const roiWindow<P8U>& voxel = vp.voxels()[vv];
+            ASSERT_EQ(int(length), voxel.width());
+            for (size_t tt = 0; tt < length; tt++){
+                const int idx = order.empty() ? int(tt) : order[tt];
+                if (voxel.getPixel(int(tt), 0) != frames[idx].getPixel(1 + (vv % gw) * 3, 1 + (vv / gw) * 3))
+                    mismatches++;
+            }
+        }
+        EXPECT_EQ(0, mismatches);
+    }
+}
 TEST(ut_permutation_entropy, n_2){
     std::vector<double> times_series = {4/12.0,7/12.0,9/12.0,10/12.0,6/12.0,11/12.0,3/12.0};
     {
@@ -1988,6 +2247,49 @@ TEST(ut_median, basic){
     
 }
 
+TEST(ut_median_levelset, incremental){
+    // Many fraction changes, each updating the running sum, agree with the mean computed from scratch
+    const size_t dim = 173;
+    std::mt19937 gen (11);
+    std::uniform_real_distribution<double> unit (0.0, 1.0);
+    std::vector<double> entropies (dim);
+    for (auto& ent : entropies) ent = unit(gen);
+    // Mixed magnitudes, so rows added and later removed leave rounding residue in the running sum
+    const double largest = 1.0e9;
+    svl::symmetric_matrix<double> sm (dim);
+    for (size_t ii = 0; ii < dim; ii++)
+        for (size_t jj = ii; jj < dim; jj++)
+            sm.set(ii, jj, (unit(gen) < 0.1 ? largest : 1.0) * unit(gen));
+    
+    std::vector<int> ranks;
+    medianLevelSet::Median_levelsets(entropies, ranks);
+    
+    medianLevelSet mls;
+    mls.initialize(result_index_channel_t(0), 0, medianLevelSet::params(0.01f, 0.95f));
+    mls.load(entropies, sm);
+    EXPECT_TRUE(mls.isValid());
+    
+    std::uniform_real_distribution<float> fraction (0.01f, 0.95f);
+    double max_error = 0.0;
+    for (int update = 0; update < 5000; update++){
+        // Mostly small steps, with an occasional jump
+        float frac = update % 50 == 0 ? fraction(gen) :
+            clampValue(float(mls.get_median_levelset_pct() + (unit(gen) - 0.5) * 0.1), 0.01f, 0.95f);
+        mls.set_median_levelset_pct(frac);
+        const size_t count = std::floor(dim * mls.get_median_levelset_pct());
+        ASSERT_GT(count, size_t(0));
+        const auto& signal = mls.leveled();
+        ASSERT_EQ(dim, signal.size());
+        for (size_t ii = 0; ii < dim; ii++){
+            double sum = 0.0;
+            for (size_t index = 0; index < count; index++)
+                sum += sm(ranks[index], ii);
+            max_error = std::max(max_error, std::abs(signal[ii] - sum / count));
+        }
+    }
+    EXPECT_LT(max_error / largest, 1.0e-12);
+}
+
 void done_callback (void)
 {
     std::cout << "Done"  << std::endl;
@@ -2121,6 +2423,189 @@ TEST (ut_3d_per_element, standard_dev)
     EXPECT_TRUE(test_allpels(m_var_image, 0.666667f, true));
 }
 
+TEST (ut_3d_per_element, fused_volume)
+{
+    // Frames of a ramp plus the frame index, against histoStats per frame and a direct per pixel sum
+    vector<roiWindow<P8U>> frames;
+    for (int ff = 0; ff < 7; ff++){
+        roiWindow<P8U> frame (13, 9);
+        for (int row = 0; row < frame.height(); row++)
+            for (int col = 0; col < frame.width(); col++)
+                frame.setPixel(col, row, uint8_t(col * 3 + row + ff * 20));
+        frames.push_back(frame);
+    }
+    cv::Mat sum, sqsum;
+    std::vector<VolumeAccumulator::moments_t> moments;
+    std::vector<VolumeAccumulator::range_t> ranges;
+    VolumeAccumulator()(frames, sum, sqsum, moments, ranges);
+    ASSERT_EQ(moments.size(), frames.size());
+    for (size_t ff = 0; ff < frames.size(); ff++){
+        histoStats hh;
+        hh.from_image(frames[ff]);
+        EXPECT_EQ(std::get<0>(moments[ff]), int64_t(hh.sum()));
+        EXPECT_EQ(std::get<1>(moments[ff]), int64_t(hh.sumSquared()));
+        EXPECT_EQ(std::get<2>(moments[ff]), uint32_t(hh.n()));
+        EXPECT_EQ(std::get<0>(ranges[ff]), uint8_t(hh.min()));
+        EXPECT_EQ(std::get<1>(ranges[ff]), uint8_t(hh.max()));
+    }
+    for (int row = 0; row < 9; row++)
+        for (int col = 0; col < 13; col++){
+            float es = 0, eq = 0;
+            for (const auto& frame : frames){
+                float val = frame.getPixel(col, row);
+                es += val;
+                eq += val * val;
+            }
+            EXPECT_EQ(es, sum.at<float>(row, col));
+            EXPECT_EQ(eq, sqsum.at<float>(row, col));
+        }
+}
+
+TEST (ut_3d_per_element, fused_volume16)
+{
+    // 16 bit frames at full depth, sums are double and exact
+    vector<roiWindow<P16U>> frames;
+    for (int ff = 0; ff < 5; ff++){
+        roiWindow<P16U> frame (11, 7);
+        for (int row = 0; row < frame.height(); row++)
+            for (int col = 0; col < frame.width(); col++)
+                frame.setPixel(col, row, uint16_t(col * 3000 + row * 100 + ff * 7));
+        frames.push_back(frame);
+    }
+    cv::Mat sum, sqsum;
+    std::vector<VolumeAccumulator16::moments_t> moments;
+    std::vector<VolumeAccumulator16::range_t> ranges;
+    VolumeAccumulator16()(frames, sum, sqsum, moments, ranges);
+    ASSERT_EQ(moments.size(), frames.size());
+    EXPECT_EQ(sum.type(), CV_64F);
+    for (size_t ff = 0; ff < frames.size(); ff++){
+        int64_t es = 0, eq = 0;
+        for (int row = 0; row < 7; row++)
+            for (int col = 0; col < 11; col++){
+                int64_t val = frames[ff].getPixel(col, row);
+                es += val;
+                eq += val * val;
+            }
+        EXPECT_EQ(std::get<0>(moments[ff]), es);
+        EXPECT_EQ(std::get<1>(moments[ff]), eq);
+        EXPECT_EQ(std::get<0>(ranges[ff]), uint16_t(ff * 7));
+        EXPECT_EQ(std::get<1>(ranges[ff]), uint16_t(30000 + 600 + ff * 7));
+    }
+    for (int row = 0; row < 7; row++)
+        for (int col = 0; col < 11; col++){
+            double es = 0, eq = 0;
+            for (const auto& frame : frames){
+                double val = frame.getPixel(col, row);
+                es += val;
+                eq += val * val;
+            }
+            EXPECT_EQ(es, sum.at<double>(row, col));
+            EXPECT_EQ(eq, sqsum.at<double>(row, col));
+        }
+}
+
+TEST (ut_3d_per_element, streamed_volume)
+{
+    // Frames added one at a time as they are read give the one pass results
+    std::mt19937 gen (7);
+    vector<roiWindow<P8U>> frames;
+    vector<roiWindow<P16U>> frames16;
+    for (int ff = 0; ff < 9; ff++){
+        roiWindow<P8U> frame (37, 23);
+        roiWindow<P16U> frame16 (37, 23);
+        for (int row = 0; row < frame.height(); row++)
+            for (int col = 0; col < frame.width(); col++){
+                frame.setPixel(col, row, uint8_t(gen() % 256));
+                frame16.setPixel(col, row, uint16_t(gen() % 65536));
+            }
+        frames.push_back(frame);
+        frames16.push_back(frame16);
+    }
+    
+    for (uint8_t spatial : {uint8_t(0), uint8_t(3)}){
+        cv::Mat sum, sqsum, ssum, ssqsum;
+        std::vector<VolumeAccumulator::moments_t> moments, smoments;
+        std::vector<VolumeAccumulator::range_t> ranges, sranges;
+        VolumeAccumulator()(frames, sum, sqsum, moments, ranges, spatial, spatial);
+        VolumeAccumulator::stream volume (spatial, spatial);
+        for (const auto& frame : frames) volume.add(frame);
+        EXPECT_EQ(volume.count(), frames.size());
+        volume.finish(ssum, ssqsum, smoments, sranges);
+        EXPECT_TRUE(moments == smoments);
+        EXPECT_TRUE(ranges == sranges);
+        EXPECT_EQ(0, cv::norm(sum, ssum, NORM_INF));
+        EXPECT_EQ(0, cv::norm(sqsum, ssqsum, NORM_INF));
+    }
+    
+    cv::Mat sum, sqsum, ssum, ssqsum;
+    std::vector<VolumeAccumulator16::moments_t> moments, smoments;
+    std::vector<VolumeAccumulator16::range_t> ranges, sranges;
+    VolumeAccumulator16()(frames16, sum, sqsum, moments, ranges);
+    VolumeAccumulator16::stream volume;
+    for (const auto& frame : frames16) volume.add(frame);
+    volume.finish(ssum, ssqsum, smoments, sranges);
+    EXPECT_TRUE(moments == smoments);
+    EXPECT_TRUE(ranges == sranges);
+    EXPECT_EQ(0, cv::norm(sum, ssum, NORM_INF));
+    EXPECT_EQ(0, cv::norm(sqsum, ssqsum, NORM_INF));
+}
+
+
+TEST (ut_playback_ring, read_ahead)
+{
+    // Frame i decodes to 10 i, frame 13 fails
+    std::atomic<int> decoded (0);
+    playback_ring<int> ring ([&decoded] (int64_t index, int& frame) {
+        decoded++;
+        frame = int(index) * 10;
+        return index != 13;
+    }, 20, 4);
+    
+    typedef playback_ring<int> ring_t;
+    auto take = [&ring] (int64_t index, int& frame) {
+        for (int tries = 0; tries < 1000; tries++){
+            const ring_t::fetch_t result = ring.fetch(index, frame);
+            if (result != ring_t::pending) return result;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return ring_t::pending;
+    };
+    
+    // Forward, the frames ahead are decoded before they are asked for
+    int frame = -1;
+    for (int64_t ii = 0; ii < 8; ii++){
+        ring.seek(ii, 1);
+        EXPECT_EQ(ring_t::fetched, take(ii, frame));
+        EXPECT_EQ(frame, ii * 10);
+    }
+    // Window of 7 is 7 to 10, 7 is on display and not decoded again
+    for (int tries = 0; tries < 1000 && ! ring.ready(10); tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_TRUE(ring.ready(8));
+    EXPECT_TRUE(ring.ready(10));
+    EXPECT_FALSE(ring.ready(7));
+    EXPECT_FALSE(ring.ready(11));
+    
+    // Backwards with a stride, and past the end
+    ring.seek(17, -3);
+    EXPECT_EQ(ring_t::fetched, take(17, frame));
+    EXPECT_EQ(frame, 170);
+    EXPECT_EQ(ring_t::fetched, take(14, frame));
+    EXPECT_EQ(frame, 140);
+    EXPECT_EQ(ring_t::pending, ring.fetch(13, frame));
+    ring.seek(19, 5);
+    EXPECT_EQ(ring_t::fetched, take(19, frame));
+    EXPECT_EQ(frame, 190);
+    
+    // A failed frame is reported, not handed out, and play continues past it
+    frame = -1;
+    for (int64_t ii = 12; ii < 16; ii++){
+        ring.seek(ii, 1);
+        EXPECT_EQ(ii == 13 ? ring_t::failed : ring_t::fetched, take(ii, frame));
+        EXPECT_EQ(ii == 13 ? 120 : ii * 10, frame);
+    }
+    EXPECT_LT(decoded.load(), 30);
+}
 
 TEST (ut_ss_voxel, basic){
     
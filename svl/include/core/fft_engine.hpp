@@ -0,0 +1,467 @@
+#ifndef __SVL_FFT_ENGINE__
+#define __SVL_FFT_ENGINE__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#endif
+
+namespace svl
+{
+
+/*
+ * fft_plan - Portable forward complex FFT of one size, applied to batches of signals.
+ *
+ * Self sorting ( Stockham ) decimation in frequency over the factors of n: radix 4, 2, 3, 5
+ * butterflies and a generic odd radix for the rest, so any size works and sizes with small
+ * factors are fast. A batch of signals is transformed together with element k of signal b
+ * at k * batch + b: every butterfly then runs over contiguous runs of the batch, which the
+ * compiler vectorizes.
+ *
+ * Plans hold twiddle tables only and are shared through the cache of get().
+ */
+class fft_plan
+{
+public:
+    typedef std::shared_ptr<const fft_plan> ref;
+
+    explicit fft_plan (size_t n) : m_n(n)
+    {
+        assert(n > 0);
+        size_t rest = n;
+        size_t stride = 1;
+        while (rest > 1)
+        {
+            size_t radix = 0;
+            for (size_t r : {size_t(4), size_t(2), size_t(3), size_t(5)})
+                if (rest % r == 0) { radix = r; break; }
+            if (radix == 0)
+                for (radix = 7; rest % radix; radix += 2) {}
+            m_stages.emplace_back(rest, radix, stride);
+            rest /= radix;
+            stride *= radix;
+        }
+    }
+
+    // Cached plan for size n
+    static ref get (size_t n)
+    {
+        static std::mutex mutex;
+        static std::map<size_t, ref> cache;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto pp = cache.find(n);
+        if (pp != cache.end()) return pp->second;
+        ref plan = std::make_shared<fft_plan>(n);
+        cache.emplace(n, plan);
+        return plan;
+    }
+
+    size_t size () const { return m_n; }
+
+    /*
+     * Forward transform in place of batch interleaved signals, re and im of n * batch elements.
+     * work_re and work_im are scratch of the same size. Unscaled: X[k] = sum x[j] exp(-2 pi i j k / n).
+     */
+    void forward (float* re, float* im, size_t batch, float* work_re, float* work_im) const
+    {
+        float *xr = re, *xi = im, *yr = work_re, *yi = work_im;
+        for (const auto& st : m_stages)
+        {
+            st.run(xr, xi, yr, yi, batch);
+            std::swap(xr, yr);
+            std::swap(xi, yi);
+        }
+        if (xr != re)
+        {
+            std::copy(xr, xr + m_n * batch, re);
+            std::copy(xi, xi + m_n * batch, im);
+        }
+    }
+
+private:
+    /*
+     * One stage over sub sequences of length len = radix * m, sequence stride s: for p < m,
+     * a_t = x[s (p + t m)], y[s (radix p + u)] = w^(p u) sum_t a_t W_radix^(t u), w = exp(-2 pi i / len).
+     */
+    struct stage
+    {
+        size_t len, radix, m, s;
+        std::vector<float> tw_re, tw_im;    // w^(p u), p < m, 0 < u < radix
+        std::vector<float> dft_re, dft_im;  // W_radix^(t u), generic radix only
+
+        stage (size_t length, size_t rdx, size_t stride)
+        : len(length), radix(rdx), m(length / rdx), s(stride)
+        {
+            const double pi2 = 2.0 * 3.14159265358979323846;
+            tw_re.resize(m * (radix - 1));
+            tw_im.resize(m * (radix - 1));
+            for (size_t p = 0; p < m; p++)
+                for (size_t u = 1; u < radix; u++)
+                {
+                    const double ang = -pi2 * double(p * u) / double(len);
+                    tw_re[p * (radix - 1) + u - 1] = float(std::cos(ang));
+                    tw_im[p * (radix - 1) + u - 1] = float(std::sin(ang));
+                }
+            if (radix > 5)
+            {
+                dft_re.resize(radix * radix);
+                dft_im.resize(radix * radix);
+                for (size_t t = 0; t < radix; t++)
+                    for (size_t u = 0; u < radix; u++)
+                    {
+                        const double ang = -pi2 * double((t * u) % radix) / double(radix);
+                        dft_re[t * radix + u] = float(std::cos(ang));
+                        dft_im[t * radix + u] = float(std::sin(ang));
+                    }
+            }
+        }
+
+        void run (const float* xr, const float* xi, float* yr, float* yi, size_t batch) const
+        {
+            const size_t run = s * batch;           // contiguous elements per index
+            for (size_t p = 0; p < m; p++)
+            {
+                const float* twr = &tw_re[p * (radix - 1)];
+                const float* twi = &tw_im[p * (radix - 1)];
+                const size_t in0 = p * run, in_step = m * run;
+                const size_t out0 = radix * p * run;
+                switch (radix)
+                {
+                    case 2: radix2(xr, xi, yr, yi, in0, in_step, out0, run, twr, twi); break;
+                    case 3: radix3(xr, xi, yr, yi, in0, in_step, out0, run, twr, twi); break;
+                    case 4: radix4(xr, xi, yr, yi, in0, in_step, out0, run, twr, twi); break;
+                    case 5: radix5(xr, xi, yr, yi, in0, in_step, out0, run, twr, twi); break;
+                    default: generic(xr, xi, yr, yi, in0, in_step, out0, run, twr, twi); break;
+                }
+            }
+        }
+
+        static void twiddle (float& r, float& i, float wr, float wi)
+        {
+            const float t = r * wr - i * wi;
+            i = r * wi + i * wr;
+            r = t;
+        }
+
+        static void radix2 (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi,
+                            size_t in0, size_t in_step, size_t out0, size_t run, const float* twr, const float* twi)
+        {
+            const float* ar = xr + in0; const float* ai = xi + in0;
+            const float* br = ar + in_step; const float* bi = ai + in_step;
+            float* y0r = yr + out0; float* y0i = yi + out0;
+            float* y1r = y0r + run; float* y1i = y0i + run;
+            const float wr = twr[0], wi = twi[0];
+            for (size_t k = 0; k < run; k++)
+            {
+                y0r[k] = ar[k] + br[k];
+                y0i[k] = ai[k] + bi[k];
+                const float dr = ar[k] - br[k], di = ai[k] - bi[k];
+                y1r[k] = dr * wr - di * wi;
+                y1i[k] = dr * wi + di * wr;
+            }
+        }
+
+        static void radix3 (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi,
+                            size_t in0, size_t in_step, size_t out0, size_t run, const float* twr, const float* twi)
+        {
+            const float c1 = -0.5f, s1 = -0.866025403784438647f;    // W_3 = c1 + i s1
+            const float* a0r = xr + in0; const float* a0i = xi + in0;
+            const float* a1r = a0r + in_step; const float* a1i = a0i + in_step;
+            const float* a2r = a1r + in_step; const float* a2i = a1i + in_step;
+            float* y0r = yr + out0; float* y0i = yi + out0;
+            for (size_t k = 0; k < run; k++)
+            {
+                const float sr = a1r[k] + a2r[k], si = a1i[k] + a2i[k];
+                const float dr = a1r[k] - a2r[k], di = a1i[k] - a2i[k];
+                const float mr = a0r[k] + c1 * sr, mi = a0i[k] + c1 * si;
+                float b1r = mr - s1 * di, b1i = mi + s1 * dr;
+                float b2r = mr + s1 * di, b2i = mi - s1 * dr;
+                twiddle(b1r, b1i, twr[0], twi[0]);
+                twiddle(b2r, b2i, twr[1], twi[1]);
+                y0r[k] = a0r[k] + sr; y0i[k] = a0i[k] + si;
+                y0r[k + run] = b1r; y0i[k + run] = b1i;
+                y0r[k + 2 * run] = b2r; y0i[k + 2 * run] = b2i;
+            }
+        }
+
+        static void radix4 (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi,
+                            size_t in0, size_t in_step, size_t out0, size_t run, const float* twr, const float* twi)
+        {
+            const float* a0r = xr + in0; const float* a0i = xi + in0;
+            const float* a1r = a0r + in_step; const float* a1i = a0i + in_step;
+            const float* a2r = a1r + in_step; const float* a2i = a1i + in_step;
+            const float* a3r = a2r + in_step; const float* a3i = a2i + in_step;
+            float* y0r = yr + out0; float* y0i = yi + out0;
+            for (size_t k = 0; k < run; k++)
+            {
+                const float s02r = a0r[k] + a2r[k], s02i = a0i[k] + a2i[k];
+                const float d02r = a0r[k] - a2r[k], d02i = a0i[k] - a2i[k];
+                const float s13r = a1r[k] + a3r[k], s13i = a1i[k] + a3i[k];
+                const float d13r = a1r[k] - a3r[k], d13i = a1i[k] - a3i[k];
+                // W_4 = -i
+                float b1r = d02r + d13i, b1i = d02i - d13r;
+                float b2r = s02r - s13r, b2i = s02i - s13i;
+                float b3r = d02r - d13i, b3i = d02i + d13r;
+                twiddle(b1r, b1i, twr[0], twi[0]);
+                twiddle(b2r, b2i, twr[1], twi[1]);
+                twiddle(b3r, b3i, twr[2], twi[2]);
+                y0r[k] = s02r + s13r; y0i[k] = s02i + s13i;
+                y0r[k + run] = b1r; y0i[k + run] = b1i;
+                y0r[k + 2 * run] = b2r; y0i[k + 2 * run] = b2i;
+                y0r[k + 3 * run] = b3r; y0i[k + 3 * run] = b3i;
+            }
+        }
+
+        static void radix5 (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi,
+                            size_t in0, size_t in_step, size_t out0, size_t run, const float* twr, const float* twi)
+        {
+            const float c1 = 0.309016994374947424f, c2 = -0.809016994374947424f;
+            const float s1 = -0.951056516295153572f, s2 = -0.587785252292473129f;
+            const float* a0r = xr + in0; const float* a0i = xi + in0;
+            const float* a1r = a0r + in_step; const float* a1i = a0i + in_step;
+            const float* a2r = a1r + in_step; const float* a2i = a1i + in_step;
+            const float* a3r = a2r + in_step; const float* a3i = a2i + in_step;
+            const float* a4r = a3r + in_step; const float* a4i = a3i + in_step;
+            float* y0r = yr + out0; float* y0i = yi + out0;
+            for (size_t k = 0; k < run; k++)
+            {
+                const float s14r = a1r[k] + a4r[k], s14i = a1i[k] + a4i[k];
+                const float d14r = a1r[k] - a4r[k], d14i = a1i[k] - a4i[k];
+                const float s23r = a2r[k] + a3r[k], s23i = a2i[k] + a3i[k];
+                const float d23r = a2r[k] - a3r[k], d23i = a2i[k] - a3i[k];
+                const float m1r = a0r[k] + c1 * s14r + c2 * s23r, m1i = a0i[k] + c1 * s14i + c2 * s23i;
+                const float m2r = a0r[k] + c2 * s14r + c1 * s23r, m2i = a0i[k] + c2 * s14i + c1 * s23i;
+                const float n1r = s1 * d14r + s2 * d23r, n1i = s1 * d14i + s2 * d23i;
+                const float n2r = s2 * d14r - s1 * d23r, n2i = s2 * d14i - s1 * d23i;
+                float b1r = m1r - n1i, b1i = m1i + n1r;
+                float b4r = m1r + n1i, b4i = m1i - n1r;
+                float b2r = m2r - n2i, b2i = m2i + n2r;
+                float b3r = m2r + n2i, b3i = m2i - n2r;
+                twiddle(b1r, b1i, twr[0], twi[0]);
+                twiddle(b2r, b2i, twr[1], twi[1]);
+                twiddle(b3r, b3i, twr[2], twi[2]);
+                twiddle(b4r, b4i, twr[3], twi[3]);
+                y0r[k] = a0r[k] + s14r + s23r; y0i[k] = a0i[k] + s14i + s23i;
+                y0r[k + run] = b1r; y0i[k + run] = b1i;
+                y0r[k + 2 * run] = b2r; y0i[k + 2 * run] = b2i;
+                y0r[k + 3 * run] = b3r; y0i[k + 3 * run] = b3i;
+                y0r[k + 4 * run] = b4r; y0i[k + 4 * run] = b4i;
+            }
+        }
+
+        void generic (const float* __restrict xr, const float* __restrict xi, float* __restrict yr, float* __restrict yi,
+                      size_t in0, size_t in_step, size_t out0, size_t run, const float* twr, const float* twi) const
+        {
+            for (size_t u = 0; u < radix; u++)
+            {
+                float* outr = yr + out0 + u * run;
+                float* outi = yi + out0 + u * run;
+                std::fill(outr, outr + run, 0.0f);
+                std::fill(outi, outi + run, 0.0f);
+                for (size_t t = 0; t < radix; t++)
+                {
+                    const float wr = dft_re[t * radix + u], wi = dft_im[t * radix + u];
+                    const float* ar = xr + in0 + t * in_step;
+                    const float* ai = xi + in0 + t * in_step;
+                    for (size_t k = 0; k < run; k++)
+                    {
+                        outr[k] += ar[k] * wr - ai[k] * wi;
+                        outi[k] += ar[k] * wi + ai[k] * wr;
+                    }
+                }
+                if (u == 0) continue;
+                const float wr = twr[u - 1], wi = twi[u - 1];
+                for (size_t k = 0; k < run; k++)
+                    twiddle(outr[k], outi[k], wr, wi);
+            }
+        }
+    };
+
+    size_t m_n;
+    std::vector<stage> m_stages;
+};
+
+
+/*
+ * fft_real - Forward FFT of real signals of length n, for one signal or batches of them.
+ *
+ * Output is the half spectrum, bins 0 to n / 2, unscaled as fft_plan. Even n is packed as a
+ * complex signal of n / 2 and unpacked after the transform; odd n is transformed as complex.
+ * On Apple power of 2 sizes use vDSP, everything else the portable fft_plan. Use one engine
+ * per thread, it keeps scratch buffers.
+ */
+class fft_real
+{
+public:
+    explicit fft_real (size_t n) : m_n(n), m_bins(n / 2 + 1)
+    {
+        assert(n > 0);
+#if defined(__APPLE__)
+        m_vdsp = nullptr;
+        m_log2n = 0;
+        while ((size_t(1) << m_log2n) < n) m_log2n++;
+        if (n >= 4 && (size_t(1) << m_log2n) == n)
+        {
+            m_vdsp = vDSP_create_fftsetup(m_log2n, kFFTRadix2);
+            return;
+        }
+#endif
+        m_packed = (n % 2) == 0 && n > 2;
+        m_plan = fft_plan::get(m_packed ? n / 2 : n);
+        if (m_packed)
+        {
+            const double pi2 = 2.0 * 3.14159265358979323846;
+            m_unpack_re.resize(m_bins);
+            m_unpack_im.resize(m_bins);
+            for (size_t k = 0; k < m_bins; k++)
+            {
+                m_unpack_re[k] = float(std::cos(-pi2 * double(k) / double(n)));
+                m_unpack_im[k] = float(std::sin(-pi2 * double(k) / double(n)));
+            }
+        }
+    }
+
+    ~fft_real ()
+    {
+#if defined(__APPLE__)
+        if (m_vdsp) vDSP_destroy_fftsetup(m_vdsp);
+#endif
+    }
+
+    fft_real (const fft_real&) = delete;
+    fft_real& operator= (const fft_real&) = delete;
+
+    size_t size () const { return m_n; }
+    size_t bins () const { return m_bins; }
+
+    // One signal: in has n samples, re and im get bins() values
+    void forward (const float* in, float* re, float* im)
+    {
+        forward(in, 1, m_n, re, im, m_bins);
+    }
+
+    /*
+     * count signals, signal b at in + b * in_stride, its spectrum at re / im + b * out_stride.
+     * Signals are transformed in groups of batch_width, interleaved so the butterflies vectorize.
+     */
+    void forward (const float* in, size_t count, size_t in_stride, float* re, float* im, size_t out_stride)
+    {
+#if defined(__APPLE__)
+        if (m_vdsp)
+        {
+            forward_vdsp(in, count, in_stride, re, im, out_stride);
+            return;
+        }
+#endif
+        for (size_t b0 = 0; b0 < count; b0 += batch_width)
+        {
+            const size_t nb = std::min(size_t(batch_width), count - b0);
+            forward_group(in + b0 * in_stride, nb, in_stride, re + b0 * out_stride, im + b0 * out_stride, out_stride);
+        }
+    }
+
+    static const size_t batch_width = 8;
+
+private:
+    void forward_group (const float* in, size_t nb, size_t in_stride, float* re, float* im, size_t out_stride)
+    {
+        const size_t cn = m_plan->size();
+        m_re.resize(cn * nb); m_im.resize(cn * nb);
+        m_wre.resize(cn * nb); m_wim.resize(cn * nb);
+
+        // Interleave: element k of signal b at k * nb + b
+        for (size_t b = 0; b < nb; b++)
+        {
+            const float* src = in + b * in_stride;
+            if (m_packed)
+                for (size_t k = 0; k < cn; k++)
+                {
+                    m_re[k * nb + b] = src[2 * k];
+                    m_im[k * nb + b] = src[2 * k + 1];
+                }
+            else
+                for (size_t k = 0; k < cn; k++)
+                {
+                    m_re[k * nb + b] = src[k];
+                    m_im[k * nb + b] = 0.0f;
+                }
+        }
+
+        m_plan->forward(m_re.data(), m_im.data(), nb, m_wre.data(), m_wim.data());
+
+        if (! m_packed)
+        {
+            for (size_t b = 0; b < nb; b++)
+                for (size_t k = 0; k < m_bins; k++)
+                {
+                    re[b * out_stride + k] = m_re[k * nb + b];
+                    im[b * out_stride + k] = m_im[k * nb + b];
+                }
+            return;
+        }
+
+        // Z = FFT(x[2k] + i x[2k+1]), X[k] = (Z[k] + conj Z[h-k]) / 2 - i w^k (Z[k] - conj Z[h-k]) / 2
+        const size_t h = cn;
+        for (size_t k = 0; k < m_bins; k++)
+        {
+            const size_t k1 = (k == h) ? 0 : k;
+            const size_t k2 = (k == 0) ? 0 : h - k;
+            const float wr = m_unpack_re[k], wi = m_unpack_im[k];
+            for (size_t b = 0; b < nb; b++)
+            {
+                const float zr = m_re[k1 * nb + b], zi = m_im[k1 * nb + b];
+                const float cr = m_re[k2 * nb + b], ci = -m_im[k2 * nb + b];
+                const float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+                const float dr = 0.5f * (zr - cr), di = 0.5f * (zi - ci);
+                // -i w d
+                const float tr = wr * dr - wi * di, ti = wr * di + wi * dr;
+                re[b * out_stride + k] = er + ti;
+                im[b * out_stride + k] = ei - tr;
+            }
+        }
+    }
+
+#if defined(__APPLE__)
+    // vDSP_fft_zrip packs DC and Nyquist into element 0 and scales by 2
+    void forward_vdsp (const float* in, size_t count, size_t in_stride, float* re, float* im, size_t out_stride)
+    {
+        const size_t half = m_n / 2;
+        m_re.resize(half); m_im.resize(half);
+        DSPSplitComplex split = { m_re.data(), m_im.data() };
+        const float scale = 0.5f;
+        for (size_t b = 0; b < count; b++)
+        {
+            vDSP_ctoz((const DSPComplex*)(in + b * in_stride), 2, &split, 1, half);
+            vDSP_fft_zrip(m_vdsp, &split, 1, m_log2n, kFFTDirection_Forward);
+            float* outr = re + b * out_stride;
+            float* outi = im + b * out_stride;
+            vDSP_vsmul(m_re.data(), 1, &scale, outr, 1, half);
+            vDSP_vsmul(m_im.data(), 1, &scale, outi, 1, half);
+            outr[half] = scale * m_im[0];
+            outi[half] = 0.0f;
+            outi[0] = 0.0f;
+        }
+    }
+
+    FFTSetup m_vdsp;
+    vDSP_Length m_log2n;
+#endif
+
+    size_t m_n, m_bins;
+    bool m_packed = false;
+    fft_plan::ref m_plan;
+    std::vector<float> m_unpack_re, m_unpack_im;
+    std::vector<float> m_re, m_im, m_wre, m_wim;
+};
+
+}
+
+#endif
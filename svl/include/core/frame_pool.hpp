@@ -0,0 +1,248 @@
+#ifndef __SVL_FRAME_POOL__
+#define __SVL_FRAME_POOL__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace svl
+{
+
+/*
+ * frame_pool - Size class pool of frame buffer blocks.
+ *
+ * Requests are rounded up to a size class, 4 classes per power of two, so at most a quarter
+ * of a block is slack. A released block goes back to its class's free list and is handed out
+ * again to the next request of that class, instead of going through the heap. Free blocks are
+ * kept up to capacity bytes, beyond that they are deleted.
+ *
+ * Blocks start on an alignment boundary, the largest root<T> row alignment, so a frame of a power of
+ * two size needs no slack and fits its class exactly.
+ *
+ * Blocks are shared pointers whose deleter returns them to the pool, they hold the pool alive.
+ * Once a pool is closed its free blocks are deleted and blocks released later go to the heap,
+ * that is how a frame_arena frees a whole pipeline's buffers at once.
+ *
+ * root<T> allocates from current(): the pool of the innermost frame_pool::scope on the calling
+ * thread, or the global pool.
+ */
+class frame_pool : public std::enable_shared_from_this<frame_pool>
+{
+public:
+    typedef std::shared_ptr<uint8_t> block_t;
+
+    struct counters
+    {
+        counters () : acquired(0), reused(0), heap(0), released(0), bytes_out(0), bytes_cached(0), peak_bytes_out(0) {}
+        size_t acquired;        // blocks handed out
+        size_t reused;          // of those, taken from a free list
+        size_t heap;            // of those, newly allocated
+        size_t released;        // blocks returned
+        size_t bytes_out;       // in blocks currently handed out
+        size_t bytes_cached;    // in free blocks
+        size_t peak_bytes_out;
+    };
+
+    static std::shared_ptr<frame_pool> create (size_t capacity = default_capacity)
+    {
+        return std::shared_ptr<frame_pool>(new frame_pool(capacity));
+    }
+
+    // Process wide pool, never closed
+    static const std::shared_ptr<frame_pool>& global ()
+    {
+        static const std::shared_ptr<frame_pool> pool = create();
+        return pool;
+    }
+
+    static const std::shared_ptr<frame_pool>& current ()
+    {
+        const auto& pool = tls_current();
+        return pool ? pool : global();
+    }
+
+    // Makes pool the calling thread's current pool for its lifetime
+    class scope
+    {
+    public:
+        explicit scope (const std::shared_ptr<frame_pool>& pool) : m_previous(tls_current())
+        {
+            if (pool) tls_current() = pool;
+        }
+        ~scope () { tls_current() = m_previous; }
+        scope (const scope&) = delete;
+        scope& operator= (const scope&) = delete;
+    private:
+        std::shared_ptr<frame_pool> m_previous;
+    };
+
+    frame_pool (const frame_pool&) = delete;
+    frame_pool& operator= (const frame_pool&) = delete;
+
+    ~frame_pool ()
+    {
+        trim();
+    }
+
+    // A block of at least bytes, aligned to alignment
+    block_t acquire (size_t bytes)
+    {
+        const size_t ci = size_class(std::max(bytes, size_t(1)));
+        const size_t size = class_bytes(ci);
+        uint8_t* ptr = nullptr;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_counters.acquired++;
+            if (ci < m_free.size() && ! m_free[ci].empty())
+            {
+                ptr = m_free[ci].back();
+                m_free[ci].pop_back();
+                m_counters.reused++;
+                m_counters.bytes_cached -= size;
+            }
+            else
+                m_counters.heap++;
+            m_counters.bytes_out += size;
+            m_counters.peak_bytes_out = std::max(m_counters.peak_bytes_out, m_counters.bytes_out);
+        }
+        if (! ptr) ptr = allocate(size);
+        auto self = shared_from_this();
+        return block_t(ptr, [self, ci] (uint8_t* pp) { self->release(pp, ci); });
+    }
+
+    // Delete all free blocks
+    void trim ()
+    {
+        std::vector<std::vector<uint8_t*>> free;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            free.swap(m_free);
+            m_counters.bytes_cached = 0;
+        }
+        for (auto& fl : free)
+            for (uint8_t* pp : fl) std::free(pp);
+    }
+
+    // Free blocks are deleted and no longer kept
+    void close ()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_closed = true;
+        }
+        trim();
+    }
+
+    void set_capacity (size_t capacity)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_capacity = capacity;
+            if (m_counters.bytes_cached <= m_capacity) return;
+        }
+        trim();
+    }
+
+    counters stats () const
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        return m_counters;
+    }
+
+    // Size class index of bytes and its block size
+    static size_t size_class (size_t bytes)
+    {
+        if (bytes <= min_class_bytes) return 0;
+        size_t pow = min_class_bytes;
+        size_t ci = 0;
+        while (pow * 2 < bytes)
+        {
+            pow *= 2;
+            ci += steps;
+        }
+        const size_t step = pow / steps;
+        return ci + (bytes - pow + step - 1) / step;
+    }
+
+    static size_t class_bytes (size_t ci)
+    {
+        if (ci == 0) return min_class_bytes;
+        const size_t pow = min_class_bytes << ((ci - 1) / steps);
+        return pow + (pow / steps) * ((ci - 1) % steps + 1);
+    }
+
+    static const size_t default_capacity = size_t(256) << 20;
+    static const size_t alignment = 256;
+
+private:
+    static const size_t min_class_bytes = 64;
+    static const size_t steps = 4;
+
+    explicit frame_pool (size_t capacity) : m_capacity(capacity), m_closed(false) {}
+
+    static uint8_t* allocate (size_t size)
+    {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, alignment, size) != 0) throw std::bad_alloc();
+        return static_cast<uint8_t*>(ptr);
+    }
+
+    static std::shared_ptr<frame_pool>& tls_current ()
+    {
+        static thread_local std::shared_ptr<frame_pool> pool;
+        return pool;
+    }
+
+    void release (uint8_t* ptr, size_t ci)
+    {
+        const size_t size = class_bytes(ci);
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_counters.released++;
+            m_counters.bytes_out -= size;
+            if (! m_closed && m_counters.bytes_cached + size <= m_capacity)
+            {
+                if (m_free.size() <= ci) m_free.resize(ci + 1);
+                m_free[ci].push_back(ptr);
+                m_counters.bytes_cached += size;
+                return;
+            }
+        }
+        std::free(ptr);
+    }
+
+    mutable std::mutex m_mutex;
+    std::vector<std::vector<uint8_t*>> m_free;   // by size class
+    size_t m_capacity;
+    bool m_closed;
+    counters m_counters;
+};
+
+/*
+ * frame_arena - A pipeline's own frame_pool. Its buffers are recycled among themselves and all
+ * of its free buffers are deleted together when the arena is destroyed.
+ */
+class frame_arena
+{
+public:
+    explicit frame_arena (size_t capacity = frame_pool::default_capacity) : m_pool(frame_pool::create(capacity)) {}
+    ~frame_arena () { m_pool->close(); }
+
+    frame_arena (const frame_arena&) = delete;
+    frame_arena& operator= (const frame_arena&) = delete;
+
+    const std::shared_ptr<frame_pool>& pool () const { return m_pool; }
+    frame_pool::counters stats () const { return m_pool->stats(); }
+
+private:
+    std::shared_ptr<frame_pool> m_pool;
+};
+
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef __SVL_FRAME_SOURCE__
+#define __SVL_FRAME_SOURCE__
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace svl
+{
+
+/*
+ * frame_source - Frames read ahead on a background thread through a bounded queue.
+ *
+ * The reader thread calls read(t0, t1, frames) for runs of run frames, in order, to append
+ * frames t0 .. t1 - 1, and queues them. At most window frames wait in the queue, the reader
+ * blocks when it is full. Consumers take frames with next() as they arrive, so processing of
+ * the first frames overlaps reading of the following ones.
+ *
+ * F is the frame type, cheap to copy ( a roiWindow or a cv::Mat ). An exception thrown by read
+ * ends reading and is re-thrown by next() after the frames read before it.
+ */
+template<typename F>
+class frame_source
+{
+public:
+    typedef std::function<void(size_t, size_t, std::vector<F>&)> read_fn_t;
+    typedef std::function<void(size_t, const F&)> consumer_fn_t;
+
+    /*
+     * read   - reads a run of frames, called from the reader thread only
+     * count  - frames [0, count)
+     * window - read ahead depth in frames
+     * run    - frames per read call, 0 for a quarter window
+     */
+    frame_source (read_fn_t read, size_t count, size_t window = 16, size_t run = 0)
+    : m_read(std::move(read)), m_count(count), m_window(std::max(size_t(1), window)),
+    m_run(run ? run : std::max(size_t(1), m_window / 4)), m_stop(false), m_done(false)
+    {
+        m_thread = std::thread(&frame_source::read_ahead, this);
+    }
+
+    ~frame_source ()
+    {
+        stop();
+    }
+
+    frame_source (const frame_source&) = delete;
+    frame_source& operator= (const frame_source&) = delete;
+
+    size_t count () const { return m_count; }
+    size_t window () const { return m_window; }
+
+    /*
+     * next - Block until the next frame is read. Returns false when all frames were
+     * delivered or the source was stopped. A read error is re-thrown here.
+     */
+    bool next (size_t& index, F& frame)
+    {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        m_not_empty.wait(lk, [this] () { return ! m_queue.empty() || m_done; });
+        if (m_queue.empty())
+        {
+            if (m_error) std::rethrow_exception(m_error);
+            return false;
+        }
+        index = m_queue.front().first;
+        frame = std::move(m_queue.front().second);
+        m_queue.pop_front();
+        lk.unlock();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    // Run consumer ( index, frame ) on the calling thread for every frame. Returns the count.
+    size_t drain (const consumer_fn_t& consumer)
+    {
+        size_t count = 0;
+        size_t index;
+        F frame;
+        while (next(index, frame))
+        {
+            consumer(index, frame);
+            count++;
+        }
+        return count;
+    }
+
+    // Stop reading and release the reader thread. Frames already queued are dropped.
+    void stop ()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_stop = true;
+        }
+        m_not_full.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_queue.clear();
+        m_done = true;
+        m_not_empty.notify_all();
+    }
+
+private:
+    void read_ahead ()
+    {
+        size_t t = 0, te = 0;
+        std::vector<F> frames;
+        try
+        {
+            while (t < m_count)
+            {
+                {
+                    std::lock_guard<std::mutex> lk(m_mutex);
+                    if (m_stop) break;
+                }
+                te = std::min(m_count, t + m_run);
+                frames.reserve(te - t);
+                m_read(t, te, frames);
+                if (frames.size() != te - t)
+                    throw std::runtime_error("frame_source: short read");
+                if (! queue(t, te, frames)) return;
+                t = te;
+            }
+        }
+        catch (...)
+        {
+            // Frames of the run read before the error go first
+            if (! queue(t, te, frames)) return;
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_done = true;
+        }
+        m_not_empty.notify_all();
+    }
+
+    // Queue frames of run [t, te) and clear them. Returns false if stopped.
+    bool queue (size_t t, size_t te, std::vector<F>& frames)
+    {
+        const size_t count = std::min(frames.size(), te - t);
+        for (size_t ii = 0; ii < count; ii++)
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_not_full.wait(lk, [this] () { return m_queue.size() < m_window || m_stop; });
+            if (m_stop) return false;
+            m_queue.emplace_back(t + ii, std::move(frames[ii]));
+            lk.unlock();
+            m_not_empty.notify_one();
+        }
+        frames.clear();
+        return true;
+    }
+
+    read_fn_t m_read;
+    const size_t m_count;
+    const size_t m_window;
+    const size_t m_run;
+
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+    std::deque<std::pair<size_t, F>> m_queue;
+    bool m_stop;
+    bool m_done;
+    std::exception_ptr m_error;
+    std::thread m_thread;
+};
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef __SVL_SYMMETRIC_MATRIX__
+#define __SVL_SYMMETRIC_MATRIX__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace svl
+{
+
+/*
+ * symmetric_matrix - Square symmetric matrix in one contiguous, reference counted buffer.
+ *
+ * Copies share the buffer, so a matrix can be handed from producer to consumers without
+ * copying its n x n elements. Writes go through set(), which first detaches a shared buffer
+ * ( copy on write ). Detaching is not synchronized: a matrix being written must not be copied
+ * concurrently, reading shared copies from many threads is fine.
+ *
+ * dense storage keeps all n x n elements row major, so rows are contiguous ( row() ).
+ * packed storage keeps the upper triangle only, n (n + 1) / 2 elements, and has no row pointers.
+ */
+template<typename T>
+class symmetric_matrix
+{
+public:
+    typedef T value_type;
+    enum storage_t { dense, packed };
+
+    symmetric_matrix () : m_n(0), m_storage(dense) {}
+
+    explicit symmetric_matrix (size_t n, storage_t storage = dense, T value = T(0))
+    : m_n(n), m_storage(storage)
+    {
+        if (m_n) m_data = std::make_shared<std::vector<T>>(element_count(n, storage), value);
+    }
+
+    // From any square container of rows, e.g. deque<deque<double>>. Symmetry is not checked,
+    // the upper triangle is taken.
+    template<typename Rows>
+    static symmetric_matrix from_rows (const Rows& rows, storage_t storage = dense)
+    {
+        symmetric_matrix sm (rows.size(), storage);
+        if (sm.empty()) return sm;
+        T* dst = sm.m_data->data();
+        size_t ii = 0;
+        for (const auto& row : rows)
+        {
+            assert(row.size() == sm.m_n);
+            size_t jj = 0;
+            for (const auto& val : row)
+            {
+                if (storage == dense) *dst++ = static_cast<T>(val);
+                else if (jj >= ii) *dst++ = static_cast<T>(val);
+                jj++;
+            }
+            ii++;
+        }
+        return sm;
+    }
+
+    // Into a square container of rows
+    template<typename Rows>
+    void to_rows (Rows& rows) const
+    {
+        rows.resize(m_n);
+        for (size_t ii = 0; ii < m_n; ii++)
+        {
+            rows[ii].resize(m_n);
+            for (size_t jj = 0; jj < m_n; jj++)
+                rows[ii][jj] = (*this)(ii, jj);
+        }
+    }
+
+    size_t size () const { return m_n; }
+    bool empty () const { return m_n == 0; }
+    storage_t storage () const { return m_storage; }
+
+    // Number of matrices sharing the buffer
+    long use_count () const { return m_data.use_count(); }
+
+    T operator() (size_t ii, size_t jj) const
+    {
+        assert(ii < m_n && jj < m_n);
+        return (*m_data)[index(ii, jj)];
+    }
+
+    // Set element ii,jj and jj,ii
+    void set (size_t ii, size_t jj, T value)
+    {
+        assert(ii < m_n && jj < m_n);
+        detach();
+        (*m_data)[index(ii, jj)] = value;
+        if (m_storage == dense) (*m_data)[index(jj, ii)] = value;
+    }
+
+    // Row ii, dense storage only
+    const T* row (size_t ii) const
+    {
+        assert(m_storage == dense && ii < m_n);
+        return m_data->data() + ii * m_n;
+    }
+
+    // The buffer, n x n row major for dense, upper triangle by rows for packed
+    const T* data () const { return m_data ? m_data->data() : nullptr; }
+
+    // Writable buffer, detached from other copies
+    T* mutable_data ()
+    {
+        detach();
+        return m_data ? m_data->data() : nullptr;
+    }
+
+    // Converted copy, to the other value type and / or storage
+    template<typename U>
+    symmetric_matrix<U> cast (typename symmetric_matrix<U>::storage_t storage = symmetric_matrix<U>::dense) const
+    {
+        symmetric_matrix<U> other (m_n, storage);
+        U* dst = other.mutable_data();
+        for (size_t ii = 0; ii < m_n; ii++)
+            for (size_t jj = (storage == symmetric_matrix<U>::dense ? 0 : ii); jj < m_n; jj++)
+                *dst++ = static_cast<U>((*this)(ii, jj));
+        return other;
+    }
+
+    bool operator== (const symmetric_matrix& other) const
+    {
+        if (m_n != other.m_n) return false;
+        if (m_data == other.m_data) return true;
+        for (size_t ii = 0; ii < m_n; ii++)
+            for (size_t jj = ii; jj < m_n; jj++)
+                if ((*this)(ii, jj) != other(ii, jj)) return false;
+        return true;
+    }
+
+private:
+    static size_t element_count (size_t n, storage_t storage)
+    {
+        return storage == dense ? n * n : n * (n + 1) / 2;
+    }
+
+    size_t index (size_t ii, size_t jj) const
+    {
+        if (m_storage == dense) return ii * m_n + jj;
+        if (ii > jj) std::swap(ii, jj);
+        return ii * (2 * m_n - ii + 1) / 2 + (jj - ii);
+    }
+
+    void detach ()
+    {
+        if (m_data && m_data.use_count() > 1)
+            m_data = std::make_shared<std::vector<T>>(*m_data);
+    }
+
+    size_t m_n;
+    storage_t m_storage;
+    std::shared_ptr<std::vector<T>> m_data;
+};
+
+}
+
+#endif
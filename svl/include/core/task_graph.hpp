@@ -0,0 +1,150 @@
+#ifndef __SVL_TASK_GRAPH__
+#define __SVL_TASK_GRAPH__
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "core/thread_pool.hpp"
+
+namespace svl
+{
+
+/*
+ * task_graph - Tasks with dependencies, run on a thread_pool.
+ *
+ * A task is posted to the pool as soon as all the tasks it was added after are finished,
+ * by the thread finishing the last of them ( a continuation ), so independent chains run
+ * concurrently and nothing polls. A task returns false, or throws, to fail: its dependents
+ * are then skipped and fail too.
+ *
+ * Tasks are added before run(), which is called once. It waits for the whole graph, running pool jobs on the
+ * calling thread meanwhile, and re-throws the first exception thrown by a task.
+ */
+class task_graph
+{
+public:
+    typedef size_t node_t;
+    typedef std::function<bool()> task_fn_t;
+
+    explicit task_graph (thread_pool& pool = thread_pool::global()) : m_pool(pool), m_remaining(0) {}
+
+    task_graph (const task_graph&) = delete;
+    task_graph& operator= (const task_graph&) = delete;
+
+    // Add a task to run after the tasks in after. Returns its node.
+    node_t add (task_fn_t fn, std::initializer_list<node_t> after = {})
+    {
+        return add(std::move(fn), std::vector<node_t>(after));
+    }
+
+    node_t add (task_fn_t fn, const std::vector<node_t>& after)
+    {
+        const node_t id = m_nodes.size();
+        m_nodes.emplace_back(new node(std::move(fn)));
+        for (node_t pp : after)
+        {
+            assert(pp < id);
+            m_nodes[pp]->successors.push_back(id);
+            m_nodes[id]->waiting++;
+        }
+        return id;
+    }
+
+    size_t size () const { return m_nodes.size(); }
+
+    // True if the task ran and returned true. Valid after run().
+    bool succeeded (node_t id) const { return m_nodes[id]->succeeded; }
+
+    // Run all tasks and wait for them. Returns true if all succeeded.
+    bool run ()
+    {
+        if (m_nodes.empty()) return true;
+        m_remaining = m_nodes.size();
+        // Roots are taken before any starts, a started root may already be releasing its successors
+        std::vector<node_t> roots;
+        for (node_t id = 0; id < m_nodes.size(); id++)
+            if (m_nodes[id]->waiting == 0) roots.push_back(id);
+        for (node_t id : roots) start(id);
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lk(m_mutex);
+                if (m_remaining == 0) break;
+            }
+            if (m_pool.try_run_one()) continue;
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_done.wait_for(lk, std::chrono::milliseconds(20), [this] () { return m_remaining == 0; });
+        }
+
+        if (m_error) std::rethrow_exception(m_error);
+        bool all = true;
+        for (const auto& nn : m_nodes) all = all && nn->succeeded;
+        return all;
+    }
+
+private:
+    struct node
+    {
+        explicit node (task_fn_t f) : fn(std::move(f)), waiting(0), skip(false), succeeded(false) {}
+        task_fn_t fn;
+        std::vector<node_t> successors;
+        std::atomic<size_t> waiting;   // unfinished predecessors
+        std::atomic<bool> skip;        // a predecessor failed
+        std::atomic<bool> succeeded;
+    };
+
+    void start (node_t id)
+    {
+        m_pool.post([this, id] () { execute(id); });
+    }
+
+    void execute (node_t id)
+    {
+        node& nn = *m_nodes[id];
+        bool ok = false;
+        if (! nn.skip)
+        {
+            try
+            {
+                ok = nn.fn();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lk(m_mutex);
+                if (! m_error) m_error = std::current_exception();
+            }
+        }
+        nn.succeeded = ok;
+
+        // Continuations: the last predecessor to finish starts the successor
+        for (node_t ss : nn.successors)
+        {
+            node& sn = *m_nodes[ss];
+            if (! ok) sn.skip = true;
+            if (--sn.waiting == 0) start(ss);
+        }
+
+        // Under the lock, run() can not return and destroy the graph before we are done with it
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (--m_remaining == 0) m_done.notify_all();
+    }
+
+    thread_pool& m_pool;
+    std::vector<std::unique_ptr<node>> m_nodes;
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    size_t m_remaining;
+    std::exception_ptr m_error;
+};
+
+}
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef __SVL_THREAD_POOL__
+#define __SVL_THREAD_POOL__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "core/progress_fn.h"
+
+namespace svl
+{
+
+/*
+ * cancel_token - Shared cancellation flag. Copies share the flag, jobs posted with a token
+ * are dropped if it is cancelled before they start. Running jobs may poll cancelled().
+ */
+class cancel_token
+{
+public:
+    cancel_token () : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel () { *m_flag = true; }
+    bool cancelled () const { return *m_flag; }
+
+    // A token that is never cancelled
+    static const cancel_token& none ()
+    {
+        static const cancel_token token;
+        return token;
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+/*
+ * thread_pool - Work stealing pool of worker threads, the process wide executor.
+ *
+ * Every worker owns a deque of jobs per priority. Jobs posted from a worker go to the front
+ * of its own deque and are taken LIFO, keeping recently touched data warm. Idle workers
+ * steal from the back of the other deques. Jobs posted from outside the pool are
+ * distributed round robin. Higher priority jobs are always taken first.
+ *
+ * high jobs are the short pieces of parallel loops and task graphs. Threads waiting on pool
+ * work ( parallel_for ) help run pending high jobs, so nested use from inside a job does not
+ * deadlock. normal and low jobs are whole pipeline stages: they are only run by the workers'
+ * own loops, never nested inside a waiting job, and they must not block on other stage jobs.
+ */
+class thread_pool
+{
+public:
+    typedef std::function<void()> job_t;
+    enum class priority { high = 0, normal = 1, low = 2 };
+    static const size_t priority_count = 3;
+
+    explicit thread_pool (unsigned count = 0) : m_pending(0), m_next(0), m_done(false)
+    {
+        m_count = (count == 0) ? std::max(1u, std::thread::hardware_concurrency()) : count;
+        for (unsigned ii = 0; ii < m_count; ii++)
+            m_queues.emplace_back(new worker_queue());
+        m_threads.reserve(m_count);
+        for (unsigned ii = 0; ii < m_count; ii++)
+            m_threads.emplace_back(&thread_pool::worker_loop, this, ii);
+    }
+
+    ~thread_pool ()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_wake_mutex);
+            m_done = true;
+        }
+        m_wake.notify_all();
+        for (auto& tt : m_threads)
+            if (tt.joinable()) tt.join();
+    }
+
+    thread_pool (const thread_pool&) = delete;
+    thread_pool& operator= (const thread_pool&) = delete;
+
+    // Process wide pool sized to the hardware
+    static thread_pool& global ()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    unsigned size () const { return m_count; }
+
+    // True if the calling thread is one of this pool's workers
+    bool in_pool () const { return tls_pool() == this; }
+
+    void post (job_t job, priority pri = priority::high)
+    {
+        const bool local = in_pool();
+        const unsigned qi = local ? tls_index() : (m_next++ % size());
+        auto& jobs = m_queues[qi]->jobs[static_cast<size_t>(pri)];
+        // Count before the job becomes visible so pending never goes below the queued jobs
+        m_pending++;
+        {
+            std::lock_guard<std::mutex> lk(m_queues[qi]->mutex);
+            if (local) jobs.push_front(std::move(job));
+            else jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_wake_mutex);
+        }
+        m_wake.notify_one();
+    }
+
+    // Dropped without running if token is cancelled before the job starts
+    void post (job_t job, priority pri, const cancel_token& token)
+    {
+        post([job, token] () { if (! token.cancelled()) job(); }, pri);
+    }
+
+    // The future of a job dropped by cancellation throws std::future_error ( broken_promise )
+    template<typename F>
+    auto submit (F&& fn, priority pri = priority::high, const cancel_token& token = cancel_token::none()) -> std::future<decltype(fn())>
+    {
+        typedef decltype(fn()) result_t;
+        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(fn));
+        std::future<result_t> res = task->get_future();
+        post([task, token] () { if (! token.cancelled()) (*task)(); }, pri);
+        return res;
+    }
+
+    // Run one pending high priority job on the calling thread. Returns false if there was none.
+    bool try_run_one ()
+    {
+        job_t job;
+        if (! pop(in_pool() ? tls_index() : 0, job, priority::high)) return false;
+        m_pending--;
+        job();
+        return true;
+    }
+
+    /*
+     * parallel_for - Run fn(i) for i in [0, count) on the pool and wait for all of them.
+     * The calling thread helps running jobs while waiting. If progress is given it is called
+     * from the calling thread with the fraction of completed iterations. The first exception
+     * thrown by fn is re-thrown here after all iterations are finished. Once token is cancelled
+     * the iterations not yet started are skipped.
+     */
+    template<typename F>
+    void parallel_for (size_t count, F&& fn, const progress_fn_t& progress = nullptr,
+                       const cancel_token& token = cancel_token::none())
+    {
+        if (count == 0) return;
+
+        struct group_state
+        {
+            std::atomic<size_t> done;
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::exception_ptr error;
+            group_state () : done(0) {}
+        };
+        auto state = std::make_shared<group_state>();
+
+        for (size_t ii = 0; ii < count; ii++)
+        {
+            post([state, ii, &fn, &token] () {
+                try
+                {
+                    if (! token.cancelled()) fn(ii);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lk(state->mutex);
+                    if (! state->error) state->error = std::current_exception();
+                }
+                state->done++;
+                {
+                    std::lock_guard<std::mutex> lk(state->mutex);
+                }
+                state->cv.notify_all();
+            });
+        }
+
+        size_t reported = 0;
+        while (true)
+        {
+            const size_t done = state->done;
+            if (progress && done != reported)
+            {
+                progress(float(done) / count);
+                reported = done;
+            }
+            if (done == count) break;
+            if (try_run_one()) continue;
+            std::unique_lock<std::mutex> lk(state->mutex);
+            state->cv.wait_for(lk, std::chrono::milliseconds(20), [&state, done] () { return state->done != done; });
+        }
+
+        if (state->error) std::rethrow_exception(state->error);
+    }
+
+private:
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<job_t> jobs[priority_count];
+    };
+
+    static thread_pool*& tls_pool ()
+    {
+        static thread_local thread_pool* pool = nullptr;
+        return pool;
+    }
+
+    static unsigned& tls_index ()
+    {
+        static thread_local unsigned index = 0;
+        return index;
+    }
+
+    // By priority, down to lowest: own queue from the front, otherwise steal from the back of the others
+    bool pop (unsigned self, job_t& job, priority lowest = priority::low)
+    {
+        const unsigned count = size();
+        for (size_t pp = 0; pp <= static_cast<size_t>(lowest); pp++)
+            for (unsigned kk = 0; kk < count; kk++)
+            {
+                auto& queue = *m_queues[(self + kk) % count];
+                std::lock_guard<std::mutex> lk(queue.mutex);
+                auto& jobs = queue.jobs[pp];
+                if (jobs.empty()) continue;
+                if (kk == 0)
+                {
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                else
+                {
+                    job = std::move(jobs.back());
+                    jobs.pop_back();
+                }
+                return true;
+            }
+        return false;
+    }
+
+    void worker_loop (unsigned index)
+    {
+        tls_pool() = this;
+        tls_index() = index;
+        while (true)
+        {
+            job_t job;
+            if (pop(index, job))
+            {
+                m_pending--;
+                job();
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(m_wake_mutex);
+            m_wake.wait(lk, [this] () { return m_done || m_pending > 0; });
+            if (m_done && m_pending == 0) return;
+        }
+    }
+
+    unsigned m_count;
+    std::vector<std::unique_ptr<worker_queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake;
+    std::atomic<size_t> m_pending;
+    std::atomic<unsigned> m_next;
+    bool m_done;
+};
+
+}
+
+#endif
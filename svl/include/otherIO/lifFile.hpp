@@ -32,6 +32,8 @@
 #include <map>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <boost/utility.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -44,12 +46,92 @@ namespace lifIO
     struct DimensionData;
     struct ScannerSettingRecord;
     struct FilterSettingRecord;
+    
+    /**
+     \brief Read only memory map of a whole lif file.
+     Series of a mapped LifReader and the views they hand out share it, the mapping
+     lives as long as any of them.
+     */
+    class LifMappedFile : boost::noncopyable
+    {
+    public:
+        typedef std::shared_ptr<const LifMappedFile> ref;
+        
+        // Returns nullptr if the file can not be mapped
+        static ref map (const std::string& filename);
+        ~LifMappedFile();
+        
+        const uint8_t* data () const { return m_data; }
+        size_t size () const { return m_size; }
+        
+        // Hint that the range will be read soon
+        void will_need (unsigned long long offset, unsigned long long length) const;
+        
+    private:
+        LifMappedFile () : m_data(nullptr), m_size(0) {}
+        const uint8_t* m_data;
+        size_t m_size;
+    };
+    
+    /**
+     \brief Read only file descriptor for positional reads.
+     pread does not move a shared file position, so any number of threads can read
+     through one descriptor at the same time.
+     */
+    class LifPositionalFile : boost::noncopyable
+    {
+    public:
+        typedef std::shared_ptr<const LifPositionalFile> ref;
+        
+        // Returns nullptr if the file can not be opened
+        static ref open (const std::string& filename);
+        ~LifPositionalFile();
+        
+        // Read exactly length bytes at offset. Throws std::runtime_error on failure or short file
+        void read (void* buffer, unsigned long long offset, size_t length) const;
+        
+        // Hint that the range will be read soon
+        void will_need (unsigned long long offset, unsigned long long length) const;
+        
+    private:
+        LifPositionalFile () : m_fd(-1) {}
+        int m_fd;
+    };
+    
+    /**
+     \brief One channel of one slice inside a mapped file.
+     Pixels are pixel_bytes apart and rows row_bytes apart. For planar channels
+     pixel_bytes equals sample_bytes, the pixel size, interleaved channels are strided.
+     See vision/lif_views.hpp for roiWindow and cv::Mat wrappers.
+     */
+    struct LifPlaneView
+    {
+        const uint8_t* data;
+        uint32_t width;
+        uint32_t height;
+        size_t row_bytes;
+        size_t pixel_bytes;
+        size_t sample_bytes;
+        LifMappedFile::ref mapping;
+        
+        LifPlaneView () : data(nullptr), width(0), height(0), row_bytes(0), pixel_bytes(0), sample_bytes(0) {}
+        bool valid () const { return data != nullptr; }
+        bool planar () const { return pixel_bytes == sample_bytes; }
+        const uint8_t* row (uint32_t y) const { return data + y * row_bytes; }
+    };
 
+    /**
+     \brief Serie description.
+     Only the name is read when constructed from XML. The Image element, with dimensions,
+     channels, time stamps and scanner settings, is parsed on first use. The XML document
+     has to outlive the header until then ( LifReader keeps it ).
+     */
     class LifSerieHeader
     {
         
     public:
         explicit LifSerieHeader(TiXmlElement *root);
+        LifSerieHeader(const LifSerieHeader&);
         
         typedef unsigned long long timestamp_t;
         
@@ -62,12 +144,13 @@ namespace lifIO
         size_t getNbPixelsInOneSlice() const;
         double getZXratio() const;
         bool hasTimeChannel () const;
-        const std::map<std::string, DimensionData>& getDimensionsData() const {return dimensions;};
-        const std::vector<ChannelData>& getChannels() const {return channels;};
-        const std::vector<timestamp_t>& getTimestamps () const { return timeStamps; }
-        const std::vector<timestamp_t>& getDurations () const { return m_frame_durations; }
+        const std::map<std::string, DimensionData>& getDimensionsData() const {parse(); return dimensions;};
+        const std::vector<ChannelData>& getChannels() const {parse(); return channels;};
+        const std::vector<timestamp_t>& getTimestamps () const { parse(); return timeStamps; }
+        const std::vector<timestamp_t>& getDurations () const { parse(); return m_frame_durations; }
         float total_duration () const
         {
+            parse();
             if (timeStamps.size() < 2) return -1.0f;
             auto timeL = (timeStamps.end() - timeStamps.begin()) / 10000.0;
             if (std::signbit(timeL)) return -1.0f;
@@ -77,44 +160,89 @@ namespace lifIO
         float frame_duration_ms () const;
         float frame_rate () const { if (frame_duration_ms() > 0.0) return 1000.0/frame_duration_ms ();return -1.0; }
         
+        // Header index ( see LifReader ) serialization
+        void writeIndex(std::ostream&) const;
+        static std::unique_ptr<LifSerieHeader> readIndex(std::istream&);
+        
     protected:
+        LifSerieHeader() : rootElement(nullptr), m_parsed(true) {}
+        
+        // Parse the Image element once, safe to call from any thread
+        void parse() const;
+        
         std::string name;
-        std::map<std::string, DimensionData> dimensions;
-        std::vector<ChannelData> channels;
-        std::vector<timestamp_t> timeStamps;
-        std::map<std::string, ScannerSettingRecord> scannerSettings;
+        mutable std::map<std::string, DimensionData> dimensions;
+        mutable std::vector<ChannelData> channels;
+        mutable std::vector<timestamp_t> timeStamps;
+        mutable std::map<std::string, ScannerSettingRecord> scannerSettings;
         TiXmlElement *rootElement;
         
         mutable std::vector<timestamp_t> m_frame_durations;
         mutable std::pair<bool, float> m_cached_frame_duration;
         
     private:
-        void parseImage(TiXmlNode *elementImage);
-        void parseImageDescription(TiXmlNode *elementImageDescription);
-        void parseTimeStampList(TiXmlNode *elementTimeStampList);
-        void parseHardwareSettingList(TiXmlNode *elementHardwareSettingList);
-        void parseScannerSetting(TiXmlNode *elementScannerSetting);
+        void parseImage(TiXmlNode *elementImage) const;
+        void parseImageDescription(TiXmlNode *elementImageDescription) const;
+        void parseTimeStampList(TiXmlNode *elementTimeStampList) const;
+        void parseHardwareSettingList(TiXmlNode *elementHardwareSettingList) const;
+        void parseScannerSetting(TiXmlNode *elementScannerSetting) const;
+        void setDurations() const;
         
+        mutable std::atomic<bool> m_parsed;
+        mutable std::mutex m_parse_mutex;
     };
     
     class LifSerie : public LifSerieHeader, boost::noncopyable
     {
         
     public:
-        explicit LifSerie(LifSerieHeader serie, const std::string &filename, unsigned long long offset, unsigned long long memorySize);
+        /**
+         fileSize of 0 is taken from the file. The serie's own stream is only opened by begin and tellg.
+         */
+        explicit LifSerie(LifSerieHeader serie, const std::string &filename, unsigned long long offset, unsigned long long memorySize,
+                          unsigned long long fileSize = 0);
         
+        /**
+         fill*Buffer and fill_range use positional reads ( or the mapping ) and are safe
+         to call concurrently on one serie and across series of one reader.
+         begin and tellg share a stream and are not.
+         */
         void fill3DBuffer(void* buffer, size_t t=0) const;
         void fill2DBuffer(void* buffer, size_t t=0, size_t z=0) const;
         
+        /**
+         Slice z of time steps [t0, t1) in to buffers[0 .. t1 - t0), each laid out as fill2DBuffer.
+         The whole range is announced to the OS before reading.
+         */
+        void fill_range(size_t t0, size_t t1, const std::vector<void*>& buffers, size_t z=0) const;
+        
+        /**
+         Zero copy access, only for series of a mapped LifReader.
+         mappedSlice points at all channels of slice z of time step t, as fill2DBuffer lays them out.
+         channelView is channel c of that slice. Both are invalid if the serie is not mapped.
+         */
+        bool isMapped () const { return (bool) m_mapping; }
+        const uint8_t* mappedSlice (size_t t=0, size_t z=0) const;
+        LifPlaneView channelView (size_t channel, size_t t=0, size_t z=0) const;
+        void setMapping (const LifMappedFile::ref& mapping) { m_mapping = mapping; }
+        void setPositionalFile (const LifPositionalFile::ref& pfile) { m_pfile = pfile; }
         
         std::istreambuf_iterator<char> begin(size_t t=0);
-        std::streampos tellg(){return fileRef->tellg();}
+        std::streampos tellg(){return stream()->tellg();}
         unsigned long long getOffset(size_t t=0) const;
+        unsigned long long getMemorySize() const { return memorySize; }
     private:
+        unsigned long long sliceOffset (size_t t, size_t z) const;
+        const std::shared_ptr<std::ifstream>& stream () const;
         unsigned long long offset;
         unsigned long long memorySize;
-        std::shared_ptr<std::ifstream> fileRef;
+        std::string m_filename;
+        mutable std::shared_ptr<std::ifstream> fileRef;
         std::streampos fileSize;
+        LifMappedFile::ref m_mapping;
+        LifPositionalFile::ref m_pfile;
+        
+        void read_at (void* buffer, unsigned long long pos, size_t length) const;
     };
     
     class LifHeader : boost::noncopyable
@@ -124,6 +252,10 @@ namespace lifIO
         explicit LifHeader(TiXmlDocument &);
         explicit LifHeader(std::string &);
         
+        // Header index ( see LifReader ) serialization. An indexed header has an empty XML document.
+        void writeIndex(std::ostream&) const;
+        static std::shared_ptr<LifHeader> readIndex(std::istream&);
+        
         const TiXmlDocument& getXMLHeader() const{return this->m_xmldoc;};
         std::string getName() const {return this->name;};
         const int& getVersion() const {return this->lifVersion;};
@@ -134,6 +266,7 @@ namespace lifIO
         
         
     protected:
+        LifHeader() : lifVersion(0) {}
         TiXmlDocument m_xmldoc;
         std::vector<std::unique_ptr<LifSerieHeader>> m_series;
         
@@ -151,12 +284,29 @@ namespace lifIO
         typedef std::shared_ptr<LifReader> ref;
         typedef std::weak_ptr<LifReader> weak_ref_t;
         
-        static LifReader::ref create (const std::string&  fqfn_path){
-            return LifReader::ref ( new LifReader (fqfn_path));
+        /**
+         mapped: map the file and serve frames from the mapping, see LifSerie::channelView.
+         Falls back to stream reads if the file can not be mapped.
+         indexed: use the header index next to the file, see index_path, if it matches the file's
+         size and modification time. Otherwise parse the file and write the index.
+         */
+        static LifReader::ref create (const std::string&  fqfn_path, bool mapped = false, bool indexed = false){
+            return LifReader::ref ( new LifReader (fqfn_path, mapped, indexed));
         }
         
+        /**
+         Header index file for a lif file: offsets, dimensions, channels, time stamps and
+         scanner settings of every serie, keyed by the lif file's size and modification time.
+         */
+        static std::string index_path (const std::string& fqfn_path) { return fqfn_path + ".index"; }
+        bool fromIndex () const { return m_from_index; }
+        
         const LifHeader& getLifHeader() const {return *this->m_header;};
-        const TiXmlDocument& getXMLHeader() const{return getLifHeader().getXMLHeader();};
+        /**
+         The file's XML header. A reader built from the index reads it from the file on first
+         call, and returns an empty document if that fails.
+         */
+        const TiXmlDocument& getXMLHeader() const;
         std::string getName() const {return getLifHeader().getName();};
         const int& getVersion() const {return getLifHeader().getVersion();};
         size_t getNbSeries() const {return this->m_series.size();}
@@ -169,6 +319,7 @@ namespace lifIO
         
         void close_file ();
         bool isValid () const { return m_Valid; }
+        bool isMapped () const { return (bool) m_mapping; }
         
     private:
         /**
@@ -178,7 +329,10 @@ namespace lifIO
          */
   
         // @todo move ctor to private
-        LifReader(const std::string &filename);
+        LifReader(const std::string &filename, bool mapped = false, bool indexed = false);
+        void readFile(const std::string &filename);
+        bool readIndex(const std::string &filename);
+        void writeIndex(const std::string &filename) const;
         int readInt();
         unsigned int readUnsignedInt();
         unsigned long long readUnsignedLongLong();
@@ -190,6 +344,10 @@ namespace lifIO
         mutable std::mutex m_mutex;
         std::string m_path;
         size_t m_lif_file_size;
+        LifMappedFile::ref m_mapping;
+        LifPositionalFile::ref m_pfile;
+        bool m_from_index;
+        mutable std::unique_ptr<TiXmlDocument> m_index_xmldoc;
     };
     
     
@@ -208,6 +366,7 @@ namespace lifIO
         unsigned long long bytesInc; // Distance from the first channel in Bytes
         int bitInc;
         
+        ChannelData() {}
         explicit ChannelData(TiXmlElement *element);
         inline const std::string getName() const
         {
@@ -240,6 +399,7 @@ namespace lifIO
         unsigned long long bytesInc; // Distance from the one element to the next in this dimension
         int bitInc;
         
+        DimensionData() {}
         explicit DimensionData(TiXmlElement *element);
         inline const std::string getName() const
         {
@@ -278,6 +438,7 @@ namespace lifIO
         std::string variant;
         int variantType;
         
+        ScannerSettingRecord() {}
         explicit ScannerSettingRecord(TiXmlElement *element);
     };
     
@@ -9,11 +9,113 @@
 #define correlation1d_h
 
 #include <iterator>
+#include <complex>
+#include <vector>
 #include "core/fit.hpp"
 #include "core/stats.hpp"
 #include "core/core.hpp"
 
 namespace svl{
+
+// Signals of at least this many samples use the FFT paths of f1dAutoCorr and f1dRegister
+const size_t f1dFFTThreshold = 256;
+
+namespace f1d_fft
+{
+    typedef std::complex<double> complex_t;
+    
+    inline size_t pow2_at_least (size_t n)
+    {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+    
+    // In place iterative radix 2 FFT, a.size() a power of 2. The inverse is not scaled.
+    inline void fft (std::vector<complex_t>& a, bool inverse)
+    {
+        const size_t n = a.size();
+        for (size_t i = 1, j = 0; i < n; i++)
+        {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(a[i], a[j]);
+        }
+        for (size_t len = 2; len <= n; len <<= 1)
+        {
+            const double ang = 2.0 * svl::constants::pi / len * (inverse ? 1.0 : -1.0);
+            const complex_t wl (std::cos(ang), std::sin(ang));
+            for (size_t i = 0; i < n; i += len)
+            {
+                complex_t w (1.0, 0.0);
+                for (size_t j = 0; j < len / 2; j++)
+                {
+                    const complex_t u = a[i + j];
+                    const complex_t v = a[i + j + len / 2] * w;
+                    a[i + j] = u + v;
+                    a[i + j + len / 2] = u - v;
+                    w *= wl;
+                }
+            }
+        }
+    }
+    
+    /*
+     * Linear cross correlation by Wiener-Khinchin. On return, for 0 <= k < x.size() and y.size(),
+     * right[k] = sum_j x[j + k] y[j] and left[k] = sum_j x[j] y[j + k]. Pass the same vector as
+     * x and y for the autocorrelation, which takes a single forward transform.
+     */
+    inline void cross_correlation (const std::vector<double>& x, const std::vector<double>& y,
+                                   std::vector<double>& right, std::vector<double>& left)
+    {
+        const size_t n = pow2_at_least(x.size() + y.size());
+        std::vector<complex_t> fx (n), fy;
+        std::copy(x.begin(), x.end(), fx.begin());
+        fft(fx, false);
+        const bool autoc = &x == &y;
+        if (! autoc)
+        {
+            fy.resize(n);
+            std::copy(y.begin(), y.end(), fy.begin());
+            fft(fy, false);
+        }
+        for (size_t k = 0; k < n; k++)
+            fx[k] *= std::conj(autoc ? fx[k] : fy[k]);
+        fft(fx, true);
+        
+        right.resize(x.size());
+        left.resize(y.size());
+        for (size_t k = 0; k < right.size(); k++) right[k] = fx[k].real() / n;
+        left[0] = right[0];
+        for (size_t k = 1; k < left.size(); k++) left[k] = fx[n - k].real() / n;
+    }
+    
+    // The normalized correlation of f1dNormalizedCorr from sums over count samples
+    inline double normalized (double count, double si, double sm, double sii, double smm, double sim)
+    {
+        double cross = ((count * sim) - (si * sm));
+        double energy = ((count * sii) - (si * si)) * ((count * smm) - (sm * sm));
+        return energy != 0. ? (cross * cross) / energy : 0.;
+    }
+    
+    // Copy to doubles, less the mean if centre. The normalized correlation does not change with
+    // an offset, and the sums it takes from prefix sums are better conditioned about zero.
+    template <class Iterator>
+    std::vector<double> to_double (Iterator b, Iterator e, bool centre)
+    {
+        std::vector<double> x (b, e);
+        if (centre && ! x.empty())
+        {
+            double mean = 0;
+            for (double v : x) mean += v;
+            mean /= x.size();
+            for (double& v : x) v -= mean;
+        }
+        return x;
+    }
+}
+
 // 1D correlation: Normalized Correlation
 //
 template <class Iterator>
@@ -85,15 +187,15 @@ double f1dCrossCorr (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me)
 }
 
 
-// 1D auto-correlation: Normalized Correlation
+// 1D auto-correlation: Normalized Correlation, direct O(n^2) path. Lags are circular.
 //
 template <class Iterator>
-void f1dAutoCorr (Iterator Ib, Iterator Ie, Iterator acb, bool op = true)
+void f1dAutoCorrDirect (Iterator Ib, Iterator Ie, Iterator acb, bool op = true)
 {
     // Get container value type
     typedef typename std::iterator_traits<Iterator>::value_type value_type;
     
-    int32_t n = distance (Ib, Ie);
+    int32_t n = std::distance (Ib, Ie);
     vector<value_type> ring (n + n);
     Iterator ip = Ib;
     int32_t i;
@@ -117,7 +219,7 @@ void f1dAutoCorr (Iterator Ib, Iterator Ie, Iterator acb, bool op = true)
 }
 
 template <class Iterator>
-void f1dAutoCorr (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
+void f1dAutoCorrDirect (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
 {
     // Get container value type
     typedef typename std::iterator_traits<Iterator>::value_type value_type;
@@ -146,36 +248,137 @@ void f1dAutoCorr (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
     }
 }
 
-// 1D Signal Registration:
-// @function f1dRegister
-// @description return best registration point of sliding model represented by Mb/Me on Ib/Ie
-// Slide has to be greater or equal to 1. Mb is lined up with (Ib+slide) with 0 passed in for
-// slide number of bins on the other end (and reduced count in calculation of correlation). Similarly
-// (Mb+slide) is matched with Ib with first slide model bins treated as 0s and reduction of count accordingly
-// @todo: constant time implementation
+// 1D auto-correlation: FFT path, same results as f1dAutoCorrDirect
+// The circular lag k is the linear autocorrelation at k plus that at n - k. The normalized
+// correlation of a signal with a circular shift of itself has the same sums and sums of
+// squares on both sides, so only the cross term depends on the lag.
+template <class Iterator, class OutIterator>
+void f1dAutoCorrFFT (Iterator Ib, Iterator Ie, OutIterator cp, bool op = true)
+{
+    typedef typename std::iterator_traits<OutIterator>::value_type out_type;
+    
+    const std::vector<double> x = f1d_fft::to_double(Ib, Ie, op);
+    const size_t n = x.size();
+    if (n == 0) return;
+    std::vector<double> lin, unused;
+    f1d_fft::cross_correlation(x, x, lin, unused);
+    
+    double s (0.0), ss (0.0);
+    for (double v : x) { s += v; ss += v * v; }
+    
+    for (size_t k = 0; k < n; k++)
+    {
+        const double sim = lin[k] + (k ? lin[n - k] : 0.0);
+        *cp++ = static_cast<out_type>(op ? f1d_fft::normalized(n, s, s, ss, ss, sim) : sim);
+    }
+}
 
+// 1D auto-correlation: FFT path for signals of f1dFFTThreshold samples or more, direct otherwise
 template <class Iterator>
-double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me, uint32_t slide, double& pose)
+void f1dAutoCorr (Iterator Ib, Iterator Ie, Iterator acb, bool op = true)
 {
-    
-    assert (slide >= 1);
-    vector<double> space (slide + slide + 1);
-    vector<double>::iterator orgItr = space.begin() + slide;
+    if (static_cast<size_t>(std::distance(Ib, Ie)) >= f1dFFTThreshold)
+        f1dAutoCorrFFT(Ib, Ie, acb, op);
+    else
+        f1dAutoCorrDirect(Ib, Ie, acb, op);
+}
+
+template <class Iterator>
+void f1dAutoCorr (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
+{
+    const size_t n = std::distance(Ib, Ie);
+    if (n >= f1dFFTThreshold)
+    {
+        acb.resize(n);
+        f1dAutoCorrFFT(Ib, Ie, acb.begin(), op);
+    }
+    else
+        f1dAutoCorrDirect(Ib, Ie, acb, op);
+}
+
+// 1D sliding normalized correlation for f1dRegister. space has slideLeft + slideRight + 1 entries,
+// space[slideRight - i] for Ib + i against Mb and space[slideRight + i] for Ib against Mb + i.
+template <class Iterator>
+void f1dSlideDirect (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me,
+                     uint32_t slideLeft, uint32_t slideRight, vector<double>& space)
+{
+    space.resize(slideLeft + slideRight + 1);
+    vector<double>::iterator orgItr = space.begin() + slideRight;
     vector<double>::iterator slidItr;
     
     // Sliding I to the right
     slidItr = orgItr;
-    for (uint32_t i = 0; i < (slide + 1); i++)
+    for (uint32_t i = 0; i < (slideRight + 1); i++)
     {
         *slidItr-- = f1dNormalizedCorr (Ib + i, Ie, Mb, Me - i);
     }
     
     // Sliding I to the left (orgin already done)
     slidItr = orgItr+1;
-    for (uint32_t i = 1; i < (slide + 1); i++)
+    for (uint32_t i = 1; i < (slideLeft + 1); i++)
     {
         *slidItr++ = f1dNormalizedCorr (Ib, Ie - i, Mb + i, Me);
     }
+}
+
+// FFT path of f1dSlideDirect: cross terms of all shifts from one cross correlation, the other
+// sums over each overlap from prefix sums.
+template <class Iterator>
+void f1dSlideFFT (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me,
+                  uint32_t slideLeft, uint32_t slideRight, vector<double>& space)
+{
+    const std::vector<double> x = f1d_fft::to_double(Ib, Ie, true);
+    const std::vector<double> y = f1d_fft::to_double(Mb, Me, true);
+    const size_t n = x.size();
+    assert (n && y.size() == n);
+    assert (slideLeft < n && slideRight < n);
+    std::vector<double> right, left;
+    f1d_fft::cross_correlation(x, y, right, left);
+    
+    std::vector<double> px (n + 1, 0.0), pxx (n + 1, 0.0), py (n + 1, 0.0), pyy (n + 1, 0.0);
+    for (size_t k = 0; k < n; k++)
+    {
+        px[k + 1] = px[k] + x[k];
+        pxx[k + 1] = pxx[k] + x[k] * x[k];
+        py[k + 1] = py[k] + y[k];
+        pyy[k + 1] = pyy[k] + y[k] * y[k];
+    }
+    
+    space.resize(slideLeft + slideRight + 1);
+    for (uint32_t i = 0; i < (slideRight + 1); i++)
+        space[slideRight - i] = f1d_fft::normalized(n - i, px[n] - px[i], py[n - i], pxx[n] - pxx[i], pyy[n - i], right[i]);
+    for (uint32_t i = 1; i < (slideLeft + 1); i++)
+        space[slideRight + i] = f1d_fft::normalized(n - i, px[n - i], py[n] - py[i], pxx[n - i], pyy[n] - pyy[i], left[i]);
+}
+
+// FFT path when the signal is long and the search wide enough to amortize the transforms
+template <class Iterator>
+void f1dSlide (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me,
+               uint32_t slideLeft, uint32_t slideRight, vector<double>& space)
+{
+    const size_t n = std::distance(Ib, Ie);
+    const size_t log2n = std::log2(f1d_fft::pow2_at_least(n + n));
+    if (n >= f1dFFTThreshold && (slideLeft + slideRight + 1) > 4 * log2n)
+        f1dSlideFFT(Ib, Ie, Mb, Me, slideLeft, slideRight, space);
+    else
+        f1dSlideDirect(Ib, Ie, Mb, Me, slideLeft, slideRight, space);
+}
+
+// 1D Signal Registration:
+// @function f1dRegister
+// @description return best registration point of sliding model represented by Mb/Me on Ib/Ie
+// Slide has to be greater or equal to 1. Mb is lined up with (Ib+slide) with 0 passed in for
+// slide number of bins on the other end (and reduced count in calculation of correlation). Similarly
+// (Mb+slide) is matched with Ib with first slide model bins treated as 0s and reduction of count accordingly
+// Long signals with wide searches take the FFT path, see f1dSlide
+
+template <class Iterator>
+double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me, uint32_t slide, double& pose)
+{
+    
+    assert (slide >= 1);
+    vector<double> space;
+    f1dSlide (Ib, Ie, Mb, Me, slide, slide, space);
     
     vector<double>::iterator endd = space.end();
     advance (endd, -1); // The last guy
@@ -209,23 +412,8 @@ double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me, uint32_t
 {
     
     assert (slide >= 1);
-    vector<double> space (slide + slide + 1);
-    vector<double>::iterator orgItr = space.begin() + slide;
-    vector<double>::iterator slidItr;
-    
-    // Sliding I to the right
-    slidItr = orgItr;
-    for (uint32_t i = 0; i < (slide + 1); i++)
-    {
-        *slidItr-- = f1dNormalizedCorr (Ib + i, Ie, Mb, Me - i);
-    }
-    
-    // Sliding I to the left (orgin already done)
-    slidItr = orgItr+1;
-    for (uint32_t i = 1; i < (slide + 1); i++)
-    {
-        *slidItr++ = f1dNormalizedCorr (Ib, Ie - i, Mb + i, Me);
-    }
+    vector<double> space;
+    f1dSlide (Ib, Ie, Mb, Me, slide, slide, space);
     
     vector<double>::iterator endd = space.end();
     advance (endd, -1); // The last guy
@@ -269,23 +457,8 @@ double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me,
 {
     uint32_t slide = slideLeft + slideRight;
     assert (slide >= 1);
-    vector<double> space (slideLeft + slideRight + 1);
-    vector<double>::iterator orgItr = space.begin() + slideRight;
-    vector<double>::iterator slidItr;
-    
-    // Sliding I to the right
-    slidItr = orgItr;
-    for (auto i = 0; i < (slideRight + 1); i++)
-    {
-        *slidItr-- = f1dNormalizedCorr (Ib + i, Ie, Mb, Me - i);
-    }
-    
-    // Sliding I to the left (orgin already done)
-    slidItr = orgItr+1;
-    for (auto i = 1; i < (slideLeft + 1); i++)
-    {
-        *slidItr++ = f1dNormalizedCorr (Ib, Ie - i, Mb + i, Me);
-    }
+    vector<double> space;
+    f1dSlide (Ib, Ie, Mb, Me, slideLeft, slideRight, space);
     
     vector<double>::iterator endd = space.end();
     advance (endd, -1); // The last guy
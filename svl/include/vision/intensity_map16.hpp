@@ -0,0 +1,111 @@
+#ifndef __SVL_INTENSITY_MAP16__
+#define __SVL_INTENSITY_MAP16__
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "vision/roiWindow.h"
+
+namespace svl
+{
+
+/*
+ * intensity_map16 - One volume wide mapping of 16 bit intensities to 8 bit.
+ *
+ * [lo, hi] of the whole volume maps linearly to [0, 255], values outside are clamped. Every frame
+ * goes through the same table, so equal 16 bit values are equal 8 bit values in all frames, unlike
+ * per frame min max normalization. The 65536 entry table is shared by copies.
+ *
+ * An empty map ( default constructed ) has no table, valid() is false.
+ */
+class intensity_map16
+{
+public:
+    intensity_map16 () : m_lo(0), m_hi(0) {}
+
+    intensity_map16 (uint16_t lo, uint16_t hi) : m_lo(std::min(lo, hi)), m_hi(std::max(lo, hi))
+    {
+        m_table = std::make_shared<std::vector<uint8_t>>(size_t(std::numeric_limits<uint16_t>::max()) + 1);
+        std::vector<uint8_t>& table = *m_table;
+        // A flat volume maps to 0
+        const double scale = m_hi > m_lo ? 255.0 / (m_hi - m_lo) : 0.0;
+        for (size_t vv = 0; vv < table.size(); vv++)
+        {
+            const double mapped = (double(std::min(std::max(uint16_t(vv), m_lo), m_hi)) - m_lo) * scale;
+            table[vv] = static_cast<uint8_t>(std::lround(mapped));
+        }
+    }
+
+    // (min, max) of a set of 16 bit windows, (65535, 0) if they are empty
+    template<typename Iterator>
+    static std::pair<uint16_t, uint16_t> range (Iterator first, Iterator last)
+    {
+        uint16_t lo = std::numeric_limits<uint16_t>::max();
+        uint16_t hi = 0;
+        for (; first != last; ++first)
+        {
+            const roiWindow<P16U>& rw = *first;
+            if (rw.width() <= 0) continue;
+            for (int32_t row = 0; row < rw.height(); row++)
+            {
+                const uint16_t* src = rw.rowPointer(row);
+                const auto mm = std::minmax_element(src, src + rw.width());
+                lo = std::min(lo, *mm.first);
+                hi = std::max(hi, *mm.second);
+            }
+        }
+        return std::make_pair(lo, hi);
+    }
+
+    template<typename Iterator>
+    static intensity_map16 from_range (Iterator first, Iterator last)
+    {
+        const auto mm = range(first, last);
+        return mm.first > mm.second ? intensity_map16() : intensity_map16(mm.first, mm.second);
+    }
+
+    bool valid () const { return bool(m_table); }
+    uint16_t lo () const { return m_lo; }
+    uint16_t hi () const { return m_hi; }
+
+    uint8_t operator() (uint16_t val) const
+    {
+        assert(valid());
+        return (*m_table)[val];
+    }
+
+    void map_row (const uint16_t* src, uint8_t* dst, size_t count) const
+    {
+        assert(valid());
+        const uint8_t* table = m_table->data();
+        for (size_t cc = 0; cc < count; cc++)
+            dst[cc] = table[src[cc]];
+    }
+
+    // dst must be of the size of src
+    void map (const roiWindow<P16U>& src, roiWindow<P8U>& dst) const
+    {
+        assert(src.width() == dst.width() && src.height() == dst.height());
+        for (int32_t row = 0; row < src.height(); row++)
+            map_row(src.rowPointer(row), dst.rowPointer(row), size_t(src.width()));
+    }
+
+    roiWindow<P8U> map (const roiWindow<P16U>& src) const
+    {
+        roiWindow<P8U> dst (src.width(), src.height());
+        map(src, dst);
+        return dst;
+    }
+
+private:
+    uint16_t m_lo, m_hi;
+    std::shared_ptr<std::vector<uint8_t>> m_table;
+};
+
+}
+
+#endif
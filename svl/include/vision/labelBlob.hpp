@@ -152,6 +152,7 @@ public:
         void update_moments (const cv::Mat& image) const;
         void update_contours (const cv::Mat& image) const;
         void update_points (const std::vector<cv::Point>& ) const;
+        void update_points (const cv::Point* first, const cv::Point* last) const;
         bool moments_ready () const { return m_moments_ready; }
         const cv::Rect2f& roi () const { return m_roi; }
         const svl::momento& moments () const { return m_moments; }
@@ -0,0 +1,126 @@
+#ifndef __LIF_FRAME_SOURCE__
+#define __LIF_FRAME_SOURCE__
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "core/frame_source.hpp"
+#include "otherIO/lifFile.hpp"
+#include "vision/roiWindow.h"
+
+namespace svl
+{
+
+/*
+ * lif_frame_source - Read ahead frame source over a LifSerie.
+ *
+ * A frame_source whose background thread reads time steps [t0, t1) in order, a few at a time
+ * with LifSerie::fill_range, into a bounded queue of at most window frames. Consumers
+ * take frames with next() as they arrive, so processing of the first frames overlaps
+ * reading of the following ones and at most window frames are held at any time.
+ *
+ * A frame holds all channels stacked vertically, channel c at rows [c * height, (c + 1) * height),
+ * the layout of fill2DBuffer. channel() returns the window of one channel. The frame's index
+ * is its time step. 8 bit series only.
+ */
+class lif_frame_source
+{
+public:
+    typedef roiWindow<P8U> frame_t;
+    typedef std::function<void(size_t, const frame_t&)> consumer_fn_t;
+
+    /*
+     * reader - keeps the reader alive while frames are read
+     * serie  - serie index in reader
+     * window - read ahead depth in frames
+     * t0, t1 - range of time steps, t1 = 0 reads to the end
+     */
+    lif_frame_source (const lifIO::LifReader::ref& reader, size_t serie, size_t window = 16, size_t t0 = 0, size_t t1 = 0)
+    : m_reader(reader)
+    {
+        if (! m_reader || serie >= m_reader->getNbSeries())
+            throw std::invalid_argument("No such serie");
+        m_serie = &m_reader->getSerie(serie);
+        for (const auto& cd : m_serie->getChannels())
+            if (cd.resolution > 8)
+                throw std::invalid_argument("Only 8 bit series are supported");
+
+        const std::vector<size_t> dims = m_serie->getSpatialDimensions();
+        m_width = static_cast<int32_t>(dims.size() > 0 ? dims[0] : 0);
+        m_height = static_cast<int32_t>(dims.size() > 1 ? dims[1] : 1);
+        m_channels = static_cast<int32_t>(m_serie->getChannels().size());
+        m_t0 = t0;
+        m_t1 = (t1 == 0 || t1 > m_serie->getNbTimeSteps()) ? m_serie->getNbTimeSteps() : t1;
+        if (m_width == 0 || m_channels == 0 || m_t0 > m_t1)
+            throw std::invalid_argument("Empty serie or range");
+
+        // Read in runs of a quarter window so the OS sees sequential ranges
+        m_source.reset(new frame_source<frame_t>([this] (size_t i0, size_t i1, std::vector<frame_t>& frames) {
+            read(i0, i1, frames);
+        }, m_t1 - m_t0, window));
+    }
+
+    lif_frame_source (const lif_frame_source&) = delete;
+    lif_frame_source& operator= (const lif_frame_source&) = delete;
+
+    int32_t width () const { return m_width; }
+    int32_t height () const { return m_height; }
+    int32_t channels () const { return m_channels; }
+    size_t frames () const { return m_t1 - m_t0; }
+
+    /*
+     * next - Block until the next frame is read. Returns false when all frames were
+     * delivered or the source was stopped. A read error is re-thrown here.
+     */
+    bool next (frame_t& frame)
+    {
+        size_t index;
+        return m_source->next(index, frame);
+    }
+
+    // Run consumer ( time step, frame ) on the calling thread for every frame. Returns the count.
+    size_t drain (const consumer_fn_t& consumer)
+    {
+        const size_t t0 = m_t0;
+        return m_source->drain([&consumer, t0] (size_t index, const frame_t& frame) { consumer(t0 + index, frame); });
+    }
+
+    // Window of channel c of frame
+    frame_t channel (const frame_t& frame, int32_t c) const
+    {
+        return frame_t(frame.frameBuf(), 0, c * m_height, m_width, m_height);
+    }
+
+    // Stop reading and release the reader thread. Frames already queued are dropped.
+    void stop ()
+    {
+        m_source->stop();
+    }
+
+private:
+    // Time steps [m_t0 + i0, m_t0 + i1), called from the reader thread
+    void read (size_t i0, size_t i1, std::vector<frame_t>& frames) const
+    {
+        std::vector<void*> buffers;
+        for (size_t ii = i0; ii < i1; ii++)
+        {
+            // Rows are contiguous, as fill2DBuffer writes them
+            frames.emplace_back(m_width, m_height * m_channels, align_first_row);
+            frames.back().frameBuf()->set_index(static_cast<int>(m_t0 + ii));
+            buffers.push_back(frames.back().rowPointer(0));
+        }
+        m_serie->fill_range(m_t0 + i0, m_t0 + i1, buffers);
+    }
+
+    lifIO::LifReader::ref m_reader;
+    const lifIO::LifSerie* m_serie;
+    int32_t m_width, m_height, m_channels;
+    size_t m_t0, m_t1;
+    // Last, its reader thread stops before the members it reads are gone
+    std::unique_ptr<frame_source<frame_t>> m_source;
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef __LIF_VIEWS__
+#define __LIF_VIEWS__
+
+#include <memory>
+#include "opencv2/core/core.hpp"
+#include "otherIO/lifFile.hpp"
+#include "vision/roiWindow.h"
+
+namespace svl
+{
+
+/*
+ * roiWindow and cv::Mat over a channel view of a mapped lif serie, without copying.
+ *
+ * Both hold the view's mapping, they stay valid after the reader and the view are gone.
+ * The mapping is read only: writing through them faults, clone them for a writable copy.
+ * Only planar channels ( LifPlaneView::planar ) can be wrapped, interleaved samples are not
+ * contiguous in a row.
+ */
+
+namespace lif_views_detail
+{
+    // Releases the mapping held in UMatData::userdata with the last cv::Mat sharing it
+    class mapping_allocator : public cv::MatAllocator
+    {
+    public:
+        cv::UMatData* allocate (int dims, const int* sizes, int type, void* data, size_t* step, int flags, cv::UMatUsageFlags usageFlags) const
+        {
+            return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        bool allocate (cv::UMatData* u, int accessflags, cv::UMatUsageFlags usageFlags) const
+        {
+            return cv::Mat::getStdAllocator()->allocate(u, accessflags, usageFlags);
+        }
+
+        void deallocate (cv::UMatData* u) const
+        {
+            if (! u) return;
+            delete static_cast<lifIO::LifMappedFile::ref*>(u->userdata);
+            u->userdata = nullptr;
+            delete u;
+        }
+
+        static mapping_allocator* instance ()
+        {
+            static mapping_allocator allocator;
+            return &allocator;
+        }
+    };
+}
+
+// Read only window over channel view, P's pixel size must be the view's sample size. Returns false if it can not be wrapped.
+template<typename P>
+bool lif_channel_window (const lifIO::LifPlaneView& view, roiWindow<P>& window)
+{
+    typedef typename PixelType<P>::pixel_t pixel_t;
+    if (! view.valid() || ! view.planar() || view.sample_bytes != sizeof(pixel_t)) return false;
+    auto rp = std::make_shared<root<P>>(view.mapping, const_cast<uint8_t*>(view.data), int32_t(view.row_bytes),
+                                        int32_t(view.width), int32_t(view.height));
+    window = roiWindow<P>(rp);
+    return true;
+}
+
+// Read only CV_8U or CV_16U cv::Mat over channel view. Empty if it can not be wrapped.
+inline cv::Mat lif_channel_mat (const lifIO::LifPlaneView& view)
+{
+    if (! view.valid() || ! view.planar()) return cv::Mat();
+    int type;
+    switch (view.sample_bytes)
+    {
+        case 1: type = CV_8U; break;
+        case 2: type = CV_16U; break;
+        default: return cv::Mat();
+    }
+
+    cv::Mat mat (int(view.height), int(view.width), type, const_cast<uint8_t*>(view.data), view.row_bytes);
+    // Reference counted like an allocated Mat, copies share the mapping
+    cv::UMatData* u = new cv::UMatData(lif_views_detail::mapping_allocator::instance());
+    u->data = u->origdata = mat.data;
+    u->size = view.row_bytes * (view.height - 1) + view.width * view.sample_bytes;
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+    u->refcount = 1;
+    u->userdata = new lifIO::LifMappedFile::ref(view.mapping);
+    mat.u = u;
+    mat.allocator = lif_views_detail::mapping_allocator::instance();
+    return mat;
+}
+
+}
+
+#endif
@@ -127,6 +127,10 @@ namespace svl
     void cpCvMatToRoiWindow8U (const cv::Mat& m, roiWindow<P8U>& r);
     void cpCvMatToRoiWindow16U (const cv::Mat& m, roiWindow<P16U>& r);
     
+    // No copy: the window's root adopts the cv::Mat's pixels and shares their ownership.
+    void refCvMatToRoiWindow8U (const cv::Mat& m, roiWindow<P8U>& r);
+    void refCvMatToRoiWindow16U (const cv::Mat& m, roiWindow<P16U>& r);
+    
     double correlation (cv::Mat &image_1, cv::Mat &image_2);
     double correlation_ocv(const roiWindow<P8U>& i, const roiWindow<P8U>& m);
     void cumani_opencv (const cv::Mat& input_bgr, cv::Mat& gradAbs, cv::Mat& orientation, float& maxVal);
@@ -82,6 +82,15 @@ namespace Correlation
 {
 template <typename P>
 void point(const roiWindow<P> & moving, const roiWindow<P> & fixed, CorrelationParts & res);
+
+// Pixel sum, sum of squares and count of the window. Computed once and cached with the window's root.
+template <typename P>
+imageMoments moments(const roiWindow<P> & image);
+
+// Correlation given both images' moments, only the cross term is accumulated.
+template <typename P>
+void point(const roiWindow<P> & moving, const roiWindow<P> & fixed,
+           const imageMoments & movingMoments, const imageMoments & fixedMoments, CorrelationParts & res);
 template <typename P>
 bool area_translation(const roiWindow<P> & moving, const roiWindow<P> & fixed, spaceResult& );
 template <typename P>
@@ -2,6 +2,7 @@
 #define _VIEW_
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <functional>
 #include <iostream>
@@ -9,11 +10,16 @@
 #include <memory>
 #include <ostream>
 #include <vector>
+#include <map>
 #include <mutex>
+#include <tuple>
+#include <atomic>
 #include "core/rectangle.h"
 #include <assert.h>
 #include "pixel_traits.h"
+#include "rowfunc.h"
 #include "core/core.hpp"
+#include "core/frame_pool.hpp"
 
 
 using namespace std;
@@ -38,7 +44,7 @@ public:
 
     // Constructors
     root(image_memory_alignment_policy imap = align_every_row, int alignment_bytes = 8)
-        : m_align(alignment_bytes), m_channels  (T::components()),_bayer_type(NoneBayer), m_align_policy(imap)
+        : m_align(alignment_bytes), m_storage(nullptr), m_channels  (T::components()),_bayer_type(NoneBayer), m_align_policy(imap)
     {
         
     }
@@ -69,18 +75,39 @@ public:
         }
     }
 
+    /*
+     * Adopt pixels owned elsewhere, e.g. a cv::Mat's buffer or a pooled slab, without copying them.
+     * owner is held for the life of the root and keeps the pixels valid. Rows are RowUpdateBytes apart.
+     */
+    root(const std::shared_ptr<const void>& owner, uint8_t * pixels, int32_t RowUpdateBytes, int32_t awidth, int32_t aheight)
+        :  m_storage(nullptr), m_channels  (T::components()),  _bayer_type(NoneBayer), m_owner(owner)
+    {
+        assert(aheight > 0);
+        assert(awidth > 0);
+        assert(pixels);
+        assert(RowUpdateBytes >= awidth * int32_t(T::bytes()));
+        m_width = awidth;
+        m_height = aheight;
+        m_bounds = iRect(0, 0, awidth, aheight);
+        m_rowbytes = RowUpdateBytes;
+        m_pad = RowUpdateBytes - awidth * T::bytes();
+        m_align_policy = m_pad ? align_every_row : align_first_row;
+        // Largest power of two, up to 256, both the first row and the row update are aligned to
+        m_align = 1;
+        while (m_align < 256 && ((intptr_t)pixels % (2 * m_align)) == 0 && (RowUpdateBytes % (2 * m_align)) == 0)
+            m_align *= 2;
+        m_image_data = pixels;
+    }
+
     // prohibit direct copying and assignment
     root(root && other) = delete;
     root & operator=(root && other) = delete;
 
 
+    // Owned pixels go back to their frame_pool with m_slab
     virtual ~root()
     {
-        if (m_storage)
-        {
-            delete [] m_storage;
-            m_storage = nullptr;
-        }
+        m_storage = nullptr;
     }
     
     bayer_type bayerType() { return _bayer_type; }
@@ -94,6 +121,7 @@ public:
 
     pixel_ptr_t rowPointer(int32_t y)
     {
+        modified();
         return (pixel_ptr_t)(alignedPixelData() + y * rowUpdate());
     }
 
@@ -119,7 +147,10 @@ public:
         return val;
     }
 
-    // be careful!
+    // True if the pixels are adopted, not owned
+    bool adopted() const { return bool(m_owner); }
+
+    // be careful! nullptr for adopted pixels
     uint8_t * raw_storage() const
     {
         return (uint8_t *)(m_storage);
@@ -148,6 +179,44 @@ public:
     inline int64_t timestamp() const { return m_timestamp; };
 
 
+    /*
+     * Per window moments cache ( see Correlation::moments ). Entries are tagged with the generation
+     * of the pixels they were taken from and are stale once it moves on. Writable row and pel pointers,
+     * and so setPixel and the mutators of this class and of roiWindow, move it on the first write after
+     * moments were cached, later writes only check a flag. Code writing the pixels some other way, e.g.
+     * through the buffer or cv::Mat an adopting root shares, or through a writable pointer taken before
+     * the moments, calls modified() once done. A root may carry thousands of windows ( voxel buffers ),
+     * so entries are keyed by bound and spread over stripes by origin row, each with its own lock.
+     */
+    uint64_t generation () const { return m_generation.load(); }
+    
+    void modified () const
+    {
+        if (m_has_moments.load(std::memory_order_relaxed) && m_has_moments.exchange(false))
+            m_generation++;
+    }
+    
+    bool cached_moments (const iRect & bound, imageMoments & moments) const
+    {
+        if (! m_has_moments) return false;
+        const uint64_t current = generation();
+        const moments_stripe & stripe = m_moments[moments_stripe_index(bound)];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto bm = stripe.cache.find(moments_key(bound));
+        if (bm == stripe.cache.end() || bm->second.first != current) return false;
+        moments = bm->second.second;
+        return true;
+    }
+    
+    // generation is read before taking the moments, a write meanwhile leaves the entry stale
+    void cache_moments (const iRect & bound, const imageMoments & moments, uint64_t generation) const
+    {
+        moments_stripe & stripe = m_moments[moments_stripe_index(bound)];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.cache[moments_key(bound)] = std::make_pair(generation, moments);
+        m_has_moments = true;
+    }
+    
     // Mutators
     void set(pixel_t val);
     //        void setBorder(int pad, pixel_t clear_val = pixel_t(0));
@@ -167,6 +236,7 @@ public:
         assert(rawBytes);
         assert(width() == iwidth);
         assert(height() == iheight);
+        modified();
 
         int32_t bytesInRow = width() * T::bytes();
 
@@ -203,8 +273,31 @@ protected:
     int m_index;
     int m_dt;
     bayer_type _bayer_type;
+    std::shared_ptr<const void> m_owner; // Keeps adopted pixels alive
+    frame_pool::block_t m_slab;    // Owned pixels, from the current frame_pool
 
     image_memory_alignment_policy m_align_policy;
+    
+    typedef std::tuple<int32_t, int32_t, int32_t, int32_t> moments_key_t;
+    struct moments_stripe
+    {
+        mutable std::mutex mutex;
+        std::map<moments_key_t, std::pair<uint64_t, imageMoments>> cache;
+    };
+    static const int32_t moments_stripes = 16;
+    mutable std::array<moments_stripe, moments_stripes> m_moments;
+    mutable std::atomic<uint64_t> m_generation {0};
+    mutable std::atomic<bool> m_has_moments {false}; // Entries of the current generation may exist
+
+    static moments_key_t moments_key (const iRect & bound)
+    {
+        return moments_key_t(bound.ul().x(), bound.ul().y(), bound.lr().x(), bound.lr().y());
+    }
+
+    static size_t moments_stripe_index (const iRect & bound)
+    {
+        return static_cast<uint32_t>(bound.ul().y()) % moments_stripes;
+    }
 
     void setup_native(int32_t width, int32_t height)
     {
@@ -227,15 +320,13 @@ protected:
         // If aligned_per row, add padding for every row
 
         m_rowbytes = rowBytes + (m_align_policy == align_every_row ? m_pad : 0);
-        int size = m_rowbytes * height + m_align - 1;
-
-        m_storage = new uint8_t[size];
-        auto startPtr = m_storage;
-        while ((intptr_t)startPtr % m_align)
-            startPtr++;
-        ptrdiff_t n = startPtr - m_storage;
-        assert((n < m_align) && (n >= 0));
-        m_image_data = startPtr;
+
+        // Pool blocks are aligned beyond m_align, the first row starts at the block
+        assert(frame_pool::alignment % m_align == 0);
+        m_slab = frame_pool::current()->acquire(size_t(m_rowbytes) * size_t(height));
+        m_storage = m_slab.get();
+        assert((intptr_t)m_storage % m_align == 0);
+        m_image_data = m_storage;
     }
 };
 
@@ -194,9 +194,10 @@ public:
         return m_frame_buf->getPixel(where.first + x(), where.second + y());
     }
 
+    // Const access reads through the const root, it does not count as a write
     const pixel_ptr_t rowPointer(int32_t row) const
     {
-        return (m_frame_buf->rowPointer(row + y()) + x());
+        return (const_root().rowPointer(row + y()) + x());
     }
 
     pixel_ptr_t rowPointer(int32_t row)
@@ -206,7 +207,7 @@ public:
 
     const pixel_ptr_t pelPointer(int32_t col, int32_t row) const
     {
-        return (m_frame_buf->rowPointer(row + y()) + x() + col);
+        return (const_root().rowPointer(row + y()) + x() + col);
     }
 
     pixel_ptr_t pelPointer(int32_t col, int32_t row)
@@ -273,6 +274,8 @@ public:
 protected:
     sharedRoot_t m_frame_buf; // Ref-counted pointer to frame buffer
     iRect m_bounds;
+    
+    const root_t & const_root() const { return *m_frame_buf; }
 
 
 };
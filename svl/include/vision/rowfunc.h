@@ -131,6 +131,23 @@ private:
 };
 
 
+// Pixel sum, sum of squares and count of an image. These parts of a correlation depend on one image only
+// and can be computed once per image ( see Correlation::moments )
+struct imageMoments
+{
+    uint64_t sum;
+    uint64_t sumsq;
+    uint32_t n;
+
+    imageMoments() : sum(0), sumsq(0), n(0) {}
+    bool operator==(const imageMoments & o) const { return sum == o.sum && sumsq == o.sumsq && n == o.n; }
+    bool operator!=(const imageMoments & o) const { return !(this->operator==(o)); }
+};
+
+template <class T>
+void accumulateMoments (const T * base, uint32_t rowPels, uint32_t width, uint32_t height, imageMoments &);
+
+
 // A class to encapsulate a table of pre-computed squares
 template <typename T>
 class sSqrTable
@@ -260,14 +277,49 @@ public:
     virtual void areaFunc();
     void epilog(CorrelationParts &);
 
+    // Table based reference implementation of rowFunc. The vectorized kernels
+    // produce bit identical sums, this is kept for validation and for targets
+    // without SSE2 / AVX2.
+    void rowFuncScalar();
+
+    // Use vectorized kernels when available ( default ). Scalar otherwise.
+    void use_simd(bool on) { mUseSimd = on && simd_available(); }
+    bool use_simd() const { return mUseSimd; }
+    static bool simd_available();
+
     virtual ~basicCorrRowFunc();
 
 private:
     CorrelationParts mRes;
     uint32_t mMaskPels;
     bool mffMaskOn;
+    bool mUseSimd;
+    std::pair<uint32_t, uint32_t> mRUP;
+};
+
+
+/*
+ * Cross term only correlation. Given both images' moments only sum(i*m) has to be accumulated.
+ * epilog combines it with the moments in to the same CorrelationParts basicCorrRowFunc produces
+ * ( for 8 bit images bit identical. For 16 bit the cross term is exact, not wrapped as the square table is ).
+ */
+template <class T>
+class crossCorrRowFunc : public rowFuncTwoSource<T>
+{
+public:
+    crossCorrRowFunc(const T * baseA, const T * baseB, uint32_t rupA, uint32_t rupB,
+                     uint32_t width, uint32_t height);
+
+    virtual void prolog();
+    virtual void rowFunc();
+    virtual void areaFunc();
+    void epilog(const imageMoments & a, const imageMoments & b, CorrelationParts &);
+
+    virtual ~crossCorrRowFunc();
+
+private:
+    uint64_t mSim;
     std::pair<uint32_t, uint32_t> mRUP;
-    sSqrTable<T> m_squareTable;
 };
 
 
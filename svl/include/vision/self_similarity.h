@@ -12,6 +12,7 @@
 #include <algorithm>
 #include "simple_timing.hpp"
 #include "core/stats.hpp"
+#include "core/symmetric_matrix.hpp"
 #include "core/progress_fn.h"
 #include "registration.h"
 #include "roiWindow.h"
@@ -130,6 +131,27 @@ public:
      */
     bool update(image_t nextImage);
     
+    /* streaming - In streaming mode update() keeps every frame's similarity sum and
+     * sum of r log2 r, and revises them for the outgoing and incoming frame only.
+     * An update then costs the N new correlations and O(N) arithmetic instead of
+     * an O(N^2) projection. The terms are re-derived from the matrix every matrixSz
+     * updates to bound round off. Results match the batch projection to round off.
+     * Off by default.
+     */
+    void streaming (bool on);
+    bool streaming () const { return _streaming; }
+    
+    /* batch - In batch mode fill() packs the frames, mean centered and L2 normalized,
+     * as the rows of a float matrix A. The similarity matrix is then the element wise
+     * square of the Gram matrix A A', computed with blocked matrix products instead of
+     * N (N - 1) / 2 pairwise correlations. Used when all frames are the same size, no
+     * mask is set and the default similarity function is in use, otherwise fill() falls
+     * back to the pairwise path. Results match the pairwise path to float round off.
+     * Off by default.
+     */
+    void batch (bool on) { _batch = on; }
+    bool batch () const { return _batch; }
+    
     std::pair<int32_t,int32_t> fillImageSize () const;
     
     void setMask(const roiWindow<P8U>& mask);
@@ -157,6 +179,7 @@ public:
      * in matrix. Otherwise, return false.
      */
     bool selfSimilarityMatrix(deque<deque<double> >& matrix) const;
+    bool selfSimilarityMatrix(svl::symmetric_matrix<double>& matrix) const;
     
     
     /*
@@ -204,14 +227,21 @@ private:
      */
     bool ssMatrixFill(deque<image_t >& tWin);
     
+    /* ssMatrixFillBatch - Gram matrix fill, see batch(). Returns false if the
+     * window does not qualify and the pairwise fill has to be used.
+     */
+    bool ssMatrixFillBatch(deque<image_t >& tWin);
+    
     /* internalUpdate - Called by update() fct to perform pixel size
      * specific update() functionality.
      */
     bool internalUpdate(image_t & nextImage, deque<image_t >& tWin);
     
     /* shiftS* - Fcts that shift self-similarity results by one image.
+     * The matrix is a ring, shifting advances its head.
      */
     void shiftSMatrix();
+    void allocate();
     
     /* s*Update - Perform correlations between the last image in the
      * temporal window and all the other images in the window. Use this
@@ -241,14 +271,29 @@ private:
      */
     bool genMatrixEntropy(size_t tWinSz);
     
+    /* streamMatrixEntropy - Similarity rank signal from the per frame row terms.
+     * refreshRowTerms - Recompute the row terms from the matrix.
+     */
+    bool streamMatrixEntropy();
+    void refreshRowTerms();
+    
     /* unity - Initialize self-similarity matrix to have identity
      * value along the identity diagonal.
      */
     void unity();
     
     double shannon (double r) const { return (-1.0 * r * log2 (r)); }
+    double xlogx (double r) const { return r > 0 ? r * log2 (r) : 0.0; }
+    
+    /* Matrix access by temporal window index. Rows and columns are stored in a flat
+     * matrixSz x matrixSz ring rotated by _head.
+     */
+    size_t slot (size_t i) const { return (_head + i) % _matrixSz; }
+    double& sm (size_t i, size_t j) { return _SMatrix[slot(i) * _matrixSz + slot(j)]; }
+    double sm (size_t i, size_t j) const { return _SMatrix[slot(i) * _matrixSz + slot(j)]; }
     
     similarity_fn_t               _corr_fn;
+    bool                          _default_corr;
     progress_fn_t                 _progress_fn;
     
     /* Masking related information
@@ -284,8 +329,13 @@ private:
     
     /* Outputs
      */
-    deque<deque<double> >        _SMatrix;   // Used in eExhaustive and
-                                             // eApproximate cases
+    vector<double>               _SMatrix;   // matrixSz x matrixSz ring, see sm()
+    size_t                       _head;
+    bool                         _streaming;
+    bool                         _batch;
+    vector<double>               _rowSums;   // Streaming row terms, by slot
+    vector<double>               _rowXlogX;
+    size_t                       _since_refresh;
     deque<double>                m_entropies; // Final similarity rank signal
     std::vector<int>               m_median_ranked;
     mutable deque<double>                _sums;     // Final mean signal
@@ -297,6 +347,7 @@ private:
 
 
 typedef std::shared_ptr<self_similarity_producer<P8U> > self_similarity_producerRef;
+typedef std::shared_ptr<self_similarity_producer<P16U> > self_similarity_producer16Ref;
 
 void rf1DdistanceHistogram (const vector<double>& signal, vector<double>& dHist);
 
@@ -12,13 +12,18 @@
 #include <algorithm>
 
 #include <stdio.h>
-#include <Accelerate/Accelerate.h>
 #include "core/core.hpp"
+#include "core/fft_engine.hpp"
 
 using namespace std;
 
 /* @note Does not subtract DC component
  * incomplete API
+ *
+ * Spectrum layout follows vDSP_fft_zrip on every platform: bins 1 to N/2 - 1 in
+ * spectrum_realp / spectrum_imagp, DC in realp[0], Nyquist in imagp[0], all scaled by 2.
+ * The transform itself is svl::fft_real: vDSP on Apple, the portable engine elsewhere.
+ * Any even length is supported.
  */
 
 
@@ -26,81 +31,56 @@ class fft1D
 {
 public:
     
-    fft1D (const std::vector<float>& src){
+    fft1D (const std::vector<float>& src) : m_engine(src.size()) {
         auto sz = src.size();
         m_log_length = log2max(sz);
-        m_length = 1 << m_log_length;
+        m_length = sz;
         m_half_length = m_length / 2;
-        assert(m_length == sz);
-        m_opeque = vDSP_create_fftsetup(m_log_length, 2);
+        assert(m_length % 2 == 0);
         m_x = src;
         m_y = m_x;
         m_split_realp.resize(m_half_length);
         m_split_imagp.resize(m_half_length);
         m_mag.resize(m_half_length);
         m_phase.resize(m_half_length);
-        m_tempComplex.resize(m_half_length);
-        m_tempSplitComplex.realp = &m_split_realp[0];
-        m_tempSplitComplex.imagp = &m_split_imagp[0];
+        m_re.resize(m_engine.bins());
+        m_im.resize(m_engine.bins());
     }
     
-    ~fft1D() { vDSP_destroy_fftsetup(m_opeque); }
-    
-    
-    const vDSP_Length& nN() { return m_length; }
-    const vDSP_Length& logN() { return m_log_length;}
+    const size_t& nN() { return m_length; }
+    const size_t& logN() { return m_log_length;}
     const std::vector<float>& phase () const { return m_phase; }
     const std::vector<float>& magnitude () const { return m_mag; }
     const std::vector<float>& spectrum_realp () const { return  m_split_realp; }
     const std::vector<float>& spectrum_imagp () const { return  m_split_imagp; }
     
     void compute_spectrum (){
-        // ----------------------------------------------------------------
-        // Forward FFT
-        
-        // Scramble-pack the real data into complex buffer in just the way that's
-        // required by the real-to-complex FFT function that follows.
-        vDSP_ctoz((DSPComplex*)(&m_x[0]), 2, &m_tempSplitComplex, 1, m_half_length);
-        
-        // Do real->complex forward FFT
-        vDSP_fft_zrip(m_opeque, &m_tempSplitComplex, 1, m_log_length, kFFTDirection_Forward);
-        
-        // Print the complex spectrum. Note that since it's the FFT of a real signal,
-        // the spectrum is conjugate symmetric, that is the negative frequency components
-        // are complex conjugates of the positive frequencies. The real->complex FFT
-        // therefore only gives us the positive half of the spectrum from bin 0 ("DC")
-        // to bin N/2 (Nyquist frequency, i.e. half the sample rate). Typically with
-        // audio code, you don't need to worry much about the DC and Nyquist values, as
-        // they'll be very close to zero if you're doing everything else correctly.
-        //
-        // Bins 0 and N/2 both necessarily have zero phase, so in the packed format
-        // only the real values are output, and these are stuffed into the real/imag components
-        // of the first complex value (even though they are both in fact real values). Try
-        // replacing BIN above with N/2 to see how sinusoid at Nyquist appears in the spectrum.
-//        printf("\nSpectrum:\n");
-//        for (int k = 0; k < m_half_length; k++)
-//        {
-//            printf("%3d\t%6.2f\t%6.2f\n", k, m_tempSplitComplex.realp[k], m_tempSplitComplex.imagp[k]);
-//        }
+        // Forward real FFT, bins 0 to N/2
+        m_engine.forward(&m_x[0], &m_re[0], &m_im[0]);
         
+        // Pack as vDSP_fft_zrip does. Bins 0 and N/2 both necessarily have zero phase, so
+        // only their real values are kept, stuffed into the real/imag components of the
+        // first complex value.
+        m_split_realp[0] = 2.0f * m_re[0];
+        m_split_imagp[0] = 2.0f * m_re[m_half_length];
+        for (size_t k = 1; k < m_half_length; k++)
+        {
+            m_split_realp[k] = 2.0f * m_re[k];
+            m_split_imagp[k] = 2.0f * m_im[k];
+        }
     }
     void compute_phase_mag (){
         // ----------------------------------------------------------------
         // Convert from complex/rectangular (real, imaginary) coordinates
         // to polar (magnitude and phase) coordinates.
         
-        // Compute magnitude and phase. Can also be done using vDSP_polar.
-        // Note that when printing out the values below, we ignore bin zero, as the
-        // real/complex values for bin zero in tempSplitComplex actually both correspond
-        // to real spectrum values for bins 0 (DC) and N/2 (Nyquist) respectively.
-        vDSP_zvabs(&m_tempSplitComplex, 1, &m_mag[0], 1, m_half_length);
-        vDSP_zvphas(&m_tempSplitComplex, 1, &m_phase[0], 1, m_half_length);
-//
-//        printf("\nMag / Phase:\n");
-//        for (int k = 1; k < m_half_length; k++)
-//        {
-//            printf("%3d\t%6.2f\t%6.2f\n", k, m_mag[k], m_phase[k]);
-//        }
+        // Note that bin zero actually holds the real spectrum values for bins 0 (DC)
+        // and N/2 (Nyquist), see compute_spectrum.
+        for (size_t k = 0; k < m_half_length; k++)
+        {
+            m_mag[k] = std::sqrt(m_split_realp[k] * m_split_realp[k] + m_split_imagp[k] * m_split_imagp[k]);
+            m_phase[k] = std::atan2(m_split_imagp[k], m_split_realp[k]);
+        }
     }
     
     static bool test (){
@@ -126,14 +106,12 @@ public:
     
 private:
 
-    FFTSetup m_opeque;
-    vDSP_Length m_length;
-    vDSP_Length m_half_length;
-    vDSP_Length m_log_length;
+    svl::fft_real m_engine;
+    size_t m_length;
+    size_t m_half_length;
+    size_t m_log_length;
     mutable std::vector<float> m_x, m_y, m_split_realp, m_split_imagp, m_mag, m_phase;
-    // We need complex buffers in two different formats!
-    std::vector<DSPComplex> m_tempComplex;
-    DSPSplitComplex m_tempSplitComplex;
+    std::vector<float> m_re, m_im;
 
     
     ////////////////////////////////////////////////////////////////////////////////
@@ -147,9 +125,9 @@ private:
     //    log2max(9) = 4
     //
     ////////////////////////////////////////////////////////////////////////////////
-    vDSP_Length log2max(size_t n)
+    size_t log2max(size_t n)
     {
-        vDSP_Length power = 1;
+        size_t power = 1;
         int32_t k = 1;
         
         if (n==1) {
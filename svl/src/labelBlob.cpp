@@ -248,10 +248,11 @@ void svl::labelBlob::blob::update_moments(const cv::Mat& image) const {
 }
 
 void svl::labelBlob::blob::update_points(const std::vector<cv::Point>& pts) const {
-    m_points.clear();
-    for (auto const & pt : pts){
-        m_points.push_back(pt);
-    }
+    update_points(pts.data(), pts.data() + pts.size());
+}
+
+void svl::labelBlob::blob::update_points(const cv::Point* first, const cv::Point* last) const {
+    m_points.assign(first, last);
 }
 cv::RotatedRect svl::labelBlob::blob::rotated_roi() const {
     std::lock_guard<std::mutex> lock( m_mutex );
@@ -375,16 +376,24 @@ void  labelBlob::run() const {
     std::vector<cv::Mat> channels = { m_threshold_out,m_threshold_out,m_threshold_out};
     cv::merge(&channels[0],3,m_graphics);
     assert(count == m_stats.rows);
-    std::map<int,vector<cv::Point>> lablemap;
-    for (auto row = 0; row < m_labels.rows; row++)
+    
+    // Points of all kept labels in one buffer, counting sort by label: label l's points are at
+    // [offsets[l], offsets[l+1]) in raster order. Labels under the minimum area get no room.
+    auto kept = [this] (size_t l) { return l > 0 && m_stats.at<int>(int(l), cv::CC_STAT_AREA) >= m_min_area; };
+    std::vector<size_t> offsets (count + 1, 0);
+    for (size_t l = 0; l < count; l++)
+        offsets[l + 1] = offsets[l] + (kept(l) ? size_t(m_stats.at<int>(int(l), cv::CC_STAT_AREA)) : 0);
+    std::vector<cv::Point> points (offsets[count]);
+    std::vector<size_t> fill (offsets.begin(), offsets.end() - 1);
+    for (auto row = 0; row < m_labels.rows; row++){
+        const int* labels = m_labels.ptr<int>(row);
         for (auto col = 0; col < m_labels.cols; col++)
         {
-            auto l = m_labels.at<int>(row,col);
-            if (l == 0) continue;
-            std::vector<cv::Point> pts = lablemap[l];
-            pts.emplace_back(col, row);
-            lablemap[l] = pts;
+            const int l = labels[col];
+            if (offsets[l] == offsets[l + 1]) continue;
+            points[fill[l]++] = cv::Point(col, row);
         }
+    }
     
     m_moments.resize(0);
     m_rois.resize(0);
@@ -414,7 +423,7 @@ void  labelBlob::run() const {
         m_blobs.back().update_moments(m_grey);
         cv::Mat window = m_threshold_out(roi);
         m_blobs.back().update_contours(window);
-        m_blobs.back().update_points(lablemap[i]);
+        m_blobs.back().update_points(points.data() + offsets[i], points.data() + offsets[i + 1]);
     }
     std::sort (m_blobs.begin(), m_blobs.end(),[](const blob&a, const blob&b){
         return a.iarea() > b.iarea();
@@ -16,6 +16,12 @@
 #include <algorithm>
 #include <numeric>
 #include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace  {
     
@@ -38,28 +44,192 @@ namespace  {
     {
         return make_shared_ifstream(new std::ifstream(filename, std::ifstream::in | std::ifstream::binary));
     }
+    
+    /*
+     * Header index primitives. Native byte order, the index is a local cache
+     * and is rewritten when it does not match.
+     */
+    const uint32_t index_magic = 0x5846494c; // LIFX
+    const uint32_t index_format = 1;
+    
+    template <typename T> void put (std::ostream& os, const T& val)
+    {
+        os.write(reinterpret_cast<const char*>(&val), sizeof(T));
+    }
+    
+    void put (std::ostream& os, const std::string& str)
+    {
+        put<uint32_t>(os, static_cast<uint32_t>(str.size()));
+        os.write(str.data(), str.size());
+    }
+    
+    template <typename T> T get (std::istream& is)
+    {
+        T val = T();
+        if (! is.read(reinterpret_cast<char*>(&val), sizeof(T)))
+            throw std::runtime_error("Truncated lif index");
+        return val;
+    }
+    
+    template <> std::string get<std::string> (std::istream& is)
+    {
+        const uint32_t length = get<uint32_t>(is);
+        if (length > (1u << 24))
+            throw std::runtime_error("Corrupt lif index");
+        std::string str (length, '\0');
+        if (length && ! is.read(&str[0], length))
+            throw std::runtime_error("Truncated lif index");
+        return str;
+    }
+    
+    // Size and modification time identify the file version an index was made from
+    bool file_key (const std::string& filename, uint64_t& size, int64_t& mtime)
+    {
+        struct stat st;
+        if (::stat(filename.c_str(), &st) != 0) return false;
+        size = static_cast<uint64_t>(st.st_size);
+        mtime = static_cast<int64_t>(st.st_mtime);
+        return true;
+    }
 }
 
 using namespace std;
 
 
-/** @brief LifSerieHeader constructor  */
-lifIO::LifSerieHeader::LifSerieHeader(TiXmlElement *root) : name(root->Attribute("Name")), rootElement(root)
+/** @brief map the whole file read only. Pages are backed by the file, not charged against the
+    commit limit, so files larger than memory map too. The descriptor is not needed once mapped */
+lifIO::LifMappedFile::ref lifIO::LifMappedFile::map(const std::string& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return nullptr;
+    
+    std::shared_ptr<LifMappedFile> mf (new LifMappedFile());
+    mf->m_data = static_cast<const uint8_t*>(addr);
+    mf->m_size = static_cast<size_t>(st.st_size);
+    return mf;
+}
+
+lifIO::LifMappedFile::~LifMappedFile()
+{
+    if (m_data != nullptr)
+        ::munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+/** @brief advise the kernel to read ahead the given range */
+void lifIO::LifMappedFile::will_need(unsigned long long offset, unsigned long long length) const
+{
+    if (offset >= m_size) return;
+    length = std::min(length, static_cast<unsigned long long>(m_size) - offset);
+    const unsigned long long page = static_cast<unsigned long long>(::sysconf(_SC_PAGESIZE));
+    const unsigned long long start = offset - offset % page;
+    ::madvise(const_cast<uint8_t*>(m_data) + start, static_cast<size_t>(offset + length - start), MADV_WILLNEED);
+}
+
+
+/** @brief open read only for positional reads  */
+lifIO::LifPositionalFile::ref lifIO::LifPositionalFile::open(const std::string& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    std::shared_ptr<LifPositionalFile> pf (new LifPositionalFile());
+    pf->m_fd = fd;
+    return pf;
+}
+
+lifIO::LifPositionalFile::~LifPositionalFile()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+/** @brief pread until length bytes are in, retrying interrupted and partial reads  */
+void lifIO::LifPositionalFile::read(void* buffer, unsigned long long offset, size_t length) const
+{
+    char* pos = static_cast<char*>(buffer);
+    while (length > 0)
+    {
+        ssize_t got = ::pread(m_fd, pos, length, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0)
+            throw runtime_error("Lif read failed");
+        pos += got;
+        offset += got;
+        length -= got;
+    }
+}
+
+/** @brief advise the kernel to read ahead the given range  */
+void lifIO::LifPositionalFile::will_need(unsigned long long offset, unsigned long long length) const
+{
+#if defined(__APPLE__)
+    struct radvisory ra;
+    ra.ra_offset = static_cast<off_t>(offset);
+    ra.ra_count = static_cast<int>(std::min(length, static_cast<unsigned long long>(INT32_MAX)));
+    ::fcntl(m_fd, F_RDADVISE, &ra);
+#else
+    ::posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+#endif
+}
+
+
+/** @brief LifSerieHeader constructor. The Image element is parsed on first use  */
+lifIO::LifSerieHeader::LifSerieHeader(TiXmlElement *root) : name(root->Attribute("Name")), rootElement(root), m_parsed(false)
+{
+    m_cached_frame_duration.first = false;
+    return;
+}
+
+/** @brief copy, parsed or not  */
+lifIO::LifSerieHeader::LifSerieHeader(const LifSerieHeader& other)
 {
+    std::lock_guard<std::mutex> lock(other.m_parse_mutex);
+    name = other.name;
+    dimensions = other.dimensions;
+    channels = other.channels;
+    timeStamps = other.timeStamps;
+    scannerSettings = other.scannerSettings;
+    rootElement = other.rootElement;
+    m_frame_durations = other.m_frame_durations;
+    m_cached_frame_duration = other.m_cached_frame_duration;
+    m_parsed = other.m_parsed.load();
+}
+
+/** @brief parse the Image element, once  */
+void lifIO::LifSerieHeader::parse() const
+{
+    if (m_parsed) return;
+    std::lock_guard<std::mutex> lock(m_parse_mutex);
+    if (m_parsed) return;
+    
     //XML parsing
-    TiXmlNode *elementImage = rootElement->FirstChild("Data")->FirstChild("Image");
+    TiXmlNode *elementImage = rootElement ? rootElement->FirstChild("Data")->FirstChild("Image") : nullptr;
     // If Image element found
     if (elementImage)
         parseImage(elementImage);
-    
-    m_cached_frame_duration.first = false;
-    return;
+    setDurations();
+    m_parsed = true;
+}
+
+/** \brief durations between consecutive time stamps, the first one is 0 */
+void lifIO::LifSerieHeader::setDurations() const
+{
+    m_frame_durations.resize(timeStamps.size());
+    if (timeStamps.empty()) return;
+    adjacent_difference(timeStamps.begin(), timeStamps.end(), m_frame_durations.begin());
+    m_frame_durations[0] = 0;
 }
 
 
 /** \brief get the real size of a pixel (in meters) in the dimension d */
 double lifIO::LifSerieHeader::getVoxelSize(const size_t d) const
 {
+    parse();
     const string voxel = "dblVoxel", dims = "XYZ";
     map<string, ScannerSettingRecord>::const_iterator it = scannerSettings.find(voxel+dims[d]);
     if(it == scannerSettings.end())
@@ -73,12 +243,14 @@ double lifIO::LifSerieHeader::getVoxelSize(const size_t d) const
 /** \brief get the resolution of a channel of a serie, in Bits per pixel*/
 int lifIO::LifSerieHeader::getResolution(const size_t channel) const
 {
+    parse();
     return channels[channel].resolution;
 }
 
 /** @brief get the number of time steps  */
 size_t lifIO::LifSerieHeader::getNbTimeSteps() const
 {
+    parse();
     map<string, DimensionData>::const_iterator it = dimensions.find("T");
     if(it == dimensions.end()) return 1;
     return it->second.numberOfElements;
@@ -86,6 +258,7 @@ size_t lifIO::LifSerieHeader::getNbTimeSteps() const
 
 bool lifIO::LifSerieHeader::hasTimeChannel() const
 {
+    parse();
     map<string, DimensionData>::const_iterator it = dimensions.find("T");
     return it != dimensions.end();
 }
@@ -93,6 +266,7 @@ bool lifIO::LifSerieHeader::hasTimeChannel() const
 /** @brief getSpatialDimensions  */
 vector<size_t> lifIO::LifSerieHeader::getSpatialDimensions() const
 {
+    parse();
     vector<size_t> dims;
     for(map<string, DimensionData>::const_iterator d = dimensions.begin(); d != dimensions.end(); d++)
         if(d->second.dimID <4)
@@ -128,7 +302,7 @@ double lifIO::LifSerieHeader::getZXratio() const
 
 
 /** @brief parse the "Image" node of the XML header  */
-void lifIO::LifSerieHeader::parseImage(TiXmlNode *elementImage)
+void lifIO::LifSerieHeader::parseImage(TiXmlNode *elementImage) const
 {
     TiXmlNode *elementImageDescription = elementImage->FirstChild("ImageDescription");
     if (elementImageDescription)
@@ -152,7 +326,7 @@ void lifIO::LifSerieHeader::parseImage(TiXmlNode *elementImage)
 }
 
 /** @brief parse the "ImageDescription" node of the XML header  */
-void lifIO::LifSerieHeader::parseImageDescription(TiXmlNode *elementImageDescription)
+void lifIO::LifSerieHeader::parseImageDescription(TiXmlNode *elementImageDescription) const
 {
     TiXmlNode *elementChannels = elementImageDescription->FirstChild("Channels");
     TiXmlNode *elementDimensions = elementImageDescription->FirstChild("Dimensions");
@@ -175,7 +349,7 @@ void lifIO::LifSerieHeader::parseImageDescription(TiXmlNode *elementImageDescrip
 }
 
 /** @brief parse the "TimeStampList" node of the XML header  */
-void lifIO::LifSerieHeader::parseTimeStampList(TiXmlNode *elementTimeStampList)
+void lifIO::LifSerieHeader::parseTimeStampList(TiXmlNode *elementTimeStampList) const
 {
     if (elementTimeStampList)
     {
@@ -216,7 +390,7 @@ void lifIO::LifSerieHeader::parseTimeStampList(TiXmlNode *elementTimeStampList)
 }
 
 /** @brief parse the "HardwareSettingList" node of the XML header  */
-void lifIO::LifSerieHeader::parseHardwareSettingList(TiXmlNode *elementHardwareSettingList)
+void lifIO::LifSerieHeader::parseHardwareSettingList(TiXmlNode *elementHardwareSettingList) const
 {
     TiXmlNode *elementHardwareSetting = elementHardwareSettingList->FirstChild();
     TiXmlNode *elementScannerSetting = elementHardwareSetting->FirstChild("ScannerSetting");
@@ -227,7 +401,7 @@ void lifIO::LifSerieHeader::parseHardwareSettingList(TiXmlNode *elementHardwareS
 }
 
 /** @brief parse the "ScannerSetting" node of the XML header  */
-void lifIO::LifSerieHeader::parseScannerSetting(TiXmlNode *elementScannerSetting)
+void lifIO::LifSerieHeader::parseScannerSetting(TiXmlNode *elementScannerSetting) const
 {
     if(elementScannerSetting)
     {
@@ -252,9 +426,6 @@ float lifIO::LifSerieHeader::frame_duration_ms() const
         float avg_fd = 0.0;
         if (getTimestamps().size())
             {
-                m_frame_durations.resize(getTimestamps().size());
-                adjacent_difference(getTimestamps().begin(), getTimestamps().end(), m_frame_durations.begin());
-                m_frame_durations[0] = 0; // first difference not written
                 auto sumall = accumulate(m_frame_durations.begin(), m_frame_durations.end(), 0);
                 avg_fd = (sumall / (m_frame_durations.size()-1))/10000.0f;
             }
@@ -267,15 +438,19 @@ float lifIO::LifSerieHeader::frame_duration_ms() const
 
 /** @brief LifSerie constructor  */
 lifIO::LifSerie::LifSerie(LifSerieHeader serie, const std::string &filename,
-                          unsigned long long offset, unsigned long long memorySize) : LifSerieHeader(serie)
+                          unsigned long long offset, unsigned long long memorySize,
+                          unsigned long long fileSize) : LifSerieHeader(serie), m_filename(filename)
 {
-    fileRef = make_shared_ifstream(filename.c_str());
-    if(! fileRef || !fileRef->is_open())
-        throw invalid_argument(("No such file as "+filename).c_str());
-
     //get size of the file
-    fileRef->seekg(0,ios::end);
-    fileSize = fileRef->tellg();
+    if (fileSize == 0)
+    {
+        uint64_t size;
+        int64_t mtime;
+        if (! file_key(filename, size, mtime))
+            throw invalid_argument(("No such file as "+filename).c_str());
+        fileSize = size;
+    }
+    this->fileSize = static_cast<std::streampos>(fileSize);
 
     //check the validity of the offset and memorysize parameters
     if(offset >= (unsigned long long)fileSize)
@@ -287,6 +462,18 @@ lifIO::LifSerie::LifSerie(LifSerieHeader serie, const std::string &filename,
     this->memorySize = memorySize;
 }
 
+/** @brief the serie's own stream, opened on first use  */
+const std::shared_ptr<std::ifstream>& lifIO::LifSerie::stream() const
+{
+    if (! fileRef)
+    {
+        fileRef = make_shared_ifstream(m_filename);
+        if(! fileRef->is_open())
+            throw invalid_argument(("No such file as "+m_filename).c_str());
+    }
+    return fileRef;
+}
+
 
 
 /**
@@ -295,10 +482,10 @@ lifIO::LifSerie::LifSerie(LifSerieHeader serie, const std::string &filename,
   */
 void lifIO::LifSerie::fill3DBuffer(void* buffer, size_t t) const
 {
+    parse();
     char *pos = static_cast<char*>(buffer);
     unsigned long int frameDataSize = getNbPixelsInOneTimeStep()*channels.size();
-    fileRef->seekg(getOffset(t) ,ios::beg);
-    fileRef->read(pos,frameDataSize);
+    read_at(pos, getOffset(t), frameDataSize);
 }
 
 /**
@@ -307,10 +494,110 @@ void lifIO::LifSerie::fill3DBuffer(void* buffer, size_t t) const
   */
 void lifIO::LifSerie::fill2DBuffer(void* buffer, size_t t, size_t z) const
 {
+    parse();
     char *pos = static_cast<char*>(buffer);
     unsigned long int sliceDataSize = getNbPixelsInOneSlice()*channels.size();
-    fileRef->seekg(getOffset(t) + z *  sliceDataSize, ios::beg);
-    fileRef->read(pos, sliceDataSize);
+    read_at(pos, sliceOffset(t, z), sliceDataSize);
+}
+
+/**
+    \brief fill one buffer per time step in [t0, t1)
+  */
+void lifIO::LifSerie::fill_range(size_t t0, size_t t1, const std::vector<void*>& buffers, size_t z) const
+{
+    if (t1 <= t0) return;
+    if (buffers.size() < t1 - t0)
+        throw invalid_argument("Fewer buffers than time steps");
+    parse();
+    
+    unsigned long long sliceDataSize = getNbPixelsInOneSlice()*channels.size();
+    const unsigned long long first = sliceOffset(t0, z);
+    const unsigned long long last = sliceOffset(t1 - 1, z) + sliceDataSize;
+    if (m_mapping)
+        m_mapping->will_need(first, last - first);
+    else if (m_pfile)
+        m_pfile->will_need(first, last - first);
+    
+    for (size_t t = t0; t < t1; t++)
+        read_at(buffers[t - t0], sliceOffset(t, z), sliceDataSize);
+}
+
+/** @brief copy from the mapping, positional read, or the serie's own stream when neither is set */
+void lifIO::LifSerie::read_at(void* buffer, unsigned long long pos, size_t length) const
+{
+    if (m_mapping)
+    {
+        // A truncated file fails the read like a short positional read does
+        if (pos > m_mapping->size() || length > m_mapping->size() - pos)
+            throw runtime_error("Read past the end of the mapped file");
+        std::memcpy(buffer, m_mapping->data() + pos, length);
+        return;
+    }
+    if (m_pfile)
+    {
+        m_pfile->read(buffer, pos, length);
+        return;
+    }
+    stream()->seekg(pos, ios::beg);
+    stream()->read(static_cast<char*>(buffer), length);
+}
+
+/** @brief position in file of slice z of time step t, all channels */
+unsigned long long lifIO::LifSerie::sliceOffset(size_t t, size_t z) const
+{
+    parse();
+    unsigned long long sliceDataSize = getNbPixelsInOneSlice()*channels.size();
+    return getOffset(t) + z * sliceDataSize;
+}
+
+/** @brief slice z of time step t in the mapped file, nullptr if not mapped or past the end of a truncated file */
+const uint8_t* lifIO::LifSerie::mappedSlice(size_t t, size_t z) const
+{
+    if (! m_mapping) return nullptr;
+    const unsigned long long start = sliceOffset(t, z);
+    const unsigned long long length = getNbPixelsInOneSlice()*channels.size();
+    if (start > m_mapping->size() || length > m_mapping->size() - start) return nullptr;
+    return m_mapping->data() + start;
+}
+
+/**
+    \brief view of one channel of slice z of time step t in the mapped file
+    Strides come from the X and Y dimension and the channel byte increments, so
+    planar and interleaved channel layouts are both described without copying.
+  */
+lifIO::LifPlaneView lifIO::LifSerie::channelView(size_t channel, size_t t, size_t z) const
+{
+    LifPlaneView view;
+    if (! m_mapping) return view;
+    parse();
+    if (channel >= channels.size())
+        throw out_of_range("Channel out of range");
+    
+    const vector<size_t> dims = getSpatialDimensions();
+    if (dims.empty()) return view;
+    view.width = static_cast<uint32_t>(dims[0]);
+    view.height = static_cast<uint32_t>(dims.size() > 1 ? dims[1] : 1);
+    
+    const size_t pel_bytes = (channels[channel].resolution + 7) / 8;
+    map<string, DimensionData>::const_iterator xd = dimensions.find("X");
+    map<string, DimensionData>::const_iterator yd = dimensions.find("Y");
+    map<string, DimensionData>::const_iterator zd = dimensions.find("Z");
+    view.pixel_bytes = (xd != dimensions.end() && xd->second.bytesInc) ? xd->second.bytesInc : pel_bytes;
+    view.row_bytes = (yd != dimensions.end() && yd->second.bytesInc) ? yd->second.bytesInc : view.width * view.pixel_bytes;
+    
+    unsigned long long start = (zd != dimensions.end() && zd->second.bytesInc) ?
+        getOffset(t) + z * zd->second.bytesInc : sliceOffset(t, z);
+    start += channels[channel].bytesInc;
+    const unsigned long long last = start + (view.height - 1) * view.row_bytes + (view.width - 1) * view.pixel_bytes + pel_bytes;
+    if (last > this->offset + this->memorySize)
+        throw out_of_range("Slice out of range");
+    if (last > m_mapping->size())
+        throw out_of_range("Slice past the end of the mapped file");
+    
+    view.sample_bytes = pel_bytes;
+    view.data = m_mapping->data() + start;
+    view.mapping = m_mapping;
+    return view;
 }
 
 /** @brief return an iterator to the begining of the data of time step t
@@ -318,14 +605,15 @@ void lifIO::LifSerie::fill2DBuffer(void* buffer, size_t t, size_t z) const
 */
 istreambuf_iterator<char> lifIO::LifSerie::begin(size_t t)
 {
-    fileRef->seekg(getOffset(t));
-    return istreambuf_iterator<char>(*fileRef);
+    stream()->seekg(getOffset(t));
+    return istreambuf_iterator<char>(*stream());
 }
 
 
 /** @brief get the position in file where starts the data of time step t  */
 unsigned long long lifIO::LifSerie::getOffset(size_t t) const
 {
+    parse();
     if(t >= getNbTimeSteps())
         throw out_of_range("Time step out of range");
     if(t==0)
@@ -385,13 +673,172 @@ void lifIO::LifHeader::parseHeader()
 
 
 
+/** @brief header index of every serie, parsing them  */
+void lifIO::LifHeader::writeIndex(std::ostream& os) const
+{
+    put(os, name);
+    put<int32_t>(os, lifVersion);
+    put<uint32_t>(os, static_cast<uint32_t>(m_series.size()));
+    for (const auto& serie : m_series)
+        serie->writeIndex(os);
+}
+
+std::shared_ptr<lifIO::LifHeader> lifIO::LifHeader::readIndex(std::istream& is)
+{
+    std::shared_ptr<LifHeader> header (new LifHeader());
+    header->name = get<std::string>(is);
+    header->lifVersion = get<int32_t>(is);
+    const uint32_t count = get<uint32_t>(is);
+    for (uint32_t s = 0; s < count; s++)
+        header->m_series.push_back(LifSerieHeader::readIndex(is));
+    return header;
+}
+
+/** @brief everything parseImage extracts  */
+void lifIO::LifSerieHeader::writeIndex(std::ostream& os) const
+{
+    parse();
+    put(os, name);
+    put<uint32_t>(os, static_cast<uint32_t>(dimensions.size()));
+    for (const auto& dd : dimensions)
+    {
+        const DimensionData& d = dd.second;
+        put<int32_t>(os, d.dimID);
+        put<int32_t>(os, d.numberOfElements);
+        put(os, d.origin);
+        put(os, d.length);
+        put(os, d.unit);
+        put<uint64_t>(os, d.bytesInc);
+        put<int32_t>(os, d.bitInc);
+    }
+    put<uint32_t>(os, static_cast<uint32_t>(channels.size()));
+    for (const auto& c : channels)
+    {
+        put<int32_t>(os, c.dataType);
+        put<int32_t>(os, c.channelTag);
+        put<int32_t>(os, c.resolution);
+        put(os, c.nameOfMeasuredQuantity);
+        put(os, c.minimum);
+        put(os, c.maximum);
+        put(os, c.unit);
+        put(os, c.LUTName);
+        put<uint8_t>(os, c.isLUTInverted);
+        put<uint64_t>(os, c.bytesInc);
+        put<int32_t>(os, c.bitInc);
+    }
+    put<uint32_t>(os, static_cast<uint32_t>(timeStamps.size()));
+    if (! timeStamps.empty())
+        os.write(reinterpret_cast<const char*>(timeStamps.data()), timeStamps.size() * sizeof(timestamp_t));
+    put<uint32_t>(os, static_cast<uint32_t>(scannerSettings.size()));
+    for (const auto& ss : scannerSettings)
+    {
+        put(os, ss.first);
+        put(os, ss.second.identifier);
+        put(os, ss.second.unit);
+        put(os, ss.second.description);
+        put<int32_t>(os, ss.second.data);
+        put(os, ss.second.variant);
+        put<int32_t>(os, ss.second.variantType);
+    }
+}
+
+std::unique_ptr<lifIO::LifSerieHeader> lifIO::LifSerieHeader::readIndex(std::istream& is)
+{
+    std::unique_ptr<LifSerieHeader> sh (new LifSerieHeader());
+    sh->m_cached_frame_duration.first = false;
+    sh->name = get<std::string>(is);
+    const uint32_t dims = get<uint32_t>(is);
+    for (uint32_t ii = 0; ii < dims; ii++)
+    {
+        DimensionData d;
+        d.dimID = get<int32_t>(is);
+        d.numberOfElements = get<int32_t>(is);
+        d.origin = get<double>(is);
+        d.length = get<double>(is);
+        d.unit = get<std::string>(is);
+        d.bytesInc = get<uint64_t>(is);
+        d.bitInc = get<int32_t>(is);
+        sh->dimensions.insert(make_pair(d.getName(), d));
+    }
+    const uint32_t chans = get<uint32_t>(is);
+    for (uint32_t ii = 0; ii < chans; ii++)
+    {
+        ChannelData c;
+        c.dataType = get<int32_t>(is);
+        c.channelTag = get<int32_t>(is);
+        c.resolution = get<int32_t>(is);
+        c.nameOfMeasuredQuantity = get<std::string>(is);
+        c.minimum = get<double>(is);
+        c.maximum = get<double>(is);
+        c.unit = get<std::string>(is);
+        c.LUTName = get<std::string>(is);
+        c.isLUTInverted = get<uint8_t>(is) != 0;
+        c.bytesInc = get<uint64_t>(is);
+        c.bitInc = get<int32_t>(is);
+        sh->channels.push_back(c);
+    }
+    const uint32_t stamps = get<uint32_t>(is);
+    if (stamps > (1u << 28))
+        throw std::runtime_error("Corrupt lif index");
+    sh->timeStamps.resize(stamps);
+    if (stamps && ! is.read(reinterpret_cast<char*>(sh->timeStamps.data()), stamps * sizeof(timestamp_t)))
+        throw std::runtime_error("Truncated lif index");
+    sh->setDurations();
+    const uint32_t settings = get<uint32_t>(is);
+    for (uint32_t ii = 0; ii < settings; ii++)
+    {
+        std::string key = get<std::string>(is);
+        ScannerSettingRecord r;
+        r.identifier = get<std::string>(is);
+        r.unit = get<std::string>(is);
+        r.description = get<std::string>(is);
+        r.data = get<int32_t>(is);
+        r.variant = get<std::string>(is);
+        r.variantType = get<int32_t>(is);
+        sh->scannerSettings.insert(make_pair(key, r));
+    }
+    return sh;
+}
+
+
 /** \brief Constructor from lif file name
  */
-lifIO::LifReader::LifReader(const string &filename)
+lifIO::LifReader::LifReader(const string &filename, bool mapped, bool indexed) : m_Valid(false), m_lif_file_size(0), m_from_index(false)
+{
+    m_path = filename;
+    
+    if (indexed && readIndex(filename))
+        m_from_index = true;
+    else
+    {
+        readFile(filename);
+        if (indexed && m_Valid)
+            writeIndex(filename);
+    }
+    
+    if (! m_Valid) return;
+    
+    // One descriptor serves all series' frame reads
+    m_pfile = LifPositionalFile::open(filename);
+    if (mapped)
+    {
+        m_mapping = LifMappedFile::map(filename);
+        if (! m_mapping)
+            std::cerr << "LifReader: could not map " << filename << ", reading frames from the file" << std::endl;
+    }
+    for (auto& serie : m_series)
+    {
+        serie->setPositionalFile(m_pfile);
+        serie->setMapping(m_mapping);
+    }
+}
+
+/** \brief read the XML header and locate the series' memory blocks
+ */
+void lifIO::LifReader::readFile(const string &filename)
 {
     const int MemBlockCode = 0x70, TestCode = 0x2a;
     char lifChar;
-    m_path = filename;
     
     bool ok = false;
     
@@ -487,12 +934,115 @@ lifIO::LifReader::LifReader(const string &filename)
                     this->m_header->getSerieHeader(s),
                     filename,
                                           m_fileRef->tellg(),
-                    memorySize));
+                    memorySize, m_lif_file_size));
             s++;
             //jump to the next memory block
             m_fileRef->seekg(static_cast<streampos>(memorySize),ios::cur);
         }
     }
+    
+}
+
+/** \brief load headers and serie locations from the index if it matches the file
+ */
+bool lifIO::LifReader::readIndex(const string &filename)
+{
+    uint64_t size;
+    int64_t mtime;
+    if (! file_key(filename, size, mtime)) return false;
+    std::ifstream is (index_path(filename), std::ifstream::in | std::ifstream::binary);
+    if (! is.is_open()) return false;
+    
+    try
+    {
+        if (get<uint32_t>(is) != index_magic || get<uint32_t>(is) != index_format) return false;
+        if (get<uint64_t>(is) != size || get<int64_t>(is) != mtime) return false;
+        
+        std::shared_ptr<LifHeader> header = LifHeader::readIndex(is);
+        const uint32_t count = get<uint32_t>(is);
+        if (count > header->getNbSeries()) return false;
+        std::vector<std::unique_ptr<LifSerie>> series;
+        for (uint32_t s = 0; s < count; s++)
+        {
+            const unsigned long long offset = get<uint64_t>(is);
+            const unsigned long long memorySize = get<uint64_t>(is);
+            series.push_back(std::make_unique<LifSerie>(header->getSerieHeader(s), filename, offset, memorySize, size));
+        }
+        m_header = header;
+        m_series = std::move(series);
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    
+    m_lif_file_size = size;
+    m_Valid = true;
+    return true;
+}
+
+/** \brief the XML header, read from the file on first call if the reader was built from the index
+ */
+const TiXmlDocument& lifIO::LifReader::getXMLHeader() const
+{
+    if (! m_from_index) return getLifHeader().getXMLHeader();
+    
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if (m_index_xmldoc) return *m_index_xmldoc;
+    m_index_xmldoc.reset(new TiXmlDocument);
+    
+    // Memory block code, block size and test code precede the header's character count
+    std::ifstream is (m_path, std::ifstream::in | std::ifstream::binary);
+    if (! is.is_open()) return *m_index_xmldoc;
+    is.seekg(9, ios::beg);
+    uint32_t xmlChars = 0;
+    is.read(reinterpret_cast<char*>(&xmlChars), sizeof(xmlChars));
+    if (! is.good() || 13 + 2 * static_cast<unsigned long long>(xmlChars) > m_lif_file_size)
+        return *m_index_xmldoc;
+    
+    std::vector<char> utf16 (2 * static_cast<size_t>(xmlChars));
+    is.read(utf16.data(), utf16.size());
+    if (! is.good()) return *m_index_xmldoc;
+    string xmlString;
+    xmlString.reserve(xmlChars);
+    for (size_t p = 0; p < xmlChars; ++p)
+        xmlString.push_back(utf16[2 * p]);
+    m_index_xmldoc->Parse(xmlString.c_str(), 0);
+    return *m_index_xmldoc;
+}
+
+/** \brief write the index next to the file. Failure only costs the next open a full parse
+ */
+void lifIO::LifReader::writeIndex(const string &filename) const
+{
+    uint64_t size;
+    int64_t mtime;
+    if (! file_key(filename, size, mtime)) return;
+    const std::string path = index_path(filename);
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream os (temp, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+        if (! os.is_open()) return;
+        put(os, index_magic);
+        put(os, index_format);
+        put(os, size);
+        put(os, mtime);
+        m_header->writeIndex(os);
+        put<uint32_t>(os, static_cast<uint32_t>(m_series.size()));
+        for (const auto& serie : m_series)
+        {
+            put<uint64_t>(os, serie->getOffset());
+            put<uint64_t>(os, serie->getMemorySize());
+        }
+        if (! os.good())
+        {
+            os.close();
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0)
+        std::remove(temp.c_str());
 }
 
 /** \brief read an int form file advancing the cursor*/
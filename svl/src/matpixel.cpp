@@ -85,6 +85,7 @@ void roiWindow<P>::randomFill( uint32_t seed )
     std::random_device rd;
     
     std::mt19937 _rng_generator(rd());
+    m_frame_buf->modified();
     
     for (int32_t j = 0; j < height(); j++) {
         pixel_ptr_t one = rowPointer (j);
@@ -101,6 +102,7 @@ void roiWindow<P>::randomFill( uint32_t seed )
 template <typename P>
 void root<P>::set(pixel_t val)
 {
+    modified();
     std::memset((void *)this->alignedPixelData(), val, this->n());
 }
 
@@ -108,6 +110,7 @@ void root<P>::set(pixel_t val)
 template <typename P>
 void roiWindow<P>::set(pixel_t val)
 {
+    m_frame_buf->modified();
     for (int32_t j = 0; j < height(); j++)
     {
         pixel_ptr_t row = rowPointer(j);
@@ -194,6 +197,7 @@ bool roiWindow<P>::copy_pixels_from(pixel_ptr_t pixels, int columns, int rows, i
 {
     bool sg = isBound() && pixels != nullptr && width() == columns && height() == rows;
     if (!sg) return !sg;
+    m_frame_buf->modified();
     pixel_ptr_t pels = pixels;
     if (increment != 1)
     {
@@ -310,17 +310,39 @@ namespace svl
     
     void cpCvMatToRoiWindow16U (const cv::Mat& m, roiWindow<P16U>& r){
         assert(m.type() == CV_16U);
-        auto rowPointer = [] (void* data, size_t step, int32_t row ) { return reinterpret_cast<void*>( reinterpret_cast<uint16_t*>(data) + row * step ); };
+        // step is in bytes
+        auto rowPointer = [] (void* data, size_t step, int32_t row ) { return reinterpret_cast<void*>( reinterpret_cast<uint8_t*>(data) + row * step ); };
         unsigned cols = m.cols;
         unsigned rows = m.rows;
         roiWindow<P16U> rw(cols,rows);
         for (auto row = 0; row < rows; row++) {
-            std::memcpy(rw.rowPointer(row), rowPointer(m.data, m.step, row), cols);
+            std::memcpy(rw.rowPointer(row), rowPointer(m.data, m.step, row), cols * sizeof(uint16_t));
         }
         r = rw;
     }
     
     
+    namespace {
+        template<typename P>
+        void refCvMatToRoiWindow (const cv::Mat& m, roiWindow<P>& r){
+            // The header copy shares the Mat's buffer and its reference count
+            auto owner = std::make_shared<cv::Mat>(m);
+            auto root = std::make_shared<typename roiWindow<P>::root_t>(owner, owner->data, int32_t(owner->step), owner->cols, owner->rows);
+            r = roiWindow<P>(root);
+        }
+    }
+    
+    void refCvMatToRoiWindow8U (const cv::Mat& m, roiWindow<P8U>& r){
+        assert(m.type() == CV_8U);
+        refCvMatToRoiWindow(m, r);
+    }
+    
+    void refCvMatToRoiWindow16U (const cv::Mat& m, roiWindow<P16U>& r){
+        assert(m.type() == CV_16U);
+        refCvMatToRoiWindow(m, r);
+    }
+    
+    
     //Function used to perform the complex DFT of a grayscale image
     //Input:  image
     //Output: DFT (complex numbers)
@@ -200,6 +200,31 @@ void Correlation::point(const roiWindow<P> & moving, const roiWindow<P> & fixed,
 }
 
 
+template <typename P>
+imageMoments Correlation::moments(const roiWindow<P> & image)
+{
+    typedef typename PixelType<P>::pixel_t pixel_t;
+    imageMoments im;
+    if (image.frameBuf()->cached_moments(image.bound(), im))
+        return im;
+    const uint64_t generation = image.frameBuf()->generation();
+    accumulateMoments<pixel_t>(image.rowPointer(0), image.rowPixelUpdate(), image.width(), image.height(), im);
+    image.frameBuf()->cache_moments(image.bound(), im, generation);
+    return im;
+}
+
+
+template <typename P>
+void Correlation::point(const roiWindow<P> & moving, const roiWindow<P> & fixed,
+                        const imageMoments & movingMoments, const imageMoments & fixedMoments, CorrelationParts & res)
+{
+    typedef typename PixelType<P>::pixel_t pixel_t;
+    crossCorrRowFunc<pixel_t> corrfunc(moving.rowPointer(0), fixed.rowPointer(0), moving.rowPixelUpdate(), fixed.rowPixelUpdate(), fixed.width(), fixed.height());
+    corrfunc.areaFunc();
+    corrfunc.epilog(movingMoments, fixedMoments, res);
+}
+
+
 template <typename P>
 bool Correlation::area_translation(const roiWindow<P> & moving, const roiWindow<P> & fixed, spaceResult& sres)
 {
@@ -283,6 +308,13 @@ bool Correlation::autoCorrelation(const roiWindow<P> & fixed, const uint32_t hal
 
 
 template void Correlation::point(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed, CorrelationParts & res);
+template void Correlation::point(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed,
+                                 const imageMoments &, const imageMoments &, CorrelationParts & res);
+template void Correlation::point(const roiWindow<P16U> & moving, const roiWindow<P16U> & fixed,
+                                 const imageMoments &, const imageMoments &, CorrelationParts & res);
+
+template imageMoments Correlation::moments(const roiWindow<P8U> & image);
+template imageMoments Correlation::moments(const roiWindow<P16U> & image);
 
 template bool Correlation::area_translation(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed, spaceResult& );
 
@@ -3,6 +3,16 @@
 #pragma GCC diagnostic ignored "-Wcomma"
 
 #include "vision/rowfunc.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SVL_CORR_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SVL_CORR_SSE2 1
+#endif
 
 SINGLETON_FCN(sSqrTable<uint8_t>, square_table);
 SINGLETON_FCN(sSqrTable<uint16_t>, square_table16);
@@ -30,7 +40,7 @@ void CorrelationParts::clear (){
 template <class T>
 basicCorrRowFunc<T>::basicCorrRowFunc(const T * baseA, const T * baseB, uint32_t rowPelsA, uint32_t rowPelsB,
                                       uint32_t width, uint32_t height, bool ffMaskOn)
-    :  mffMaskOn(ffMaskOn),mRUP(rowPelsA, rowPelsB)
+    :  mMaskPels(0), mffMaskOn(ffMaskOn), mUseSimd(simd_available()), mRUP(rowPelsA, rowPelsB)
 {
     rowFuncTwoSource<T>::mWidth = width;
     rowFuncTwoSource<T>::mHeight = height;
@@ -70,6 +80,16 @@ void basicCorrRowFunc<T>::prolog()
 template <class T>
 basicCorrRowFunc<T>::~basicCorrRowFunc() {}
 
+template <class T>
+bool basicCorrRowFunc<T>::simd_available()
+{
+#if defined(SVL_CORR_SSE2)
+    return true;
+#else
+    return false;
+#endif
+}
+
 
 // Pixel Map row functions
 
@@ -113,11 +133,491 @@ template <class T, class U>
 void pixelMap<T, U>::prolog() {}
 
 
+//
+// Vectorized row kernels
+//
+// The table based row functions accumulate Sim as the sum of (i+j)^2 and epilog recovers the cross
+// term from it. The kernels below accumulate the exact integer sums and produce the same (i+j)^2 sum,
+// including the modulo 2^32 wrap of the 16 bit square table, so the resulting CorrelationParts are
+// bit identical to the scalar path: every row sum is an integer well below 2^53 and therefore exact
+// in either representation.
+//
+namespace
+{
+    struct corrRowSums
+    {
+        uint64_t si, sm, sii, smm, sim;
+        uint32_t masked;
+        corrRowSums () : si(0), sm(0), sii(0), smm(0), sim(0), masked(0) {}
+    };
+    
+    inline void corr_row_tail (const uint8_t * a, const uint8_t * b, uint32_t n, bool mask, corrRowSums & s)
+    {
+        for (const uint8_t * pEnd = a + n; a < pEnd; ++a, ++b)
+        {
+            const uint32_t i = *a;
+            const uint32_t j = *b;
+            if (mask)
+            {
+                auto ii = (i == uint8_t(255)) ? 1 : 0;
+                ii += (j == uint8_t(255)) ? 1 : 0;
+                s.masked += ii;
+                if (ii != 0) continue;
+            }
+            s.si += i;
+            s.sm += j;
+            s.sii += i * i;
+            s.smm += j * j;
+            s.sim += (i + j) * (i + j);
+        }
+    }
+    
+    inline void corr_row_tail (const uint16_t * a, const uint16_t * b, uint32_t n, bool, corrRowSums & s)
+    {
+        for (const uint16_t * pEnd = a + n; a < pEnd; ++a, ++b)
+        {
+            const uint32_t i = *a;
+            const uint32_t j = *b;
+            s.si += i;
+            s.sm += j;
+            s.sii += i * i;
+            s.smm += j * j;
+            s.sim += uint32_t((i + j) * (i + j)); // wraps exactly as sSqrTable<uint16_t> does
+        }
+    }
+    
+    // 32 bit lanes are flushed to 64 bit totals every this many vectors.
+    // Worst case lane growth is 4 * 255^2 or 2 * 65535 per vector, well within 2^31 after 2048.
+    const uint32_t corr_flush_vectors = 2048;
+    
+#if defined(SVL_CORR_SSE2)
+    
+    inline uint64_t hsum_epi64 (__m128i v)
+    {
+        alignas(16) uint64_t lanes[2];
+        _mm_store_si128((__m128i*)lanes, v);
+        return lanes[0] + lanes[1];
+    }
+    
+    inline uint64_t hsum_epu32 (__m128i v)
+    {
+        alignas(16) uint32_t lanes[4];
+        _mm_store_si128((__m128i*)lanes, v);
+        return uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    
+    // Widen 4 unsigned 32 bit lanes and add them to a 2 x 64 bit accumulator
+    inline __m128i acc64 (__m128i acc, __m128i v, __m128i zero)
+    {
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+        return _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+    }
+    
+    void corr_row_sse2 (const uint8_t * a, const uint8_t * b, uint32_t width, bool mask, corrRowSums & s)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi8(char(0xFF));
+        const uint32_t vend = width & ~15u;
+        uint32_t x = 0;
+        
+        while (x < vend)
+        {
+            const uint32_t bend = std::min(vend, x + 16 * corr_flush_vectors);
+            __m128i si = zero, sm = zero, sii = zero, smm = zero, sij = zero;
+            for (; x < bend; x += 16)
+            {
+                __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+                __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+                if (mask)
+                {
+                    const __m128i ma = _mm_cmpeq_epi8(va, ones);
+                    const __m128i mb = _mm_cmpeq_epi8(vb, ones);
+                    s.masked += __builtin_popcount(_mm_movemask_epi8(ma)) + __builtin_popcount(_mm_movemask_epi8(mb));
+                    const __m128i m = _mm_or_si128(ma, mb);
+                    va = _mm_andnot_si128(m, va);
+                    vb = _mm_andnot_si128(m, vb);
+                }
+                si = _mm_add_epi64(si, _mm_sad_epu8(va, zero));
+                sm = _mm_add_epi64(sm, _mm_sad_epu8(vb, zero));
+                
+                const __m128i alo = _mm_unpacklo_epi8(va, zero);
+                const __m128i ahi = _mm_unpackhi_epi8(va, zero);
+                const __m128i blo = _mm_unpacklo_epi8(vb, zero);
+                const __m128i bhi = _mm_unpackhi_epi8(vb, zero);
+                sii = _mm_add_epi32(sii, _mm_add_epi32(_mm_madd_epi16(alo, alo), _mm_madd_epi16(ahi, ahi)));
+                smm = _mm_add_epi32(smm, _mm_add_epi32(_mm_madd_epi16(blo, blo), _mm_madd_epi16(bhi, bhi)));
+                sij = _mm_add_epi32(sij, _mm_add_epi32(_mm_madd_epi16(alo, blo), _mm_madd_epi16(ahi, bhi)));
+            }
+            const uint64_t bii = hsum_epu32(sii);
+            const uint64_t bmm = hsum_epu32(smm);
+            s.si += hsum_epi64(si);
+            s.sm += hsum_epi64(sm);
+            s.sii += bii;
+            s.smm += bmm;
+            s.sim += bii + bmm + 2 * hsum_epu32(sij);
+        }
+        corr_row_tail(a + x, b + x, width - x, mask, s);
+    }
+    
+    void corr_row_sse2 (const uint16_t * a, const uint16_t * b, uint32_t width, bool mask, corrRowSums & s)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const uint32_t vend = width & ~7u;
+        uint32_t x = 0;
+        
+        while (x < vend)
+        {
+            const uint32_t bend = std::min(vend, x + 8 * corr_flush_vectors);
+            __m128i si = zero, sm = zero, sii = zero, smm = zero, sim = zero;
+            for (; x < bend; x += 8)
+            {
+                const __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+                const __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+                si = _mm_add_epi32(si, _mm_add_epi32(_mm_unpacklo_epi16(va, zero), _mm_unpackhi_epi16(va, zero)));
+                sm = _mm_add_epi32(sm, _mm_add_epi32(_mm_unpacklo_epi16(vb, zero), _mm_unpackhi_epi16(vb, zero)));
+                
+                // Full 32 bit products from low and high 16 bit halves
+                const __m128i iil = _mm_mullo_epi16(va, va), iih = _mm_mulhi_epu16(va, va);
+                const __m128i mml = _mm_mullo_epi16(vb, vb), mmh = _mm_mulhi_epu16(vb, vb);
+                const __m128i ijl = _mm_mullo_epi16(va, vb), ijh = _mm_mulhi_epu16(va, vb);
+                const __m128i ii0 = _mm_unpacklo_epi16(iil, iih), ii1 = _mm_unpackhi_epi16(iil, iih);
+                const __m128i mm0 = _mm_unpacklo_epi16(mml, mmh), mm1 = _mm_unpackhi_epi16(mml, mmh);
+                const __m128i ij0 = _mm_unpacklo_epi16(ijl, ijh), ij1 = _mm_unpackhi_epi16(ijl, ijh);
+                
+                // (i+j)^2 modulo 2^32 per pixel
+                const __m128i sq0 = _mm_add_epi32(_mm_add_epi32(ii0, mm0), _mm_add_epi32(ij0, ij0));
+                const __m128i sq1 = _mm_add_epi32(_mm_add_epi32(ii1, mm1), _mm_add_epi32(ij1, ij1));
+                
+                sii = acc64(acc64(sii, ii0, zero), ii1, zero);
+                smm = acc64(acc64(smm, mm0, zero), mm1, zero);
+                sim = acc64(acc64(sim, sq0, zero), sq1, zero);
+            }
+            s.si += hsum_epu32(si);
+            s.sm += hsum_epu32(sm);
+            s.sii += hsum_epi64(sii);
+            s.smm += hsum_epi64(smm);
+            s.sim += hsum_epi64(sim);
+        }
+        corr_row_tail(a + x, b + x, width - x, mask, s);
+    }
+    
+#endif
+    
+#if defined(SVL_CORR_AVX2)
+    
+    inline uint64_t hsum_epi64 (__m256i v)
+    {
+        return hsum_epi64(_mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+    }
+    
+    inline uint64_t hsum_epu32 (__m256i v)
+    {
+        return hsum_epu32(_mm256_castsi256_si128(v)) + hsum_epu32(_mm256_extracti128_si256(v, 1));
+    }
+    
+    inline __m256i acc64 (__m256i acc, __m256i v, __m256i zero)
+    {
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(v, zero));
+        return _mm256_add_epi64(acc, _mm256_unpackhi_epi32(v, zero));
+    }
+    
+    // Unpacks are in-lane. Order does not matter for sums.
+    void corr_row_avx2 (const uint8_t * a, const uint8_t * b, uint32_t width, bool mask, corrRowSums & s)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi8(char(0xFF));
+        const uint32_t vend = width & ~31u;
+        uint32_t x = 0;
+        
+        while (x < vend)
+        {
+            const uint32_t bend = std::min(vend, x + 32 * corr_flush_vectors);
+            __m256i si = zero, sm = zero, sii = zero, smm = zero, sij = zero;
+            for (; x < bend; x += 32)
+            {
+                __m256i va = _mm256_loadu_si256((const __m256i*)(a + x));
+                __m256i vb = _mm256_loadu_si256((const __m256i*)(b + x));
+                if (mask)
+                {
+                    const __m256i ma = _mm256_cmpeq_epi8(va, ones);
+                    const __m256i mb = _mm256_cmpeq_epi8(vb, ones);
+                    s.masked += __builtin_popcount(uint32_t(_mm256_movemask_epi8(ma))) +
+                                __builtin_popcount(uint32_t(_mm256_movemask_epi8(mb)));
+                    const __m256i m = _mm256_or_si256(ma, mb);
+                    va = _mm256_andnot_si256(m, va);
+                    vb = _mm256_andnot_si256(m, vb);
+                }
+                si = _mm256_add_epi64(si, _mm256_sad_epu8(va, zero));
+                sm = _mm256_add_epi64(sm, _mm256_sad_epu8(vb, zero));
+                
+                const __m256i alo = _mm256_unpacklo_epi8(va, zero);
+                const __m256i ahi = _mm256_unpackhi_epi8(va, zero);
+                const __m256i blo = _mm256_unpacklo_epi8(vb, zero);
+                const __m256i bhi = _mm256_unpackhi_epi8(vb, zero);
+                sii = _mm256_add_epi32(sii, _mm256_add_epi32(_mm256_madd_epi16(alo, alo), _mm256_madd_epi16(ahi, ahi)));
+                smm = _mm256_add_epi32(smm, _mm256_add_epi32(_mm256_madd_epi16(blo, blo), _mm256_madd_epi16(bhi, bhi)));
+                sij = _mm256_add_epi32(sij, _mm256_add_epi32(_mm256_madd_epi16(alo, blo), _mm256_madd_epi16(ahi, bhi)));
+            }
+            const uint64_t bii = hsum_epu32(sii);
+            const uint64_t bmm = hsum_epu32(smm);
+            s.si += hsum_epi64(si);
+            s.sm += hsum_epi64(sm);
+            s.sii += bii;
+            s.smm += bmm;
+            s.sim += bii + bmm + 2 * hsum_epu32(sij);
+        }
+        corr_row_sse2(a + x, b + x, width - x, mask, s);
+    }
+    
+    void corr_row_avx2 (const uint16_t * a, const uint16_t * b, uint32_t width, bool mask, corrRowSums & s)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const uint32_t vend = width & ~15u;
+        uint32_t x = 0;
+        
+        while (x < vend)
+        {
+            const uint32_t bend = std::min(vend, x + 16 * corr_flush_vectors);
+            __m256i si = zero, sm = zero, sii = zero, smm = zero, sim = zero;
+            for (; x < bend; x += 16)
+            {
+                const __m256i va = _mm256_loadu_si256((const __m256i*)(a + x));
+                const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + x));
+                si = _mm256_add_epi32(si, _mm256_add_epi32(_mm256_unpacklo_epi16(va, zero), _mm256_unpackhi_epi16(va, zero)));
+                sm = _mm256_add_epi32(sm, _mm256_add_epi32(_mm256_unpacklo_epi16(vb, zero), _mm256_unpackhi_epi16(vb, zero)));
+                
+                const __m256i iil = _mm256_mullo_epi16(va, va), iih = _mm256_mulhi_epu16(va, va);
+                const __m256i mml = _mm256_mullo_epi16(vb, vb), mmh = _mm256_mulhi_epu16(vb, vb);
+                const __m256i ijl = _mm256_mullo_epi16(va, vb), ijh = _mm256_mulhi_epu16(va, vb);
+                const __m256i ii0 = _mm256_unpacklo_epi16(iil, iih), ii1 = _mm256_unpackhi_epi16(iil, iih);
+                const __m256i mm0 = _mm256_unpacklo_epi16(mml, mmh), mm1 = _mm256_unpackhi_epi16(mml, mmh);
+                const __m256i ij0 = _mm256_unpacklo_epi16(ijl, ijh), ij1 = _mm256_unpackhi_epi16(ijl, ijh);
+                
+                const __m256i sq0 = _mm256_add_epi32(_mm256_add_epi32(ii0, mm0), _mm256_add_epi32(ij0, ij0));
+                const __m256i sq1 = _mm256_add_epi32(_mm256_add_epi32(ii1, mm1), _mm256_add_epi32(ij1, ij1));
+                
+                sii = acc64(acc64(sii, ii0, zero), ii1, zero);
+                smm = acc64(acc64(smm, mm0, zero), mm1, zero);
+                sim = acc64(acc64(sim, sq0, zero), sq1, zero);
+            }
+            s.si += hsum_epu32(si);
+            s.sm += hsum_epu32(sm);
+            s.sii += hsum_epi64(sii);
+            s.smm += hsum_epi64(smm);
+            s.sim += hsum_epi64(sim);
+        }
+        corr_row_sse2(a + x, b + x, width - x, mask, s);
+    }
+    
+#endif
+    
+    // Cross term only: sum of i * j
+    template <typename T>
+    inline uint64_t cross_row_tail (const T * a, const T * b, uint32_t n)
+    {
+        uint64_t sij = 0;
+        for (const T * pEnd = a + n; a < pEnd; ++a, ++b)
+            sij += uint32_t(*a) * uint32_t(*b);
+        return sij;
+    }
+    
+#if defined(SVL_CORR_SSE2)
+    uint64_t cross_row_sse2 (const uint8_t * a, const uint8_t * b, uint32_t width)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const uint32_t vend = width & ~15u;
+        uint32_t x = 0;
+        uint64_t sij = 0;
+        while (x < vend)
+        {
+            const uint32_t bend = std::min(vend, x + 16 * corr_flush_vectors);
+            __m128i acc = zero;
+            for (; x < bend; x += 16)
+            {
+                const __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+                const __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+                acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)),
+                                                       _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero))));
+            }
+            sij += hsum_epu32(acc);
+        }
+        return sij + cross_row_tail(a + x, b + x, width - x);
+    }
+    
+    uint64_t cross_row_sse2 (const uint16_t * a, const uint16_t * b, uint32_t width)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const uint32_t vend = width & ~7u;
+        uint32_t x = 0;
+        __m128i acc = zero;
+        for (; x < vend; x += 8)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+            const __m128i lo = _mm_mullo_epi16(va, vb), hi = _mm_mulhi_epu16(va, vb);
+            acc = acc64(acc64(acc, _mm_unpacklo_epi16(lo, hi), zero), _mm_unpackhi_epi16(lo, hi), zero);
+        }
+        return hsum_epi64(acc) + cross_row_tail(a + x, b + x, width - x);
+    }
+#endif
+    
+#if defined(SVL_CORR_AVX2)
+    uint64_t cross_row_avx2 (const uint8_t * a, const uint8_t * b, uint32_t width)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const uint32_t vend = width & ~31u;
+        uint32_t x = 0;
+        uint64_t sij = 0;
+        while (x < vend)
+        {
+            const uint32_t bend = std::min(vend, x + 32 * corr_flush_vectors);
+            __m256i acc = zero;
+            for (; x < bend; x += 32)
+            {
+                const __m256i va = _mm256_loadu_si256((const __m256i*)(a + x));
+                const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + x));
+                acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero)),
+                                                             _mm256_madd_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero))));
+            }
+            sij += hsum_epu32(acc);
+        }
+        return sij + cross_row_sse2(a + x, b + x, width - x);
+    }
+    
+    uint64_t cross_row_avx2 (const uint16_t * a, const uint16_t * b, uint32_t width)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const uint32_t vend = width & ~15u;
+        uint32_t x = 0;
+        __m256i acc = zero;
+        for (; x < vend; x += 16)
+        {
+            const __m256i va = _mm256_loadu_si256((const __m256i*)(a + x));
+            const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + x));
+            const __m256i lo = _mm256_mullo_epi16(va, vb), hi = _mm256_mulhi_epu16(va, vb);
+            acc = acc64(acc64(acc, _mm256_unpacklo_epi16(lo, hi), zero), _mm256_unpackhi_epi16(lo, hi), zero);
+        }
+        return hsum_epi64(acc) + cross_row_sse2(a + x, b + x, width - x);
+    }
+#endif
+    
+    template <typename T>
+    inline uint64_t cross_row (const T * a, const T * b, uint32_t width)
+    {
+#if defined(SVL_CORR_AVX2)
+        return cross_row_avx2(a, b, width);
+#elif defined(SVL_CORR_SSE2)
+        return cross_row_sse2(a, b, width);
+#else
+        return cross_row_tail(a, b, width);
+#endif
+    }
+    
+    template <typename T>
+    inline void corr_row (const T * a, const T * b, uint32_t width, bool mask, corrRowSums & s)
+    {
+#if defined(SVL_CORR_AVX2)
+        corr_row_avx2(a, b, width, mask, s);
+#elif defined(SVL_CORR_SSE2)
+        corr_row_sse2(a, b, width, mask, s);
+#else
+        corr_row_tail(a, b, width, mask, s);
+#endif
+    }
+}
+
+
+template <class T>
+void accumulateMoments (const T * base, uint32_t rowPels, uint32_t width, uint32_t height, imageMoments & moments)
+{
+    corrRowSums sums;
+    for (uint32_t row = 0; row < height; row++, base += rowPels)
+        corr_row(base, base, width, false, sums);
+    moments.sum = sums.si;
+    moments.sumsq = sums.sii;
+    moments.n = width * height;
+}
+
+
+//
+// crossCorrRowFunc class implementation
+//
+template <class T>
+crossCorrRowFunc<T>::crossCorrRowFunc(const T * baseA, const T * baseB, uint32_t rowPelsA, uint32_t rowPelsB,
+                                      uint32_t width, uint32_t height)
+    : mSim(0), mRUP(rowPelsA, rowPelsB)
+{
+    rowFuncTwoSource<T>::mWidth = width;
+    rowFuncTwoSource<T>::mHeight = height;
+    rowFuncTwoSource<T>::mFirst = baseA;
+    rowFuncTwoSource<T>::mSecond = baseB;
+}
+
+template <class T>
+void crossCorrRowFunc<T>::prolog()
+{
+}
+
+template <class T>
+crossCorrRowFunc<T>::~crossCorrRowFunc() {}
+
+template <class T>
+void crossCorrRowFunc<T>::rowFunc()
+{
+    mSim += cross_row(rowFuncTwoSource<T>::mFirst, rowFuncTwoSource<T>::mSecond, rowFuncTwoSource<T>::mWidth);
+    rowFuncTwoSource<T>::mFirst += mRUP.first;
+    rowFuncTwoSource<T>::mSecond += mRUP.second;
+}
+
+template <class T>
+void crossCorrRowFunc<T>::areaFunc()
+{
+    uint32_t height = rowFuncTwoSource<T>::mHeight;
+    
+    do
+    {
+        rowFunc();
+    } while (--height);
+}
+
+template <class T>
+void crossCorrRowFunc<T>::epilog(const imageMoments & a, const imageMoments & b, CorrelationParts & res)
+{
+    assert(a.n == rowFuncTwoSource<T>::mWidth * rowFuncTwoSource<T>::mHeight && a.n == b.n);
+    CorrelationParts::sumproduct_t Si(a.sum), Sm(b.sum), Sii(a.sumsq), Smm(b.sumsq), Sim(mSim);
+    CorrelationParts parts;
+    parts.accumulate(Sim, Sii, Smm, Si, Sm);
+    parts.n (a.n);
+    parts.compute();
+    res = parts;
+}
+
+
 //
 // rcBasicCorrRowFunc class implementation
 //
+template <class T>
+void basicCorrRowFunc<T>::rowFunc()
+{
+    if (! mUseSimd)
+    {
+        rowFuncScalar();
+        return;
+    }
+    
+    corrRowSums sums;
+    corr_row(rowFuncTwoSource<T>::mFirst, rowFuncTwoSource<T>::mSecond, rowFuncTwoSource<T>::mWidth, mffMaskOn, sums);
+    mMaskPels += sums.masked;
+    
+    CorrelationParts::sumproduct_t Si(sums.si), Sm(sums.sm), Sim(sums.sim), Smm(sums.smm), Sii(sums.sii);
+    mRes.accumulate(Sim, Sii, Smm, Si, Sm);
+    
+    rowFuncTwoSource<T>::mFirst += mRUP.first;
+    rowFuncTwoSource<T>::mSecond += mRUP.second;
+}
+
 template <>
-inline void basicCorrRowFunc<uint8_t>::rowFunc()
+inline void basicCorrRowFunc<uint8_t>::rowFuncScalar()
 {
     CorrelationParts::sumproduct_t Si(0), Sm(0), Sim(0), Smm(0), Sii(0);
     const uint8_t * pFirst(mFirst);
@@ -187,7 +687,7 @@ inline void pixelMap<uint8_t, uint8_t>::rowFunc()
 
 
 template <>
-inline void basicCorrRowFunc<uint16_t>::rowFunc()
+inline void basicCorrRowFunc<uint16_t>::rowFuncScalar()
 {
     CorrelationParts::sumproduct_t Si(0), Sm(0), Sim(0), Smm(0), Sii(0);
     const uint16_t * pFirst(mFirst);
@@ -236,6 +736,12 @@ template class sSqrTable<uint16_t>;
 template class basicCorrRowFunc<uint8_t>;
 template class basicCorrRowFunc<uint16_t>;
 
+template class crossCorrRowFunc<uint8_t>;
+template class crossCorrRowFunc<uint16_t>;
+
+template void accumulateMoments (const uint8_t *, uint32_t, uint32_t, uint32_t, imageMoments &);
+template void accumulateMoments (const uint16_t *, uint32_t, uint32_t, uint32_t, imageMoments &);
+
 
 template class pixelMap<uint8_t, uint8_t>;
 template class pixelMap<uint16_t, uint8_t>;
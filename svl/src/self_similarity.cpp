@@ -12,21 +12,32 @@
 #include "vision/registration.h"
 #include "vision/rowfunc.h"
 #include "core/svl_exception.hpp"
+#include "core/thread_pool.hpp"
 #include <vector>
 #include <deque>
 #include <iterator>
 #include <functional>
 #include <thread>
+#include <mutex>
+#include <atomic>
+
+// Gram matrix products of the batch fill go to Accelerate's BLAS where available
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#define SVL_GRAM_CBLAS 1
+#endif
 
 namespace defaultMatchers
 {
     
-    double norm_correlate(const roiWindow<P8U>& i, const roiWindow<P8U>& m)
+    template<typename P>
+    double norm_correlate(const roiWindow<P>& i, const roiWindow<P>& m)
     {
         CorrelationParts cp;
         
         // @todo support mask
-        Correlation::point(i, m, cp);
+        // Per image sums are cached with the images, only the cross term is computed per pair
+        Correlation::point(i, m, Correlation::moments(i), Correlation::moments(m), cp);
         return cp.r();
     }
     
@@ -81,9 +92,10 @@ void self_similarity_producer<P>::norm_scale (const std::deque<double>& src, std
 
 template<typename P>
 self_similarity_producer<P>::self_similarity_producer() : _matrixSz (0), _maskValid(false), _cacheSz (0),
-_depth (P::depth()),  _notify(NULL), _finished(true), _tiny(1e-10)
+_depth (P::depth()),  _notify(NULL), _finished(true), _tiny(1e-10), _head(0), _streaming(false), _batch(false), _since_refresh(0)
 {
-    _corr_fn = std::bind(&defaultMatchers::norm_correlate, std::placeholders::_1, std::placeholders::_2);
+    _default_corr = true;
+    _corr_fn = std::bind(&defaultMatchers::norm_correlate<P>, std::placeholders::_1, std::placeholders::_2);
     
 }
 
@@ -94,13 +106,14 @@ self_similarity_producer<P>::self_similarity_producer(uint32_t matrixSz,
                                                       const similarity_fn_t& simFunc,
                                                       bool notify,
                                                       double tiny)
-: _maskValid(false),  _matrixSz(matrixSz),
+: _progress_fn(progFunc), _maskValid(false),  _matrixSz(matrixSz),
 _cacheSz(cacheSz),
 _notify(notify), _finished(true),
-_tiny(tiny)
+_tiny(tiny), _head(0), _streaming(false), _batch(false), _since_refresh(0)
 {
     
-    _corr_fn = (simFunc) ? simFunc : std::bind(&defaultMatchers::norm_correlate, std::placeholders::_1, std::placeholders::_2);
+    _default_corr = ! simFunc;
+    _corr_fn = (simFunc) ? simFunc : std::bind(&defaultMatchers::norm_correlate<P>, std::placeholders::_1, std::placeholders::_2);
     
     _depth = P::depth();
     _log2MSz = log2(_matrixSz);
@@ -114,8 +127,10 @@ template<typename P>
 self_similarity_producer<P>::self_similarity_producer(uint32_t matrixSz,
                                                       bool notify,
                                                       double tiny)
-: _maskValid(false), _matrixSz(matrixSz), _notify(notify), _finished(true),_tiny(tiny), _cacheSz (matrixSz)
+: _maskValid(false), _matrixSz(matrixSz), _notify(notify), _finished(true),_tiny(tiny), _cacheSz (matrixSz),
+_head(0), _streaming(false), _batch(false), _since_refresh(0)
 {
+    _default_corr = false;
     _depth = P::depth();
     _log2MSz = log2(_matrixSz);
 }
@@ -248,7 +263,29 @@ bool self_similarity_producer<P>::selfSimilarityMatrix(deque<deque<double> >& ma
     assert(_matrixSz);
     
     if (_finished && !m_entropies.empty() && !_SMatrix.empty()) {
-        matrix = _SMatrix;
+        matrix.resize(_matrixSz);
+        for (uint32_t i = 0; i < _matrixSz; i++) {
+            matrix[i].resize(_matrixSz);
+            for (uint32_t j = 0; j < _matrixSz; j++)
+                matrix[i][j] = sm(i, j);
+        }
+        return true;
+    }
+    
+    return false;
+}
+
+template<typename P>
+bool self_similarity_producer<P>::selfSimilarityMatrix(svl::symmetric_matrix<double>& matrix) const
+{
+    assert(_matrixSz);
+    
+    if (_finished && !m_entropies.empty() && !_SMatrix.empty()) {
+        matrix = svl::symmetric_matrix<double>(_matrixSz);
+        double* dst = matrix.mutable_data();
+        for (uint32_t i = 0; i < _matrixSz; i++)
+            for (uint32_t j = 0; j < _matrixSz; j++)
+                *dst++ = sm(i, j);
         return true;
     }
     
@@ -270,6 +307,10 @@ bool self_similarity_producer<P>::internalFill(Iterator start, Iterator end,  de
     }
     
     
+    _head = 0;
+    _rowSums.clear();
+    _rowXlogX.clear();
+    
     if (tWin.empty()) {
         if (!_SMatrix.empty())
             _SMatrix.resize(0);
@@ -277,16 +318,7 @@ bool self_similarity_producer<P>::internalFill(Iterator start, Iterator end,  de
         return false;
     }
     
-    if (_SMatrix.empty()) {
-        _SMatrix.resize(_matrixSz);
-        for (uint32_t i = 0; i < _matrixSz; i++)
-            _SMatrix[i].resize(_matrixSz);
-    }
-    else {
-        assert(_SMatrix.size() == _matrixSz);
-        for (uint32_t i = 0; i < _matrixSz; i++)
-            assert(_SMatrix[i].size() == _matrixSz);
-    }
+    allocate();
     
     /* Initialize identity diagonal of _SMatrix.
      */
@@ -323,7 +355,7 @@ bool self_similarity_producer<P>::median_levelset_similarities (deque<double>& s
                 // get the index
                 auto jj = m_median_ranked[index];
                 // fetch the cross match value for
-                val += _SMatrix[jj][ii];
+                val += sm(jj, ii);
             }
             signal[ii] = val;
         }
@@ -337,107 +369,184 @@ bool self_similarity_producer<P>::median_levelset_similarities (deque<double>& s
 template <typename P>
 bool self_similarity_producer<P>::ssMatrixFill(deque<image_t >& tWin)
 {
-    assert(_SMatrix.size() == _matrixSz);
+    assert(_SMatrix.size() == _matrixSz * _matrixSz);
     
-    auto tWinSz = tWin.size();
+    const int32_t tWinSz = static_cast<int32_t>(tWin.size());
     assert(tWinSz <= (int32_t)_matrixSz);
+    if (tWinSz < 2) return true;
     
-    auto cacheSz = _cacheSz;
-    if (cacheSz <= 2)
-        cacheSz = tWinSz + 2;
-    auto cacheBlkSz = cacheSz - 2;
-    
+    if (_batch && ssMatrixFillBatch(tWin))
+        return true;
     
-    /* The following was designed to work well when the number of images
-     * that can be stored in memory at any one time is space limited.
-     * In the absence of other consumers of cache resources, it reads in
-     * O((N^2)/C) images from disk, where N is the number of images in
-     * the movie fifo and C is the count of cache entries available.
-     * The basic algorithm works as follows:
-     *
-     * Step 1 - Use the first cache block size number of images
-     * remaining and perform cross correlations on all of them.
-     *
-     * Step 2 - For all the remaining images, read in one image at a
-     * time, correlating each with every image from step 1 before moving
-     * on to the next image.
-     *
-     * Note: In both steps 1) and 2), passes through the cached images
-     * are done in alternating directions to guarantee that the most
-     * recently used images get processed first. This is done to make
-     * performance degradation more linear in the presence of other
-     * consumers of the cache. In particular, it limits pathological
-     * cases where reading needed images into the cache causes other
-     * needed images to be flushed from the cache before they get
-     * used. Note that this assumes an LRU type caching policy.
-     *
-     * Step 3 - Update the current starting point by the cache block
-     * size.
+    /* The upper triangle is split in to square tiles of frame pairs. Every correlation
+     * is independent and every tile writes its own cells of _SMatrix, so tiles run in
+     * any order on the pool and the result is deterministic.
      *
-     * Repeat the entire process until the new starting point is >= the
-     * fifo size.
+     * A tile touches 2 * tile frames, sized so that they stay in the per core cache and
+     * are re-used tile times each. Tiles are made smaller when there would not be enough
+     * of them to keep the pool busy.
      */
-    for (int32_t i = 0; i < tWinSz;
-         /* Step 3 - Update start */ i += cacheBlkSz) {
-        int32_t cacheIncr = 1, cacheBegin, cacheEnd;
-        auto firstUncachedFrame = i + cacheBlkSz;
-        if (firstUncachedFrame > tWinSz)
-            firstUncachedFrame = tWinSz;
-        
-        
-        /* Step 1 - Fill cache.
-         */
-        for (int32_t j = i + 1; j < firstUncachedFrame; j++) {
-            if (cacheIncr == 1) {
-                cacheIncr = -1;	cacheBegin = j - 1; cacheEnd = i - 1;
-            }
-            else {
-                cacheIncr = 1;	cacheBegin = i; cacheEnd = j;
-            }
-
-            if (_progress_fn != nullptr) _progress_fn(_fraction_done);
-            
-            for (int32_t k = cacheBegin; k != cacheEnd; k += cacheIncr) {
-                assert((j >= 0) && (j < tWinSz));
-                assert((k >= 0) && (k < tWinSz));
+    auto& pool = svl::thread_pool::global();
+    int32_t tile = static_cast<int32_t>(_cacheSz > 2 ? _cacheSz - 2 : 0);
+    if (tile == 0)
+    {
+        const size_t frame_bytes = std::max(size_t(1), size_t(tWin[0].n()) * tWin[0].bytes());
+        const size_t budget = 1 << 20;
+        tile = static_cast<int32_t>(std::min(size_t(32), std::max(size_t(2), budget / (2 * frame_bytes))));
+    }
+    auto tile_count = [tWinSz] (int32_t t) { auto b = (tWinSz + t - 1) / t; return size_t(b * (b + 1) / 2); };
+    while (tile > 1 && tile_count(tile) < 4 * size_t(pool.size()))
+        tile /= 2;
+    
+    std::vector<std::pair<int32_t, int32_t> > tiles;
+    for (int32_t rb = 0; rb < tWinSz; rb += tile)
+        for (int32_t cb = rb; cb < tWinSz; cb += tile)
+            tiles.emplace_back(rb, cb);
+    
+    std::mutex stats_mutex;
+    std::atomic<size_t> pairs_done (0);
+    const float fraction_base = _fraction_done;
+    
+    auto run_tile = [&] (size_t tt) {
+        const int32_t rb = tiles[tt].first;
+        const int32_t cb = tiles[tt].second;
+        const int32_t re = std::min(rb + tile, tWinSz);
+        const int32_t ce = std::min(cb + tile, tWinSz);
+        svl::stats<float> times;
+        size_t pairs = 0;
+        for (int32_t j = rb; j < re; j++)
+            for (int32_t k = std::max(cb, j + 1); k < ce; k++, pairs++)
+            {
                 chronometer timeit;
                 const double r = _corr_fn (tWin[j], tWin[k]);
-                _fraction_done += _single_weight;
-                _corrTimes.add((float) timeit.getTime ());
-                _SMatrix[j][k] = _SMatrix[k][j] = r;
-            } // End of: for ( k = cacheBegin; k != cacheEnd; k += cacheIncr)
-              //  tWin[j].frameBuf().unlock();
-        } // End of: for (int32_t j = i + 1; j < firstUncachedFrame; j++)
-        
-        /* Step 2 - Correlate remaining images against cached images.
-         */
-        for (auto j = firstUncachedFrame; j < tWinSz; j++) {
-            if (cacheIncr == 1) {
-                cacheIncr = -1;	cacheBegin = int32_t(firstUncachedFrame)-1; cacheEnd = i-1;
-            }
-            else {
-                cacheIncr = 1; cacheBegin = i; cacheEnd = int32_t(firstUncachedFrame);
+                times.add((float) timeit.getTime ());
+                sm(j, k) = sm(k, j) = r;
             }
-            
-            for (int32_t k = cacheBegin; k != cacheEnd; k += cacheIncr) {
-                assert((j >= 0) && (j < tWinSz));
-                assert((k >= 0) && (k < tWinSz));
-                chronometer timeit;
-                const double r = _corr_fn(tWin[j], tWin[k]);
-                _fraction_done += _single_weight;
-                _corrTimes.add((float) timeit.getTime ());
-                _SMatrix[j][k] = _SMatrix[k][j] = r;
-            } // End of: for (k = cacheBegin; k != cacheEnd; k += cacheIncr)
-              // tWin[j].frameBuf().unlock();
-        } // End of: for (int32_t j = i + 1; j < firstUncachedFrame; j++)
-    }
+        pairs_done += pairs;
+        std::lock_guard<std::mutex> lk (stats_mutex);
+        _corrTimes += times;
+    };
     
+    progress_fn_t report;
+    if (_progress_fn != nullptr)
+        report = [this, fraction_base, &pairs_done] (float) { _progress_fn(fraction_base + pairs_done * _single_weight); };
     
+    pool.parallel_for(tiles.size(), run_tile, report);
+    _fraction_done = fraction_base + pairs_done * _single_weight;
     
     return true;
 }
 
 
+/*
+ * With A holding the frames as rows, each centered by its mean and scaled to unit L2 norm
+ *     (A A')(j,k) = sum (i - mean i) (m - mean m) / sqrt (sum (i - mean i)^2 sum (m - mean m)^2)
+ * and its square is the r of CorrelationParts. With BLAS each row band of the upper triangle
+ * is one GEMM per pool job, otherwise row blocks of A are multiplied pairwise over the upper
+ * triangle with Eigen, one block pair per pool job.
+ */
+template <typename P>
+bool self_similarity_producer<P>::ssMatrixFillBatch(deque<image_t >& tWin)
+{
+    typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> frames_t;
+    
+    if (_maskValid || !_default_corr) return false;
+    
+    const int32_t tWinSz = static_cast<int32_t>(tWin.size());
+    const int32_t width = tWin[0].width();
+    const int32_t height = tWin[0].height();
+    for (const auto& img : tWin)
+        if (img.width() != width || img.height() != height) return false;
+    
+    const typename frames_t::Index n = typename frames_t::Index(width) * height;
+    if (n == 0) return false;
+    
+    frames_t A;
+    try
+    {
+        A.resize(tWinSz, n);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return false;
+    }
+    
+    auto& pool = svl::thread_pool::global();
+    pool.parallel_for(size_t(tWinSz), [&] (size_t ff) {
+        const image_t& img = tWin[ff];
+        const imageMoments im = Correlation::moments(img);
+        const double mean = double(im.sum) / im.n;
+        const double ss = double(im.sumsq) - double(im.sum) * mean;
+        // A flat frame correlates with nothing, its row stays zero
+        const double scale = ss > 0 ? 1.0 / std::sqrt(ss) : 0.0;
+        float* dst = A.row(ff).data();
+        for (int32_t y = 0; y < height; y++)
+        {
+            const typename P::value_type* src = img.rowPointer(y);
+            for (int32_t x = 0; x < width; x++)
+                *dst++ = static_cast<float>((src[x] - mean) * scale);
+        }
+    });
+    
+    std::atomic<size_t> pairs_done (0);
+    const float fraction_base = _fraction_done;
+    
+    // r from the cosine, zero goes to tiny like CorrelationParts does
+    auto store = [this] (int32_t j, int32_t k, double cosine) {
+        double r = cosine * cosine;
+        r = svl::equal(r, 0.0) ? _tiny : r;
+        sm(j, k) = sm(k, j) = r;
+    };
+    
+    progress_fn_t report;
+    if (_progress_fn != nullptr)
+        report = [this, fraction_base, &pairs_done] (float) { _progress_fn(fraction_base + pairs_done * _single_weight); };
+    
+    const int32_t block = 64;
+#ifdef SVL_GRAM_CBLAS
+    // Row bands of the upper triangle, a band times the frames from its first row on is one GEMM
+    auto run_band = [&] (size_t bb) {
+        const int32_t rb = int32_t(bb) * block;
+        const int32_t rn = std::min(block, tWinSz - rb);
+        const int32_t cn = tWinSz - rb;
+        std::vector<float> gram (size_t(rn) * cn);
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, rn, cn, int(n), 1.0f, A.row(rb).data(), int(n),
+                    A.row(rb).data(), int(n), 0.0f, gram.data(), cn);
+        size_t pairs = 0;
+        for (int32_t j = 0; j < rn; j++)
+            for (int32_t k = j + 1; k < cn; k++, pairs++)
+                store(rb + j, rb + k, gram[size_t(j) * cn + k]);
+        pairs_done += pairs;
+    };
+    
+    pool.parallel_for(size_t((tWinSz + block - 1) / block), run_band, report);
+#else
+    std::vector<std::pair<int32_t, int32_t> > blocks;
+    for (int32_t rb = 0; rb < tWinSz; rb += block)
+        for (int32_t cb = rb; cb < tWinSz; cb += block)
+            blocks.emplace_back(rb, cb);
+    
+    auto run_block = [&] (size_t bb) {
+        const int32_t rb = blocks[bb].first;
+        const int32_t cb = blocks[bb].second;
+        const int32_t rn = std::min(block, tWinSz - rb);
+        const int32_t cn = std::min(block, tWinSz - cb);
+        Eigen::MatrixXf gram (rn, cn);
+        gram.noalias() = A.middleRows(rb, rn) * A.middleRows(cb, cn).transpose();
+        size_t pairs = 0;
+        for (int32_t j = 0; j < rn; j++)
+            for (int32_t k = (rb == cb ? j + 1 : 0); k < cn; k++, pairs++)
+                store(rb + j, cb + k, gram(j, k));
+        pairs_done += pairs;
+    };
+    
+    pool.parallel_for(blocks.size(), run_block, report);
+#endif
+    _fraction_done = fraction_base + pairs_done * _single_weight;
+    
+    return true;
+}
+
 
 template <typename P>
 bool self_similarity_producer<P>::internalUpdate(image_t& nextImage, deque<image_t >& tWin)
@@ -450,15 +559,7 @@ bool self_similarity_producer<P>::internalUpdate(image_t& nextImage, deque<image
         shiftSMatrix();
     }
     
-    if (_SMatrix.empty()) {
-        _SMatrix.resize(_matrixSz);
-        for (uint32_t i = 0; i < _matrixSz; i++)
-            _SMatrix[i].resize(_matrixSz);
-        
-        assert(_SMatrix.size() == _matrixSz);
-        for (uint32_t i = 0; i < _matrixSz; i++)
-            assert(_SMatrix[i].size() == _matrixSz);
-    }
+    allocate();
     
     tWin.push_back(nextImage);
     // nextImage.frameBuf().unlock();
@@ -467,30 +568,55 @@ bool self_similarity_producer<P>::internalUpdate(image_t& nextImage, deque<image
      * if longtermCache is on, write the last similarity rank value to the cache line
      */
     
-    bool rtn = (_finished=ssMatrixUpdate(tWin)) && genMatrixEntropy(tWin.size());
+    if (!(_finished = ssMatrixUpdate(tWin)))
+        return false;
     
+    if (!_streaming || tWin.size() != _matrixSz)
+        return genMatrixEntropy(tWin.size());
     
-    return rtn;
+    /* Streaming: the row aggregates were revised for the outgoing and incoming frames.
+     * Re-derive them from the matrix when first full and every matrix size updates
+     * to keep round off from accumulating.
+     */
+    if (_rowSums.size() != _matrixSz || ++_since_refresh >= _matrixSz)
+        refreshRowTerms();
+    
+    return streamMatrixEntropy();
 }
 
 
+template<typename P>
+void self_similarity_producer<P>::allocate()
+{
+    if (_SMatrix.size() != _matrixSz * _matrixSz)
+    {
+        _SMatrix.assign(_matrixSz * _matrixSz, 0.0);
+        _head = 0;
+    }
+}
+
 
 template<typename P>
 void self_similarity_producer<P>::shiftSMatrix()
 {
-    if (_SMatrix.size() != _matrixSz)
+    if (_SMatrix.size() != _matrixSz * _matrixSz)
         throw svl::assertion_error("Similarity Engine Failure");
     
-    _SMatrix.pop_front();
-    
-    for (uint32_t i = 0; i < (_matrixSz - 1); i++) {
-        _SMatrix[i].pop_front();
-        _SMatrix[i].push_back(-1.0);
+    /* Remove the outgoing frame's contribution from every other frame's row terms.
+     * Its slot becomes the last logical row and column and is overwritten by the
+     * incoming frame's correlations.
+     */
+    if (_rowSums.size() == _matrixSz) {
+        const size_t out = slot(0);
+        for (size_t q = 0; q < _matrixSz; q++) {
+            if (q == out) continue;
+            const double r = _SMatrix[q * _matrixSz + out];
+            _rowSums[q] -= r;
+            _rowXlogX[q] -= xlogx(r);
+        }
     }
     
-    deque<double> empty;
-    _SMatrix.push_back(empty);
-    _SMatrix.back().resize(_matrixSz);
+    _head = (_head + 1) % _matrixSz;
 }
 
 
@@ -499,7 +625,7 @@ void self_similarity_producer<P>::shiftSMatrix()
 template<typename P>
 bool self_similarity_producer<P>::ssMatrixUpdate(deque<image_t>& tWin)
 {
-    assert(_SMatrix.size() == _matrixSz);
+    assert(_SMatrix.size() == _matrixSz * _matrixSz);
     assert(!tWin.empty());
     
     const auto lastImgIndex = tWin.size() - 1;
@@ -507,12 +633,32 @@ bool self_similarity_producer<P>::ssMatrixUpdate(deque<image_t>& tWin)
     
     if (_progress_fn != nullptr) _progress_fn(_fraction_done);
 
-    _SMatrix[lastImgIndex][lastImgIndex] = 1.0 + _tiny;
-    
-    for (uint32_t i = 0; i < lastImgIndex; i++) {
-        _SMatrix[i][lastImgIndex] = _SMatrix[lastImgIndex][i] =
-        _corr_fn (tWin[i], tWin[lastImgIndex]);
-        _fraction_done += _single_weight;
+    sm(lastImgIndex, lastImgIndex) = 1.0 + _tiny;
+    
+    // The incoming frame against every frame in the window, in chunks on the pool
+    const size_t chunk = 16;
+    const size_t chunks = (lastImgIndex + chunk - 1) / chunk;
+    svl::thread_pool::global().parallel_for(chunks, [&] (size_t cc) {
+        const size_t end = std::min(lastImgIndex, (cc + 1) * chunk);
+        for (size_t i = cc * chunk; i < end; i++)
+            sm(i, lastImgIndex) = sm(lastImgIndex, i) = _corr_fn (tWin[i], tWin[lastImgIndex]);
+    });
+    _fraction_done += lastImgIndex * _single_weight;
+    
+    // Add the incoming frame to the row terms
+    if (_rowSums.size() == _matrixSz) {
+        const size_t in = slot(lastImgIndex);
+        double sum = 0, xlx = 0;
+        for (size_t q = 0; q < _matrixSz; q++) {
+            const double r = _SMatrix[q * _matrixSz + in];
+            sum += r;
+            xlx += xlogx(r);
+            if (q == in) continue;
+            _rowSums[q] += r;
+            _rowXlogX[q] += xlogx(r);
+        }
+        _rowSums[in] = sum;
+        _rowXlogX[in] = xlx;
     }
     
     // tWin[lastImgIndex].frameBuf().unlock();
@@ -531,7 +677,7 @@ bool self_similarity_producer<P>::genMatrixEntropy(size_t tWinSz)
     /* Create sums array and initialize all the elements.
      */
     
-    assert(_SMatrix.size() == _matrixSz);
+    assert(_SMatrix.size() == _matrixSz * _matrixSz);
     
     if (_sums.empty())
         _sums.resize(_matrixSz);
@@ -544,25 +690,24 @@ bool self_similarity_producer<P>::genMatrixEntropy(size_t tWinSz)
         assert(m_entropies.size() == _matrixSz);
     
     for (uint32_t i = 0; i < _matrixSz; i++) {
-        assert(_SMatrix[i].size() == _matrixSz);
-        _sums[i] = _SMatrix[i][i];
+        _sums[i] = sm(i, i);
         m_entropies[i] = 0.0;
     }
     
     for (uint32_t i = 0; i < (_matrixSz-1); i++)
         for (uint32_t j = (i+1); j < _matrixSz; j++) {
-            _sums[i] += _SMatrix[i][j];
-            _sums[j] += _SMatrix[i][j];
+            _sums[i] += sm(i, j);
+            _sums[j] += sm(i, j);
         }
     
     for (uint32_t  i = 0; i < _matrixSz; i++) {
         for (uint32_t j = i; j < _matrixSz; j++) {
             double rr =
-            _SMatrix[i][j]/_sums[i]; // Normalize for total energy in samples
+            sm(i, j)/_sums[i]; // Normalize for total energy in samples
             m_entropies[i] += shannon(rr);
             
             if (i != j) {
-                rr = _SMatrix[i][j]/_sums[j];//Normalize for total energy in samples
+                rr = sm(i, j)/_sums[j];//Normalize for total energy in samples
                 m_entropies[j] += shannon(rr);
             }
         }
@@ -577,20 +722,63 @@ bool self_similarity_producer<P>::genMatrixEntropy(size_t tWinSz)
     return true;
 }
 
+
+template<typename P>
+void self_similarity_producer<P>::refreshRowTerms()
+{
+    _rowSums.assign(_matrixSz, 0.0);
+    _rowXlogX.assign(_matrixSz, 0.0);
+    for (size_t q = 0; q < _matrixSz; q++) {
+        const double* row = &_SMatrix[q * _matrixSz];
+        for (size_t k = 0; k < _matrixSz; k++) {
+            _rowSums[q] += row[k];
+            _rowXlogX[q] += xlogx(row[k]);
+        }
+    }
+    _since_refresh = 0;
+}
+
+/*
+ * With S the row sum and T the sum of r log2 r over the row
+ *     sum over the row of shannon (r / S) = log2 (S) - T / S
+ * so the projection follows from the row terms in O(N)
+ */
+template<typename P>
+bool self_similarity_producer<P>::streamMatrixEntropy()
+{
+    _sums.resize(_matrixSz);
+    m_entropies.resize(_matrixSz);
+    for (uint32_t i = 0; i < _matrixSz; i++) {
+        const size_t q = slot(i);
+        const double S = _rowSums[q];
+        m_entropies[i] = (log2(S) - _rowXlogX[q] / S) / _log2MSz;
+        _sums[i] = S / _matrixSz;
+    }
+    return true;
+}
+
+template<typename P>
+void self_similarity_producer<P>::streaming(bool on)
+{
+    _streaming = on;
+    _rowSums.clear();
+    _rowXlogX.clear();
+}
+
 template<typename P>
 void self_similarity_producer<P>::unity ()
 {
-    assert(_SMatrix.size() == _matrixSz);
+    assert(_SMatrix.size() == _matrixSz * _matrixSz);
     
     for (uint32_t i = 0; i < _matrixSz; i++)
-        _SMatrix[i][i] = 1.0 + _tiny;
+        sm(i, i) = 1.0 + _tiny;
 }
 
 template<typename P>
 ostream& operator<< (ostream& ous, const self_similarity_producer<P>& rc)
 {
-    self_similarity_producer<P>* rc2 = const_cast<self_similarity_producer<P>*>(&rc);
-    deque<deque<double> >& cm = rc2->_SMatrix;
+    deque<deque<double> > cm;
+    rc.selfSimilarityMatrix(cm);
     if (!cm.empty()) {
         ous << "{";
         for (uint32_t i = 0; i < cm.size(); i++) {
@@ -610,6 +798,7 @@ ostream& operator<< (ostream& ous, const self_similarity_producer<P>& rc)
 
 
 template class self_similarity_producer<P8U>;
+template class self_similarity_producer<P16U>;
 
 
 
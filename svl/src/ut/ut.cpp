@@ -2,6 +2,7 @@
 #include <iostream>
 #include "gtest/gtest.h"
 #include <memory>
+#include <random>
 #include "boost/filesystem.hpp"
 #include "vision/histo.h"
 #include "vision/drawUtils.hpp"
@@ -15,14 +16,24 @@
 #include "vision/gmorph.hpp"
 #include "vision/sample.hpp"
 #include "core/stl_utils.hpp"
+#include "core/thread_pool.hpp"
+#include "core/frame_pool.hpp"
+#include "core/frame_source.hpp"
+#include "core/task_graph.hpp"
+#include "core/symmetric_matrix.hpp"
+#include "core/fft_engine.hpp"
 #include "vision/labelconnect.hpp"
 #include "vision/registration.h"
+#include "vision/correlation1d.hpp"
 #include "cinder_cv/cinder_xchg.hpp"
 #include "ut_localvar.hpp"
 #include "core/cv_gabor.hpp"
 #include "opencv2/highgui.hpp"
 #include "ut_similarity.hpp"
 #include "otherIO/lifFile.hpp"
+#include "vision/lif_frame_source.hpp"
+#include "vision/lif_views.hpp"
+#include "vision/intensity_map16.hpp"
 #include "core/gtest_env_utils.hpp"
 #include "vision/histo.h"
 #include "vision/roiMultiWindow.h"
@@ -267,6 +278,276 @@ TEST (ut_lifFile, triple_channel)
 
 }
 
+TEST (ut_lifFile, mapped)
+{
+    std::string filename ("3channels.lif");
+    std::pair<test_utils::genv::path_t, bool> res = dgenv_ptr->asset_path(filename);
+    EXPECT_TRUE(res.second);
+    auto streamed = lifIO::LifReader::create(res.first.string());
+    auto mapped = lifIO::LifReader::create(res.first.string(), true);
+    EXPECT_FALSE(streamed->isMapped());
+    EXPECT_TRUE(mapped->isMapped());
+    EXPECT_EQ(streamed->getNbSeries(), mapped->getNbSeries());
+    
+    const lifIO::LifSerie& ss = streamed->getSerie(1);
+    const lifIO::LifSerie& ms = mapped->getSerie(1);
+    EXPECT_FALSE(ss.channelView(0).valid());
+    const std::vector<size_t>& dims = ss.getSpatialDimensions();
+    const size_t channels = ss.getChannels().size();
+    const size_t slice = dims[0] * dims[1];
+    std::vector<uint8_t> sbuf (slice * channels), mbuf (slice * channels);
+    
+    for (size_t t : {size_t(0), size_t(17), ss.getNbTimeSteps() - 1})
+    {
+        ss.fill2DBuffer(sbuf.data(), t);
+        ms.fill2DBuffer(mbuf.data(), t);
+        EXPECT_TRUE(sbuf == mbuf);
+        EXPECT_EQ(0, std::memcmp(ms.mappedSlice(t), sbuf.data(), sbuf.size()));
+        
+        // Channels are stacked planes in the 2D buffer
+        for (size_t cc = 0; cc < channels; cc++)
+        {
+            lifIO::LifPlaneView view = ms.channelView(cc, t);
+            EXPECT_TRUE(view.valid());
+            EXPECT_EQ(dims[0], view.width);
+            EXPECT_EQ(dims[1], view.height);
+            EXPECT_EQ(1, view.pixel_bytes);
+            for (uint32_t yy = 0; yy < view.height; yy++)
+                EXPECT_EQ(0, std::memcmp(view.row(yy), &sbuf[cc * slice + yy * dims[0]], dims[0]));
+            
+            // Wrappers alias the mapping
+            roiWindow<P8U> window;
+            EXPECT_TRUE(svl::lif_channel_window(view, window));
+            EXPECT_EQ(window.rowPointer(0), view.data);
+            EXPECT_EQ(window.getPixel(3, 2), sbuf[cc * slice + 2 * dims[0] + 3]);
+            roiWindow<P16U> wrong;
+            EXPECT_FALSE(svl::lif_channel_window(view, wrong));
+            cv::Mat mat = svl::lif_channel_mat(view);
+            EXPECT_EQ(mat.type(), CV_8U);
+            EXPECT_EQ(mat.data, view.data);
+            EXPECT_EQ(mat.at<uint8_t>(2, 3), window.getPixel(3, 2));
+        }
+    }
+    
+    // Views keep the mapping alive past the reader
+    roiWindow<P8U> window;
+    cv::Mat mat;
+    {
+        auto reader = lifIO::LifReader::create(res.first.string(), true);
+        lifIO::LifPlaneView view = reader->getSerie(1).channelView(1, 5);
+        EXPECT_TRUE(svl::lif_channel_window(view, window));
+        mat = svl::lif_channel_mat(view);
+    }
+    ss.fill2DBuffer(sbuf.data(), 5);
+    EXPECT_EQ(window.getPixel(dims[0] - 1, dims[1] - 1), sbuf[2 * slice - 1]);
+    EXPECT_EQ(mat.at<uint8_t>(int(dims[1]) - 1, int(dims[0]) - 1), sbuf[2 * slice - 1]);
+    // Clones are writable copies
+    cv::Mat copy = mat.clone();
+    copy.at<uint8_t>(0, 0) = uint8_t(~sbuf[slice]);
+    EXPECT_EQ(mat.at<uint8_t>(0, 0), sbuf[slice]);
+    EXPECT_EQ(window.getPixel(0, 0), sbuf[slice]);
+}
+
+TEST (ut_lifFile, mapped_truncated)
+{
+    std::string filename ("3channels.lif");
+    std::pair<test_utils::genv::path_t, bool> res = dgenv_ptr->asset_path(filename);
+    EXPECT_TRUE(res.second);
+    
+    // A copy without the second half of the frames of the last serie in the file
+    auto reader = lifIO::LifReader::create(res.first.string());
+    const size_t serie = reader->getNbSeries() - 1;
+    const lifIO::LifSerie& full = reader->getSerie(serie);
+    const size_t last = full.getNbTimeSteps() - 1;
+    const boost::filesystem::path cut = boost::filesystem::temp_directory_path() / "ut_truncated.lif";
+    {
+        std::vector<char> head (full.getOffset(last / 2));
+        std::ifstream in (res.first.string(), std::ios::binary);
+        in.read(head.data(), head.size());
+        std::ofstream out (cut.string(), std::ios::binary | std::ios::trunc);
+        out.write(head.data(), head.size());
+    }
+    
+    // A reader refuses to open it, a serie located before the file shrank reads within the mapping only
+    EXPECT_THROW(lifIO::LifReader::create(cut.string(), true), std::invalid_argument);
+    lifIO::LifSerie ms (reader->getLifHeader().getSerieHeader(serie), cut.string(), full.getOffset(0),
+                        full.getMemorySize(), boost::filesystem::file_size(res.first));
+    auto mapping = lifIO::LifMappedFile::map(cut.string());
+    EXPECT_TRUE(bool(mapping));
+    ms.setMapping(mapping);
+    std::vector<uint8_t> buf (ms.getNbPixelsInOneSlice() * ms.getChannels().size());
+    EXPECT_NO_THROW(ms.fill2DBuffer(buf.data(), 0));
+    EXPECT_THROW(ms.fill2DBuffer(buf.data(), last), std::runtime_error);
+    EXPECT_EQ(ms.mappedSlice(last), nullptr);
+    EXPECT_THROW(ms.channelView(0, last), std::out_of_range);
+    boost::system::error_code ec;
+    boost::filesystem::remove(cut, ec);
+}
+
+TEST (ut_lifFile, concurrent)
+{
+    std::string filename ("3channels.lif");
+    std::pair<test_utils::genv::path_t, bool> res = dgenv_ptr->asset_path(filename);
+    EXPECT_TRUE(res.second);
+    auto lif = lifIO::LifReader::create(res.first.string());
+    const lifIO::LifSerie& se = lif->getSerie(1);
+    const size_t sliceSize = se.getNbPixelsInOneSlice() * se.getChannels().size();
+    const size_t frames = 64;
+    
+    std::vector<std::vector<uint8_t>> serial (frames, std::vector<uint8_t>(sliceSize));
+    for (size_t t = 0; t < frames; t++)
+        se.fill2DBuffer(serial[t].data(), t);
+    
+    // Many concurrent readers of one serie
+    std::vector<std::vector<uint8_t>> concurrent (frames, std::vector<uint8_t>(sliceSize));
+    svl::thread_pool pool (8);
+    pool.parallel_for(frames, [&] (size_t t) { se.fill2DBuffer(concurrent[t].data(), t); });
+    EXPECT_TRUE(serial == concurrent);
+    
+    std::vector<std::vector<uint8_t>> batched (frames, std::vector<uint8_t>(sliceSize));
+    std::vector<void*> buffers;
+    for (auto& bb : batched) buffers.push_back(bb.data());
+    se.fill_range(0, frames, buffers);
+    EXPECT_TRUE(serial == batched);
+}
+
+TEST (ut_lifFile, frame_source)
+{
+    std::string filename ("3channels.lif");
+    std::pair<test_utils::genv::path_t, bool> res = dgenv_ptr->asset_path(filename);
+    EXPECT_TRUE(res.second);
+    auto lif = lifIO::LifReader::create(res.first.string());
+    const lifIO::LifSerie& se = lif->getSerie(1);
+    const size_t sliceSize = se.getNbPixelsInOneSlice() * se.getChannels().size();
+    
+    // Frames arrive in order and match direct reads
+    svl::lif_frame_source source (lif, 1, 8, 0, 40);
+    EXPECT_EQ(40, source.frames());
+    EXPECT_EQ(3, source.channels());
+    std::vector<uint8_t> direct (sliceSize);
+    size_t expected = 0;
+    auto count = source.drain([&] (size_t t, const roiWindow<P8U>& frame) {
+        EXPECT_EQ(expected++, t);
+        se.fill2DBuffer(direct.data(), t);
+        EXPECT_EQ(0, std::memcmp(frame.rowPointer(0), direct.data(), sliceSize));
+        roiWindow<P8U> last = source.channel(frame, 2);
+        EXPECT_EQ(source.width(), last.width());
+        EXPECT_EQ(source.height(), last.height());
+        EXPECT_EQ(direct[2 * source.width() * source.height()], last.getPixel(0, 0));
+    });
+    EXPECT_EQ(40, count);
+    
+    // Stopping with the reader blocked on a full queue
+    svl::lif_frame_source early (lif, 1, 2);
+    roiWindow<P8U> frame;
+    EXPECT_TRUE(early.next(frame));
+    early.stop();
+    EXPECT_FALSE(early.next(frame));
+}
+
+TEST (ut_frame_source, read_ahead)
+{
+    // Frames arrive in order, the reader runs at most a window and a run ahead
+    std::atomic<size_t> read (0), consumed (0), ahead (0);
+    svl::frame_source<int> source ([&] (size_t t0, size_t t1, std::vector<int>& frames) {
+        for (size_t tt = t0; tt < t1; tt++) frames.push_back(int(tt * 3));
+        read = t1;
+        ahead = std::max(size_t(ahead), read - consumed);
+    }, 100, 8, 2);
+    auto count = source.drain([&] (size_t index, const int& frame) {
+        EXPECT_EQ(consumed, index);
+        EXPECT_EQ(int(index * 3), frame);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        consumed++;
+    });
+    EXPECT_EQ(100, count);
+    EXPECT_LE(ahead, 8 + 2 + 1);
+    
+    // A read error follows the frames read before it
+    svl::frame_source<int> failing ([] (size_t t0, size_t t1, std::vector<int>& frames) {
+        if (t0 >= 4) throw std::runtime_error("read");
+        for (size_t tt = t0; tt < t1; tt++) frames.push_back(int(tt));
+    }, 10, 4, 2);
+    size_t index;
+    int frame;
+    for (int ii = 0; ii < 4; ii++){
+        EXPECT_TRUE(failing.next(index, frame));
+        EXPECT_EQ(ii, frame);
+    }
+    EXPECT_THROW(failing.next(index, frame), std::runtime_error);
+    
+    // Including the frames of the failing run read before the error
+    svl::frame_source<int> partial ([] (size_t t0, size_t t1, std::vector<int>& frames) {
+        for (size_t tt = t0; tt < t1; tt++){
+            if (tt == 37) throw std::runtime_error("read");
+            frames.push_back(int(tt));
+        }
+    }, 100, 16, 8);
+    std::vector<int> delivered;
+    EXPECT_THROW(partial.drain([&] (size_t index, const int& frame) {
+        EXPECT_EQ(delivered.size(), index);
+        delivered.push_back(frame);
+    }), std::runtime_error);
+    EXPECT_EQ(37, delivered.size());
+}
+
+TEST (ut_lifFile, header_index)
+{
+    std::string filename ("3channels.lif");
+    std::pair<test_utils::genv::path_t, bool> res = dgenv_ptr->asset_path(filename);
+    EXPECT_TRUE(res.second);
+    const std::string path = res.first.string();
+    const std::string index = lifIO::LifReader::index_path(path);
+    boost::system::error_code ec;
+    boost::filesystem::remove(index, ec);
+    
+    auto parsed = lifIO::LifReader::create(path);
+    auto written = lifIO::LifReader::create(path, false, true);
+    EXPECT_FALSE(written->fromIndex());
+    EXPECT_TRUE(boost::filesystem::exists(index));
+    auto indexed = lifIO::LifReader::create(path, false, true);
+    EXPECT_TRUE(indexed->fromIndex());
+    EXPECT_TRUE(indexed->isValid());
+    
+    EXPECT_EQ(parsed->getName(), indexed->getName());
+    EXPECT_EQ(parsed->getNbSeries(), indexed->getNbSeries());
+    for (size_t ss = 0; ss < parsed->getNbSeries(); ss++)
+    {
+        const lifIO::LifSerie& ps = parsed->getSerie(ss);
+        const lifIO::LifSerie& is = indexed->getSerie(ss);
+        EXPECT_EQ(ps.getName(), is.getName());
+        EXPECT_EQ(ps.getNbTimeSteps(), is.getNbTimeSteps());
+        EXPECT_TRUE(ps.getSpatialDimensions() == is.getSpatialDimensions());
+        EXPECT_TRUE(ps.getTimestamps() == is.getTimestamps());
+        EXPECT_EQ(is.getTimestamps().size(), is.getDurations().size());
+        EXPECT_TRUE(ps.getDurations() == is.getDurations());
+        EXPECT_EQ(ps.getChannels().size(), is.getChannels().size());
+        EXPECT_EQ(ps.getVoxelSize(0), is.getVoxelSize(0));
+        EXPECT_EQ(ps.getOffset(ps.getNbTimeSteps() - 1), is.getOffset(is.getNbTimeSteps() - 1));
+    }
+    
+    std::vector<uint8_t> pb (parsed->getSerie(1).getNbPixelsInOneSlice() * 3), ib (pb.size());
+    parsed->getSerie(1).fill2DBuffer(pb.data(), 7);
+    indexed->getSerie(1).fill2DBuffer(ib.data(), 7);
+    EXPECT_TRUE(pb == ib);
+    
+    // The index carries no XML, the reader reads it from the file when asked
+    EXPECT_TRUE(indexed->getLifHeader().getXMLHeader().RootElement() == nullptr);
+    const TiXmlElement* px = parsed->getXMLHeader().RootElement();
+    const TiXmlElement* ix = indexed->getXMLHeader().RootElement();
+    EXPECT_TRUE(px != nullptr);
+    EXPECT_TRUE(ix != nullptr);
+    if (px && ix)
+    {
+        TiXmlPrinter pp, ip;
+        px->Accept(&pp);
+        ix->Accept(&ip);
+        EXPECT_EQ(std::string(pp.CStr()), std::string(ip.CStr()));
+    }
+    EXPECT_EQ(&indexed->getXMLHeader(), &indexed->getXMLHeader());
+    boost::filesystem::remove(index, ec);
+}
+
 TEST(basicU8, gradient)
 {
     
@@ -461,6 +742,347 @@ TEST (ut_similarity, run)
     tester.run();
 }
 
+TEST (ut_similarity, native16)
+{
+    // Correlation is invariant to gain and offset, 16 bit frames of 8 bit ones give the same matrix
+    const uint32_t count = 9;
+    std::vector<roiWindow<P8U>> i8;
+    std::vector<roiWindow<P16U>> i16;
+    for (uint32_t ff = 0; ff < count; ff++)
+    {
+        roiWindow<P8U> a (64, 48);
+        a.randomFill(ff + 1);
+        roiWindow<P16U> b (64, 48);
+        for (int32_t y = 0; y < a.height(); y++)
+            for (int32_t x = 0; x < a.width(); x++)
+                b.setPixel(x, y, uint16_t(a.getPixel(x, y) * 200 + 1000));
+        i8.push_back(a);
+        i16.push_back(b);
+    }
+    self_similarity_producer<P8U> s8 (count, 0);
+    self_similarity_producer<P16U> s16 (count, 0);
+    EXPECT_TRUE(s8.fill(i8));
+    EXPECT_TRUE(s16.fill(i16));
+    deque<double> e8, e16;
+    EXPECT_TRUE(s8.entropies(e8));
+    EXPECT_TRUE(s16.entropies(e16));
+    ASSERT_EQ(e8.size(), e16.size());
+    for (size_t ii = 0; ii < e8.size(); ii++)
+        EXPECT_NEAR(e8[ii], e16[ii], 1e-9);
+}
+
+TEST (ut_intensity_map16, volume)
+{
+    // Two frames of different ranges map through one table
+    roiWindow<P16U> a (7, 3), b (7, 3);
+    a.set(uint16_t(1000));
+    b.set(uint16_t(2000));
+    a.setPixel(0, 0, uint16_t(500));
+    b.setPixel(6, 2, uint16_t(3050));
+    std::vector<roiWindow<P16U>> frames { a, b };
+    auto map = svl::intensity_map16::from_range(frames.begin(), frames.end());
+    EXPECT_TRUE(map.valid());
+    EXPECT_EQ(map.lo(), 500);
+    EXPECT_EQ(map.hi(), 3050);
+    EXPECT_EQ(map(uint16_t(500)), 0);
+    EXPECT_EQ(map(uint16_t(3050)), 255);
+    EXPECT_EQ(map(uint16_t(0)), 0);
+    EXPECT_EQ(map(uint16_t(65535)), 255);
+    
+    roiWindow<P8U> a8 = map.map(a);
+    roiWindow<P8U> b8 = map.map(b);
+    EXPECT_EQ(a8.getPixel(0, 0), 0);
+    EXPECT_EQ(b8.getPixel(6, 2), 255);
+    EXPECT_EQ(a8.getPixel(1, 1), map(uint16_t(1000)));
+    EXPECT_EQ(b8.getPixel(1, 1), map(uint16_t(2000)));
+    EXPECT_LT(a8.getPixel(1, 1), b8.getPixel(1, 1));
+    
+    // Rows of a cv::Mat are step bytes apart
+    cv::Mat m (5, 9, CV_16U);
+    for (int y = 0; y < m.rows; y++)
+        for (int x = 0; x < m.cols; x++)
+            m.at<uint16_t>(y, x) = uint16_t(y * 1000 + x);
+    roiWindow<P16U> r;
+    cpCvMatToRoiWindow16U(m, r);
+    EXPECT_EQ(r.width(), 9);
+    EXPECT_EQ(r.height(), 5);
+    EXPECT_EQ(r.getPixel(8, 4), 4008);
+    EXPECT_EQ(r.getPixel(3, 2), 2003);
+}
+
+TEST (ut_roi_root, adopt)
+{
+    // A padded buffer owned elsewhere, 10 wide rows 16 bytes apart
+    auto buffer = std::make_shared<std::vector<uint8_t>>(16 * 4);
+    for (size_t ii = 0; ii < buffer->size(); ii++) (*buffer)[ii] = uint8_t(ii);
+    std::weak_ptr<std::vector<uint8_t>> watch (buffer);
+    {
+        auto rp = std::make_shared<root<P8U>>(buffer, buffer->data(), 16, 10, 4);
+        EXPECT_TRUE(rp->adopted());
+        EXPECT_EQ(rp->raw_storage(), nullptr);
+        roiWindow<P8U> whole (rp);
+        roiWindow<P8U> section (rp, 2, 1, 5, 2);
+        buffer.reset();
+        // The roots keep the pixels alive, windows alias them
+        EXPECT_FALSE(watch.expired());
+        EXPECT_EQ(whole.rowUpdate(), 16);
+        EXPECT_EQ(whole.getPixel(9, 3), 3 * 16 + 9);
+        EXPECT_EQ(section.getPixel(0, 0), 16 + 2);
+        section.setPixel(1, 1, 255);
+        EXPECT_EQ(whole.getPixel(3, 2), 255);
+    }
+    EXPECT_TRUE(watch.expired());
+    
+    // Sections of an adopted cv::Mat alias its pixels
+    cv::Mat m (6, 11, CV_8U);
+    for (int y = 0; y < m.rows; y++)
+        for (int x = 0; x < m.cols; x++)
+            m.at<uint8_t>(y, x) = uint8_t(y * 20 + x);
+    roiWindow<P8U> r;
+    refCvMatToRoiWindow8U(m, r);
+    EXPECT_EQ(r.width(), 11);
+    EXPECT_EQ(r.height(), 6);
+    EXPECT_EQ(r.rowPointer(0), m.data);
+    roiWindow<P8U> section (r.frameBuf(), 3, 2, 4, 3);
+    EXPECT_EQ(section.getPixel(1, 1), 3 * 20 + 4);
+    m.release();
+    EXPECT_EQ(section.getPixel(3, 2), 4 * 20 + 6);
+}
+
+TEST (ut_frame_pool, size_classes)
+{
+    using svl::frame_pool;
+    EXPECT_EQ(frame_pool::class_bytes(frame_pool::size_class(1)), 64);
+    EXPECT_EQ(frame_pool::class_bytes(frame_pool::size_class(64)), 64);
+    EXPECT_EQ(frame_pool::class_bytes(frame_pool::size_class(65)), 80);
+    EXPECT_EQ(frame_pool::class_bytes(frame_pool::size_class(129)), 160);
+    // At most a quarter of slack, classes grow with the request
+    size_t last = 0;
+    for (size_t bytes = 1; bytes < (size_t(1) << 22); bytes = bytes * 3 / 2 + 1)
+    {
+        const size_t ci = frame_pool::size_class(bytes);
+        const size_t cb = frame_pool::class_bytes(ci);
+        EXPECT_GE(cb, bytes);
+        EXPECT_LE(cb, std::max(size_t(64), bytes + bytes / 4));
+        EXPECT_GE(ci, last);
+        last = ci;
+    }
+}
+
+TEST (ut_frame_pool, frame_sizes)
+{
+    // Power of two frames fill their class exactly, blocks are aligned for every row alignment
+    svl::frame_arena arena;
+    svl::frame_pool::scope in_arena (arena.pool());
+    {
+        roiWindow<P8U> frame (512, 512);
+        EXPECT_EQ(arena.stats().bytes_out, 512 * 512);
+        EXPECT_EQ((intptr_t)frame.rowPointer(0) % svl::frame_pool::alignment, 0);
+    }
+    {
+        roiWindow<P16U> frame (1024, 256);
+        EXPECT_EQ(arena.stats().bytes_out, 1024 * 256 * 2);
+    }
+    {
+        root<P8U> padded (100, 3, align_every_row, 256);
+        EXPECT_EQ(padded.rowUpdate(), 256);
+        EXPECT_EQ((intptr_t)padded.rowPointer(2) % 256, 0);
+        EXPECT_EQ(arena.stats().bytes_out, 3 * 256);
+    }
+    EXPECT_EQ(arena.stats().bytes_out, 0);
+}
+
+TEST (ut_frame_pool, arena)
+{
+    std::shared_ptr<svl::frame_pool> pool;
+    {
+        svl::frame_arena arena;
+        pool = arena.pool();
+        {
+            svl::frame_pool::scope in_arena (arena.pool());
+            EXPECT_EQ(svl::frame_pool::current(), arena.pool());
+            // Same sized frames reuse the freed blocks
+            for (int ii = 0; ii < 10; ii++)
+            {
+                roiWindow<P8U> frame (640, 480);
+                roiWindow<P8U> crop (frame, 10, 10, 100, 100);
+                EXPECT_EQ(crop.frameBuf(), frame.frameBuf());
+            }
+        }
+        EXPECT_EQ(svl::frame_pool::current(), svl::frame_pool::global());
+        auto stats = arena.stats();
+        EXPECT_EQ(stats.acquired, 10);
+        EXPECT_EQ(stats.heap, 1);
+        EXPECT_EQ(stats.reused, 9);
+        EXPECT_EQ(stats.released, 10);
+        EXPECT_EQ(stats.bytes_out, 0);
+        EXPECT_GE(stats.bytes_cached, 640 * 480);
+        EXPECT_EQ(stats.peak_bytes_out, stats.bytes_cached);
+        
+        // A block outliving the arena goes to the heap when released
+        svl::frame_pool::scope in_arena (arena.pool());
+        roiWindow<P8U> kept (64, 64);
+        {
+            svl::frame_arena done;
+            svl::frame_pool::scope in_done (done.pool());
+            kept = roiWindow<P8U> (64, 64);
+            kept.set(7);
+        }
+        EXPECT_EQ(kept.getPixel(63, 63), 7);
+    }
+    // Closed with the arena
+    EXPECT_EQ(pool->stats().bytes_cached, 0);
+}
+
+TEST (ut_thread_pool, parallel_for)
+{
+    svl::thread_pool pool (4);
+    std::vector<size_t> squares (1000, 0);
+    pool.parallel_for(squares.size(), [&squares] (size_t ii) { squares[ii] = ii * ii; });
+    for (size_t ii = 0; ii < squares.size(); ii++)
+        EXPECT_EQ(squares[ii], ii * ii);
+    
+    // Nested loops run from inside a job
+    std::atomic<size_t> total (0);
+    pool.parallel_for(8, [&pool, &total] (size_t) {
+        pool.parallel_for(100, [&total] (size_t jj) { total += jj; });
+    });
+    EXPECT_EQ(total, 8 * 4950);
+    
+    EXPECT_THROW(pool.parallel_for(10, [] (size_t ii) { if (ii == 3) throw std::runtime_error("3"); }), std::runtime_error);
+}
+
+TEST (ut_thread_pool, priority_cancel)
+{
+    svl::thread_pool pool (1);
+    typedef svl::thread_pool::priority priority;
+    
+    // Hold the only worker, queue low before high, high runs first
+    std::promise<void> release;
+    std::shared_future<void> hold (release.get_future());
+    auto busy = pool.submit([hold] () { hold.wait(); }, priority::normal);
+    std::mutex mutex;
+    std::vector<int> order;
+    auto low = pool.submit([&] () { std::lock_guard<std::mutex> lk(mutex); order.push_back(2); }, priority::low);
+    auto high = pool.submit([&] () { std::lock_guard<std::mutex> lk(mutex); order.push_back(0); }, priority::high);
+    
+    // Cancelled before it starts, never runs
+    svl::cancel_token token;
+    std::atomic<bool> ran (false);
+    auto dropped = pool.submit([&ran] () { ran = true; }, priority::normal, token);
+    token.cancel();
+    release.set_value();
+    busy.get(); high.get(); low.get();
+    EXPECT_THROW(dropped.get(), std::future_error);
+    EXPECT_FALSE(ran);
+    ASSERT_EQ(order.size(), 2);
+    EXPECT_EQ(order[0], 0);
+    EXPECT_EQ(order[1], 2);
+    
+    // Iterations after cancellation are skipped
+    svl::cancel_token stop;
+    std::atomic<size_t> count (0);
+    pool.parallel_for(100, [&] (size_t ii) { count++; if (ii == 9) stop.cancel(); }, nullptr, stop);
+    EXPECT_LT(count, 100);
+}
+
+TEST (ut_task_graph, dependencies)
+{
+    svl::thread_pool pool (4);
+    
+    // 10 chains of a -> ( b, c ) -> d, d sees both b and c
+    svl::task_graph graph (pool);
+    std::vector<std::atomic<int>> stages (10);
+    std::vector<svl::task_graph::node_t> ends;
+    for (size_t ii = 0; ii < stages.size(); ii++)
+    {
+        stages[ii] = 0;
+        auto& st = stages[ii];
+        auto a = graph.add([&st] () { st += 1; return true; });
+        auto b = graph.add([&st] () { if (st % 10 != 1) return false; st += 10; return true; }, {a});
+        auto c = graph.add([&st] () { if (st % 10 != 1) return false; st += 100; return true; }, {a});
+        ends.push_back(graph.add([&st] () { return st == 111; }, {b, c}));
+    }
+    EXPECT_TRUE(graph.run());
+    for (auto ee : ends) EXPECT_TRUE(graph.succeeded(ee));
+    
+    // A failure skips the dependents only
+    svl::task_graph failing (pool);
+    std::atomic<int> ran (0);
+    auto bad = failing.add([] () { return false; });
+    auto skipped = failing.add([&ran] () { ran++; return true; }, {bad});
+    auto other = failing.add([&ran] () { ran++; return true; });
+    EXPECT_FALSE(failing.run());
+    EXPECT_FALSE(failing.succeeded(skipped));
+    EXPECT_TRUE(failing.succeeded(other));
+    EXPECT_EQ(ran, 1);
+    
+    svl::task_graph throwing (pool);
+    throwing.add([] () -> bool { throw std::runtime_error("task"); });
+    EXPECT_THROW(throwing.run(), std::runtime_error);
+}
+
+TEST (ut_fft_engine, real_batch)
+{
+    // Power of 2, mixed radix, generic radix and odd sizes against a direct DFT
+    std::mt19937 rng (1);
+    std::uniform_real_distribution<float> uniform (-1.0f, 1.0f);
+    for (size_t n : {16, 30, 49, 97, 240, 1000})
+    {
+        const size_t count = 11;
+        std::vector<float> signals (n * count);
+        for (auto& v : signals) v = uniform(rng);
+        svl::fft_real engine (n);
+        const size_t bins = engine.bins();
+        EXPECT_EQ(bins, n / 2 + 1);
+        std::vector<float> re (bins * count), im (bins * count);
+        engine.forward(signals.data(), count, n, re.data(), im.data(), bins);
+        
+        for (size_t b = 0; b < count; b++)
+            for (size_t k = 0; k < bins; k++)
+            {
+                std::complex<double> dft (0.0, 0.0);
+                for (size_t j = 0; j < n; j++)
+                    dft += double(signals[b * n + j]) * std::polar(1.0, -2.0 * svl::constants::pi * double((j * k) % n) / n);
+                EXPECT_NEAR(dft.real(), re[b * bins + k], 1e-5 * n);
+                EXPECT_NEAR(dft.imag(), im[b * bins + k], 1e-5 * n);
+            }
+    }
+}
+
+TEST (ut_symmetric_matrix, basic)
+{
+    typedef svl::symmetric_matrix<double> sm_t;
+    std::deque<std::deque<double>> rows (7, std::deque<double> (7));
+    for (size_t ii = 0; ii < 7; ii++)
+        for (size_t jj = 0; jj < 7; jj++)
+            rows[ii][jj] = 1.0 / (ii + jj + 1);
+    
+    sm_t dense = sm_t::from_rows(rows);
+    sm_t packed = sm_t::from_rows(rows, sm_t::packed);
+    svl::symmetric_matrix<float> single = dense.cast<float>();
+    EXPECT_EQ(dense.size(), size_t(7));
+    for (size_t ii = 0; ii < 7; ii++)
+        for (size_t jj = 0; jj < 7; jj++)
+        {
+            EXPECT_EQ(dense(ii, jj), rows[ii][jj]);
+            EXPECT_EQ(dense.row(ii)[jj], rows[ii][jj]);
+            EXPECT_EQ(packed(ii, jj), rows[ii][jj]);
+            EXPECT_FLOAT_EQ(single(ii, jj), rows[ii][jj]);
+        }
+    
+    // Copies share, writes detach
+    sm_t shared = dense;
+    EXPECT_EQ(dense.use_count(), 2L);
+    EXPECT_EQ(shared.data(), dense.data());
+    shared.set(2, 5, -1.0);
+    EXPECT_NE(shared.data(), dense.data());
+    EXPECT_EQ(shared(5, 2), -1.0);
+    EXPECT_EQ(dense(5, 2), rows[5][2]);
+    EXPECT_TRUE(dense == packed);
+    EXPECT_FALSE(dense == shared);
+}
+
 TEST(basic, self_registration)
 {
     
@@ -788,6 +1410,124 @@ TEST(basic, corr16)
 }
 
 
+// Vectorized kernels have to produce exactly the table based sums, including masked and odd widths
+TEST(basic, corr_simd_vs_scalar)
+{
+    std::mt19937 gen(19);
+    std::uniform_int_distribution<int> dis(0, 65535);
+    const uint32_t widths[] = {1, 15, 17, 33, 1920, 1923};
+    const uint32_t height = 11;
+    
+    for (auto width : widths)
+    {
+        const uint32_t rup = width + 5;
+        std::vector<uint8_t> a8 (rup * height), b8 (rup * height);
+        std::vector<uint16_t> a16 (rup * height), b16 (rup * height);
+        for (auto ii = 0; ii < a8.size(); ii++)
+        {
+            a8[ii] = uint8_t(dis(gen)); b8[ii] = uint8_t(dis(gen));
+            a16[ii] = uint16_t(dis(gen)); b16[ii] = uint16_t(dis(gen));
+        }
+        
+        for (bool masked : {false, true})
+        {
+            CorrelationParts vp, sp;
+            basicCorrRowFunc<uint8_t> vf(a8.data(), b8.data(), rup, rup, width, height, masked);
+            basicCorrRowFunc<uint8_t> sf(a8.data(), b8.data(), rup, rup, width, height, masked);
+            sf.use_simd(false);
+            vf.areaFunc(); vf.epilog(vp);
+            sf.areaFunc(); sf.epilog(sp);
+            EXPECT_TRUE(vp == sp);
+        }
+        
+        CorrelationParts vp, sp;
+        basicCorrRowFunc<uint16_t> vf(a16.data(), b16.data(), rup, rup, width, height);
+        basicCorrRowFunc<uint16_t> sf(a16.data(), b16.data(), rup, rup, width, height);
+        sf.use_simd(false);
+        vf.areaFunc(); vf.epilog(vp);
+        sf.areaFunc(); sf.epilog(sp);
+        EXPECT_TRUE(vp == sp);
+    }
+}
+
+
+// Correlation from cached moments and the cross term matches the full correlation
+TEST(basic, corr_moments)
+{
+    roiWindow<P8U> a (643, 101), b (643, 101);
+    a.randomFill(3);
+    b.randomFill(4);
+    roiWindow<P8U> wa (a, 3, 1, 600, 97), wb (b, 5, 2, 600, 97);
+    
+    CorrelationParts full, cross;
+    Correlation::point(wa, wb, full);
+    Correlation::point(wa, wb, Correlation::moments(wa), Correlation::moments(wb), cross);
+    EXPECT_TRUE(full == cross);
+    
+    imageMoments cached;
+    EXPECT_TRUE(wa.frameBuf()->cached_moments(wa.bound(), cached));
+    EXPECT_EQ(cached, Correlation::moments(wa));
+    
+    // Mutators make it stale, reads through a const window do not
+    wa.setPixel(0, 0, uint8_t(wa.getPixel(0, 0) + 1));
+    EXPECT_FALSE(wa.frameBuf()->cached_moments(wa.bound(), cached));
+    Correlation::point(wa, wb, full);
+    Correlation::point(wa, wb, Correlation::moments(wa), Correlation::moments(wb), cross);
+    EXPECT_TRUE(full == cross);
+    const roiWindow<P8U>& ca = wa;
+    EXPECT_EQ(ca.rowPointer(1)[0], wa.getPixel(0, 1));
+    EXPECT_TRUE(wa.frameBuf()->cached_moments(wa.bound(), cached));
+    
+    // So do writes through a writable row pointer
+    const uint64_t generation = wa.frameBuf()->generation();
+    wa.rowPointer(1)[0]++;
+    EXPECT_NE(generation, wa.frameBuf()->generation());
+    EXPECT_FALSE(wa.frameBuf()->cached_moments(wa.bound(), cached));
+    EXPECT_FALSE(cached == Correlation::moments(wa));
+    
+    // Writers of adopted pixels mark them modified
+    cv::Mat m (7, 9, CV_8U, cv::Scalar(3));
+    roiWindow<P8U> r;
+    refCvMatToRoiWindow8U(m, r);
+    const imageMoments before = Correlation::moments(r);
+    m.at<uint8_t>(2, 2) = 200;
+    r.frameBuf()->modified();
+    EXPECT_FALSE(r.frameBuf()->cached_moments(r.bound(), cached));
+    EXPECT_FALSE(before == Correlation::moments(r));
+    EXPECT_EQ(Correlation::moments(r).sum, before.sum + 197);
+}
+
+
+TEST(basic, corr1d_fft)
+{
+    // FFT paths against the direct ones
+    std::mt19937 rng (5);
+    std::normal_distribution<double> noise (0.0, 1.0);
+    const size_t n = 1000;
+    std::vector<double> sig (n), model (n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sig[i] = 100.0 + 10.0 * std::sin(i * 0.05) + noise(rng);
+        model[i] = 100.0 + 10.0 * std::sin((i + 17) * 0.05) + noise(rng);
+    }
+    
+    for (bool op : {true, false})
+    {
+        std::vector<double> direct, fft (n);
+        svl::f1dAutoCorrDirect(sig.begin(), sig.end(), direct, op);
+        svl::f1dAutoCorrFFT(sig.begin(), sig.end(), fft.begin(), op);
+        for (size_t i = 0; i < n; i++)
+            EXPECT_NEAR(direct[i], fft[i], 1e-9 * std::max(1.0, std::fabs(direct[i])));
+    }
+    
+    std::vector<double> direct, fft;
+    svl::f1dSlideDirect(sig.begin(), sig.end(), model.begin(), model.end(), 10, 200, direct);
+    svl::f1dSlideFFT(sig.begin(), sig.end(), model.begin(), model.end(), 10, 200, fft);
+    EXPECT_EQ(direct.size(), fft.size());
+    for (size_t i = 0; i < direct.size(); i++)
+        EXPECT_NEAR(direct[i], fft[i], 1e-9);
+}
+
 TEST(timing8, corr)
 {
     std::shared_ptr<uint8_t> img1 = test_utils::create_trig(1920, 1080);
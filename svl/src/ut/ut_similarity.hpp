@@ -199,6 +199,100 @@ public:
         }
     }
     
+    // Streaming updates have to track batch fills of the same window
+    void testStreaming()
+    {
+        const uint32_t icnt = 40;
+        const uint32_t winSz = 6;
+        vector<roiWindow<P8U>> srcvector(icnt);
+        for (uint32_t i = 0; i < srcvector.size(); ++i)
+        {
+            roiWindow<P8U> tmp (64, 48);
+            tmp.randomFill(i);
+            srcvector[i] = tmp;
+        }
+        
+        self_similarity_producer<P8U> simu( winSz, 0, self_similarity_producer<P8U>::similarity_fn_t ());
+        simu.streaming(true);
+        EXPECT_TRUE(simu.streaming());
+        
+        for (uint32_t i = 0; i < icnt; i++)
+        {
+            bool update = simu.update(srcvector[i]);
+            EXPECT_EQ(update, i >= (winSz-1));
+            if (! update) continue;
+            
+            self_similarity_producer<P8U> simf( winSz, 0, self_similarity_producer<P8U>::similarity_fn_t ());
+            vector<roiWindow<P8U>> window (srcvector.begin() + i + 1 - winSz, srcvector.begin() + i + 1);
+            EXPECT_TRUE(simf.fill(window));
+            
+            deque<double> entu, entf;
+            EXPECT_TRUE(simu.entropies(entu));
+            EXPECT_TRUE(simf.entropies(entf));
+            EXPECT_EQ(entu.size(), entf.size());
+            for (uint32_t j = 0; j < entu.size() && j < entf.size(); j++)
+                EXPECT_NEAR(entu[j], entf[j], 1.e-9);
+            
+            deque<deque<double> > mu, mf;
+            EXPECT_TRUE(simu.selfSimilarityMatrix(mu));
+            EXPECT_TRUE(simf.selfSimilarityMatrix(mf));
+            EXPECT_TRUE(mu == mf);
+        }
+    }
+    
+    // Gram matrix fills have to match pairwise fills to float round off
+    void testBatch()
+    {
+        // More frames than a product block, mixes of a common base and a per frame pattern
+        const uint32_t icnt = 70;
+        roiWindow<P8U> base (32, 24);
+        base.randomFill(1);
+        vector<roiWindow<P8U>> srcvector(icnt);
+        for (uint32_t i = 0; i < srcvector.size(); ++i)
+        {
+            roiWindow<P8U> noise (32, 24);
+            noise.randomFill(i + 2);
+            roiWindow<P8U> tmp (32, 24);
+            for (int32_t y = 0; y < tmp.height(); y++)
+                for (int32_t x = 0; x < tmp.width(); x++)
+                    tmp.setPixel(x, y, (base.getPixel(x, y) * (i % 7) + noise.getPixel(x, y) * 3) / ((i % 7) + 3));
+            srcvector[i] = tmp;
+        }
+        srcvector[5].set(128);
+        
+        // Both report progress the same way, in order up to the same fraction
+        std::vector<float> pp, pb;
+        self_similarity_producer<P8U> simp( icnt, 0, [&pp] (float f) { pp.push_back(f); },
+                                            self_similarity_producer<P8U>::similarity_fn_t (), true );
+        self_similarity_producer<P8U> simb( icnt, 0, [&pb] (float f) { pb.push_back(f); },
+                                            self_similarity_producer<P8U>::similarity_fn_t (), true );
+        simb.batch(true);
+        EXPECT_TRUE(simb.batch());
+        EXPECT_TRUE(simp.fill(srcvector));
+        EXPECT_TRUE(simb.fill(srcvector));
+        
+        deque<deque<double> > mp, mb;
+        EXPECT_TRUE(simp.selfSimilarityMatrix(mp));
+        EXPECT_TRUE(simb.selfSimilarityMatrix(mb));
+        EXPECT_EQ(mp.size(), mb.size());
+        for (uint32_t j = 0; j < mp.size() && j < mb.size(); j++)
+            for (uint32_t k = 0; k < mp.size(); k++)
+                EXPECT_NEAR(mp[j][k], mb[j][k], 1.e-5);
+        
+        deque<double> entp, entb;
+        EXPECT_TRUE(simp.entropies(entp));
+        EXPECT_TRUE(simb.entropies(entb));
+        EXPECT_EQ(entp.size(), entb.size());
+        for (uint32_t j = 0; j < entp.size() && j < entb.size(); j++)
+            EXPECT_NEAR(entp[j], entb[j], 1.e-5);
+        
+        EXPECT_FALSE(pb.empty());
+        EXPECT_TRUE(std::is_sorted(pb.begin(), pb.end()));
+        EXPECT_FALSE(pp.empty());
+        if (! pp.empty() && ! pb.empty())
+            EXPECT_NEAR(pp.back(), pb.back(), 1.e-5);
+    }
+    
     // Test performance with different vector sizes
     void testPerformance(uint32_t size, vector<roiWindow<P8U>>& images)
     {
@@ -248,6 +342,8 @@ public:
         // Basic tests
         testBasics();
         testUpdate();
+        testStreaming();
+        testBatch();
         
         // Performance tests
         const uint32_t min = 2;